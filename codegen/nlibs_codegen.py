@@ -0,0 +1,368 @@
+#!/usr/bin/env python3
+############################################################################
+#
+#   Copyright (c) 2015 Elikos Team. All rights reserved.
+#   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+#            @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in
+#    the documentation and/or other materials provided with the
+#    distribution.
+# 3. Neither the name PX4 nor the names of its contributors may be
+#    used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+# OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+# AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+############################################################################
+
+"""
+Generate nlibs_control_kernel.cpp from the symbolic model in nlibs_model.py.
+
+The position and the attitude stages are emitted as two straight-line
+single precision kernels, run at their own rates: common subexpressions
+are eliminated across all outputs of a kernel, so every product shared by
+the rotation, drift, gain and mixer terms is computed once.
+
+The same run writes host/nlibs_batch_kernel.cpp, the structure of arrays
+variant of both kernels for NLIBSBatch. It prints the same common
+subexpressions in the same order on vectors of NLIBS_BATCH_LANES
+controllers, so that every lane rounds exactly as the scalar kernel.
+
+usage: nlibs_codegen.py [-o ../nlibs_control_kernel.cpp] [-b ../host/nlibs_batch_kernel.cpp]
+
+Run it again after any change to nlibs_model.py and commit its output, the
+firmware build does not depend on sympy.
+
+@author Antoine Mignon <mignon.antoine@gmail.com>
+@author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+"""
+
+import argparse
+import os
+import re
+
+import sympy as sp
+from sympy.codegen.ast import float32, real
+from sympy.printing.c import C99CodePrinter
+
+import nlibs_model
+
+
+class KernelPrinter(C99CodePrinter):
+    """C99 printer restricted to what the single precision pragmas allow."""
+
+    sqrt = 'sqrtf'
+    functions = {'constrain': 'math::constrain', 'wrap_pi': '_wrap_pi'}
+
+    def __init__(self):
+        super(KernelPrinter, self).__init__(settings={
+            'type_aliases': {real: float32},
+            'user_functions': self.functions,
+        })
+
+    def _print_Pow(self, expr):
+        base, exp = expr.base, expr.exp
+
+        if exp == sp.Rational(1, 2):
+            return '%s(%s)' % (self.sqrt, self._print(base))
+
+        if exp.is_Integer and 0 < abs(exp) <= 4:
+            product = '*'.join([self.parenthesize(base, sp.printing.precedence.PRECEDENCE['Mul'])] * int(abs(exp)))
+            return product if exp > 0 else '1.0F/(%s)' % product
+
+        return super(KernelPrinter, self)._print_Pow(expr)
+
+    def _print_Rational(self, expr):
+        return self._print(sp.Float(expr))
+
+    def _print_Piecewise(self, expr):
+        if expr.args[-1].cond != True:
+            raise ValueError('Piecewise without a default')
+
+        code = self._print_branch(expr.args[-1].expr)
+
+        for e, c in reversed(expr.args[:-1]):
+            code = '(%s) ? (%s) : (%s)' % (self._print(c), self._print_branch(e), code)
+
+        return '(%s)' % code
+
+    def _print_branch(self, e):
+        # branches are floats, 0 included
+        return self._print(sp.Float(e) if e.is_Integer else e)
+
+
+class LanePrinter(KernelPrinter):
+    """
+    Same expressions on GCC vectors of NLIBS_BATCH_LANES floats. Only the
+    leaves and the functions are renamed: every operator applies to the
+    same operands as in the scalar kernel. The comparisons give lane masks
+    and the ?: operator selects lane by lane, both branches are evaluated.
+    """
+
+    sqrt = 'vsqrtf'
+    functions = {'constrain': 'vconstrain', 'wrap_pi': 'vwrap_pi'}
+
+    def __init__(self, leaves):
+        super(LanePrinter, self).__init__()
+        self.leaves = leaves
+
+    def _print_Symbol(self, expr):
+        if expr.name in self.leaves:
+            return self.leaves[expr.name]
+
+        return super(LanePrinter, self)._print_Symbol(expr)
+
+    def _print_Min(self, expr):
+        return 'v' + super(LanePrinter, self)._print_Min(expr)
+
+    def _print_branch(self, e):
+        # a mode flag does not select lane by lane, both branches must be vectors
+        code = super(LanePrinter, self)._print_branch(e)
+        return 'vset(%s)' % code if e.is_Number else code
+
+    def _print_asin(self, expr):
+        return 'v' + super(LanePrinter, self)._print_asin(expr)
+
+
+def eliminate(assignments):
+    """Common subexpressions of one kernel, with the operation counts before and after."""
+    exprs = [a[1] for a in assignments]
+    ops_before = sum(sp.count_ops(e) for e in exprs)
+
+    temps, reduced = sp.cse(exprs, symbols=sp.numbered_symbols('t'))
+    ops_after = sum(sp.count_ops(e) for _, e in temps) + sum(sp.count_ops(e) for e in reduced)
+
+    return temps, reduced, ops_before, ops_after
+
+
+def kernel_body(names, temps, reduced, prelude):
+    """Straight-line code of one kernel."""
+    printer = KernelPrinter()
+
+    # previous state first, the outputs below overwrite it
+    lines = list(prelude) + ['']
+
+    for t, e in temps:
+        ctype = 'bool' if isinstance(e, sp.logic.boolalg.Boolean) and not e.is_Symbol else 'float'
+        lines.append('const %s %s = %s;' % (ctype, t, printer.doprint(e)))
+
+    lines.append('')
+
+    for name, e in zip(names, reduced):
+        lines.append('%s = %s;' % (name, printer.doprint(e)))
+
+    return lines
+
+
+# scalar kernel lvalues and leaves to NLIBSBatch columns, the mode flags stay scalars
+COLUMN_PATTERNS = [
+    (r'in\.\w+_enabled$', None),
+    (r'(?:in|outer)\.(\w+)\((\d+), (\d+)\)$', r'\1[\2][\3]'),
+    (r'(?:in|outer|out)\.(\w+)\((\d+)\)$', r'\1[\2]'),
+    (r'(?:in|outer|out)\.(\w+)$', r'\1'),
+    (r'params\.(A\d)_gain\((\d+)\)$', r'\1[\2]'),
+    (r'(forces|rates_int)(?:_|\[)(\d+)\]?$', r'\1[\2]'),
+]
+
+
+def column(name):
+    """NLIBSBatch column of a scalar kernel name, None when it is shared by all lanes."""
+    for pattern, replacement in COLUMN_PATTERNS:
+        if re.match(pattern, name):
+            return re.sub(pattern, replacement, name) if replacement else None
+
+    return None
+
+
+def lane_body(names, temps, reduced):
+    """The same kernel on one vector of lanes, starting at column index i."""
+    free = set()
+
+    for e in [e for _, e in temps] + list(reduced):
+        free |= e.free_symbols
+
+    leaves = {}
+    lines = []
+
+    # lane leaves are loaded once, the shared ones are read as in the scalar kernel
+    for s in sorted(free, key=lambda s: s.name):
+        c = column(s.name)
+
+        if c is not None:
+            leaves[s.name] = re.sub(r'\W+', '_', s.name).strip('_')
+            lines.append('const vfloat %s = vload(&%s[i]);' % (leaves[s.name], c))
+
+        elif s.name.startswith('in.'):
+            # the mode flags, arguments of the lane kernels
+            leaves[s.name] = s.name[len('in.'):]
+
+    lines.append('')
+    printer = LanePrinter(leaves)
+
+    for t, e in temps:
+        lines.append('const auto %s = %s;' % (t, printer.doprint(e)))
+
+    lines.append('')
+    stored = set()
+
+    # out.forces() is the forces column as well
+    for name, e in zip(names, reduced):
+        c = column(name)
+
+        if c not in stored:
+            stored.add(c)
+            lines.append('vstore(&%s[i], %s);' % (c, printer.doprint(e)))
+
+    return lines
+
+
+def write_kernels(f, bodies):
+    for n, (signature, lines) in enumerate(bodies):
+        if n > 0:
+            f.write('\n')
+
+        f.write(signature)
+        f.write('{\n')
+
+        for line in lines:
+            f.write('\t%s\n' % line if line else '\n')
+
+        f.write('}\n')
+
+
+def generate(path, batch_path):
+    x = nlibs_model.Inputs()
+    k = nlibs_model.Kinematics(x)
+
+    forces = ['const float forces_%d = forces[%d];' % (i, i) for i in range(4)]
+    rates_int = ['const float rates_int_%d = rates_int[%d];' % (i, i) for i in range(3)]
+
+    kernels = [
+        ('position', POSITION_SIGNATURE, POSITION_LANES, nlibs_model.position_law(x, k), forces),
+        ('attitude', ATTITUDE_SIGNATURE, ATTITUDE_LANES, nlibs_model.attitude_law(x, k), rates_int + forces),
+    ]
+
+    bodies = []
+    lane_bodies = []
+    counts = []
+
+    for name, signature, lane_signature, assignments, prelude in kernels:
+        names = [a[0] for a in assignments]
+        temps, reduced, ops_before, ops_after = eliminate(assignments)
+        bodies.append((signature, kernel_body(names, temps, reduced, prelude)))
+        lane_bodies.append((lane_signature, lane_body(names, temps, reduced)))
+        counts.append(' * %s stages: %d operations in the expanded model expressions, %d after\n'
+                      ' * eliminating %d common subexpressions.\n' % (name, ops_before, ops_after, len(temps)))
+
+    here = os.path.dirname(os.path.abspath(__file__))
+
+    with open(os.path.join(here, 'license.txt')) as f:
+        license = f.read()
+
+    with open(path, 'w') as f:
+        f.write(license)
+        f.write(HEADER % {'counts': ' *\n'.join(counts)})
+
+        for name, value in nlibs_model.CONSTANTS:
+            f.write('#define %-24s%s\n' % (name, value))
+
+        f.write('\n')
+        write_kernels(f, bodies)
+
+    with open(batch_path, 'w') as f:
+        f.write(license)
+        f.write(BATCH_HEADER)
+
+        for name, value in nlibs_model.CONSTANTS:
+            f.write('#define %-24s%s\n' % (name, value))
+
+        f.write('\n')
+        write_kernels(f, lane_bodies)
+
+
+HEADER = '''
+/**
+ * @file nlibs_control_kernel.cpp
+ * Straight-line kernel of the NLIBS control law.
+ *
+ * GENERATED by codegen/nlibs_codegen.py from codegen/nlibs_model.py, do not
+ * edit: change the model and run the generator again.
+ *
+%(counts)s *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_control_law.h"
+
+#include <math.h>
+#include <lib/geo/geo.h>
+
+#include "nlibs_single_precision.h"
+
+'''
+
+BATCH_HEADER = '''
+/**
+ * @file nlibs_batch_kernel.cpp
+ * Structure of arrays kernel of NLIBSBatch, NLIBS_BATCH_LANES controllers at a time.
+ *
+ * GENERATED by codegen/nlibs_codegen.py from codegen/nlibs_model.py, along
+ * with nlibs_control_kernel.cpp, do not edit: change the model and run the
+ * generator again.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_batch.h"
+#include "nlibs_lanes.h"
+
+#include <lib/geo/geo.h>
+
+'''
+
+POSITION_SIGNATURE = '''void nlibs_position_kernel(const struct nlibs_params_s &params, const struct nlibs_input_s &in,
+			   const float forces[4], struct nlibs_outer_s &outer)
+'''
+
+ATTITUDE_SIGNATURE = '''void nlibs_attitude_kernel(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+			   const struct nlibs_outer_s &outer, float rates_int[3], float forces[4],
+			   struct nlibs_output_s &out)
+'''
+
+POSITION_LANES = '''void NLIBSBatch::position_lanes(const struct nlibs_params_s &params, bool position_enabled, bool altitude_enabled,
+				unsigned i)
+'''
+
+ATTITUDE_LANES = '''void NLIBSBatch::attitude_lanes(const struct nlibs_params_s &params, bool position_enabled, bool altitude_enabled,
+				float dt, unsigned i)
+'''
+
+
+if __name__ == '__main__':
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description='Generate the NLIBS control kernel')
+    parser.add_argument('-o', '--output', default=os.path.join(here, '..', 'nlibs_control_kernel.cpp'))
+    parser.add_argument('-b', '--batch', default=os.path.join(here, '..', 'host', 'nlibs_batch_kernel.cpp'))
+    args = parser.parse_args()
+    generate(args.output, args.batch)
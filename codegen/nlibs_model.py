@@ -0,0 +1,349 @@
+#!/usr/bin/env python3
+############################################################################
+#
+#   Copyright (c) 2015 Elikos Team. All rights reserved.
+#   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+#            @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in
+#    the documentation and/or other materials provided with the
+#    distribution.
+# 3. Neither the name PX4 nor the names of its contributors may be
+#    used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+# OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+# AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+############################################################################
+
+"""
+Symbolic model of the NLIBS control law.
+
+The quadrotor model is written once here: the rotations are built from the
+elementary Euler rotations, Rr^-1 and the time derivative of Rr are derived
+by sympy, and the input gains are read off the model instead of being
+transcribed by hand. The attitude enters as the estimator's rotation
+matrix, the sines and cosines of the Euler angles are read off it.
+nlibs_codegen.py turns the expressions returned by position_law() and
+attitude_law() into the straight-line kernels of nlibs_control_kernel.cpp,
+and into their batch variant in host/nlibs_batch_kernel.cpp.
+
+The law itself follows NLIBSControlLaw::position(), backstepping() and
+mix(), which stay the readable reference: as there, the gyroscopic torques are
+neglected.
+
+Names of the symbols are the C++ expressions the kernel reads them from.
+
+@author Antoine Mignon <mignon.antoine@gmail.com>
+@author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+"""
+
+import sympy as sp
+
+# constants, defined in the generated kernel as in nlibs_control_law.cpp
+SIGMA = sp.Symbol('SIGMA', positive=True)
+RATES_I_LIMIT = sp.Symbol('RATES_I_LIMIT', positive=True)
+ONE_G = sp.Symbol('CONSTANTS_ONE_G', positive=True)
+
+CONSTANTS = [
+    ('SIGMA', '0.000001f'),
+    ('RATES_I_LIMIT', '0.3f'),
+]
+
+# opaque functions, printed as the C++ helpers of the same name
+constrain = sp.Function('constrain')
+wrap_pi = sp.Function('wrap_pi')
+
+
+def vector(name, n):
+    return sp.Matrix([sp.Symbol('%s(%d)' % (name, i), real=True) for i in range(n)])
+
+
+def diagonal(name, n):
+    return sp.diag(*[sp.Symbol('%s(%d)' % (name, i), real=True) for i in range(n)])
+
+
+def state(name, n):
+    return sp.Matrix([sp.Symbol('%s_%d' % (name, i), real=True) for i in range(n)])
+
+
+class Inputs(object):
+    """Symbols of everything one control step reads."""
+
+    def __init__(self):
+        real = {'real': True}
+        positive = {'positive': True}
+
+        self.R = sp.Matrix(3, 3, lambda i, j: sp.Symbol('in.R(%d, %d)' % (i, j), real=True))
+        self.phi = sp.Symbol('in.phi', **real)
+        self.theta = sp.Symbol('in.theta', **real)
+        self.psi = sp.Symbol('in.psi', **real)
+        self.rates = vector('in.rates', 3)
+        self.pos = vector('in.pos', 3)
+        self.vel = vector('in.vel', 3)
+        self.pos_sp = vector('in.pos_sp', 3)
+        self.vel_ff = vector('in.vel_ff', 3)
+        self.roll_sp = sp.Symbol('in.roll_sp', **real)
+        self.pitch_sp = sp.Symbol('in.pitch_sp', **real)
+        self.yaw_sp = sp.Symbol('in.yaw_sp', **real)
+        self.thrust_sp = sp.Symbol('in.thrust_sp', **real)
+        self.position_enabled = sp.Symbol('in.position_enabled')
+        self.altitude_enabled = sp.Symbol('in.altitude_enabled')
+        self.dt = sp.Symbol('dt', **positive)
+
+        self.mass = sp.Symbol('params.q_mass', **positive)
+        self.inertia = sp.diag(*[sp.Symbol('params.q_i%s_moment' % a, **positive) for a in 'xyz'])
+        self.lin_drag = sp.diag(*[sp.Symbol('params.q_%slin_drag' % a, **real) for a in 'xyz'])
+        self.rot_drag = sp.diag(*[sp.Symbol('params.q_%srot_drag' % a, **real) for a in 'xyz'])
+
+        # constants derived from the parameters by nlibs_params_derive()
+        self.inv_mass = sp.Symbol('params.derived.inv_mass', **positive)
+        self.u_z_min = sp.Symbol('params.derived.u_z_min', **positive)
+        self.thrust_to_u_z = sp.Symbol('params.derived.thrust_to_u_z', **positive)
+        self.sin_tilt_max = sp.Symbol('params.derived.sin_tilt_max', **positive)
+        self.B_inv = sp.Matrix(4, 4, lambda i, j: sp.Symbol('params.derived.allocation.B_inv(%d, %d)' % (i, j), real=True))
+        self.f_min = sp.Symbol('params.derived.f_min', **real)
+        self.f_max = sp.Symbol('params.derived.f_max', **real)
+        self.inv_motor_cst = sp.Symbol('params.derived.inv_motor_cst', **positive)
+        self.A = [None] + [diagonal('params.A%d_gain' % k, 2) for k in range(1, 7)] + [diagonal('params.A7_gain', 4)]
+
+        # controller state, previous step
+        self.rates_int = state('rates_int', 3)
+        self.forces = state('forces', 4)
+
+        # references held from the last position update
+        self.outer_phi_sp = sp.Symbol('outer.phi_sp', **real)
+        self.outer_theta_sp = sp.Symbol('outer.theta_sp', **real)
+        self.outer_acc_z = sp.Symbol('outer.acc_z', **real)
+        self.outer_vel_sp = vector('outer.vel_sp', 3)
+
+
+def rotation(phi, theta, psi):
+    """Body to NED rotation, Z-Y-X Euler angles."""
+    s, c = sp.sin, sp.cos
+    Rx = sp.Matrix([[1, 0, 0], [0, c(phi), -s(phi)], [0, s(phi), c(phi)]])
+    Ry = sp.Matrix([[c(theta), 0, s(theta)], [0, 1, 0], [-s(theta), 0, c(theta)]])
+    Rz = sp.Matrix([[c(psi), -s(psi), 0], [s(psi), c(psi), 0], [0, 0, 1]])
+    return Rz * Ry * Rx, Rx, Ry
+
+
+def euler_rates_to_body(Rx, Ry):
+    """Rr, the body rates are Rr * d/dt [phi, theta, psi]."""
+    e = sp.eye(3)
+    return sp.Matrix.hstack(e[:, 0], Rx.T * e[:, 1], (Ry * Rx).T * e[:, 2])
+
+
+def trig_from_rotation(R, angles):
+    """Sines and cosines of the Euler angles of R, pitch within +-90 deg."""
+    phi, theta, psi = angles
+    c_theta = sp.sqrt(R[2, 1] ** 2 + R[2, 2] ** 2)
+    lock = c_theta > SIGMA
+    sec_theta = 1 / sp.Piecewise((c_theta, lock), (SIGMA, True))
+
+    # at gimbal lock only psi - phi or psi + phi is defined: take phi = 0
+    def pick(e, at_lock):
+        return sp.Piecewise((e * sec_theta, lock), (at_lock, True))
+
+    trig = {
+        sp.sin(theta): -R[2, 0],
+        sp.cos(theta): c_theta,
+        sp.sin(phi): pick(R[2, 1], 0),
+        sp.cos(phi): pick(R[2, 2], 1),
+        sp.sin(psi): pick(R[1, 0], -R[0, 1]),
+        sp.cos(psi): pick(R[0, 0], R[1, 1]),
+    }
+
+    return trig, sec_theta
+
+
+class Kinematics(object):
+    """Rotations, Euler rates and input gains at the estimated attitude, shared by both stages."""
+
+    def __init__(self, x):
+        angles = (x.phi, x.theta, x.psi)
+        Rt, Rx, Ry = rotation(*angles)
+        Rr = euler_rates_to_body(Rx, Ry)
+        trig, sec_theta = trig_from_rotation(x.R, angles)
+
+        # the entries read by trig_from_rotation()
+        assert (Rt[2, 0], Rt[2, 1], Rt[2, 2], Rt[0, 0], Rt[1, 0]) == (
+            -sp.sin(x.theta), sp.sin(x.phi) * sp.cos(x.theta), sp.cos(x.phi) * sp.cos(x.theta),
+            sp.cos(x.psi) * sp.cos(x.theta), sp.sin(x.psi) * sp.cos(x.theta))
+
+        # Rr is singular at +-90 deg of pitch, its determinant is cos(theta)
+        assert sp.simplify(Rr.det() - sp.cos(x.theta)) == 0
+        c_theta = sp.cos(x.theta)
+        Rr_inv = Rr.inv().applyfunc(sp.trigsimp).applyfunc(
+            lambda e: e.subs({sp.tan(x.theta): sp.sin(x.theta) / c_theta}).subs({1 / c_theta: sec_theta}))
+
+        # Euler angle rates and the body angular acceleration induced by the variation of Rr
+        eta_dot = Rr_inv * x.rates
+        dRr = sp.zeros(3, 3)
+
+        for i, a in enumerate(angles):
+            dRr += Rr.diff(a) * eta_dot[i]
+
+        rates_drift = dRr * eta_dot
+
+        # from here on the attitude is the estimated rotation
+        def attitude(e):
+            return e.subs(trig)
+
+        self.Rt = x.R
+        self.Rr = Rr.applyfunc(attitude)
+        self.eta_dot = eta_dot.applyfunc(attitude)
+        self.rates_drift = rates_drift.applyfunc(attitude)
+
+        # thrust of the previous step, kept away from zero so that g0 stays invertible
+        u_z = sp.Min(-sum(x.forces), -x.u_z_min)
+
+        # input gains: the thrust tilts through Rt, g0 acts on Varphi0 = [sin(Phi); cos(Phi)*sin(Theta)]
+        s_psi, c_psi = sp.sin(x.psi), sp.cos(x.psi)
+        g0 = (u_z * x.inv_mass) * sp.Matrix([[s_psi, c_psi], [-c_psi, s_psi]])
+        assert (g0 * sp.Matrix([sp.sin(x.phi), sp.cos(x.phi) * sp.sin(x.theta)]) -
+                (u_z * x.inv_mass) * Rt[0:2, 2]).applyfunc(sp.simplify) == sp.zeros(2, 1)
+        # g0 is a scaled rotation, inverted while its entries are still sines and cosines
+        self.g0_inv = g0.inv().applyfunc(sp.trigsimp).applyfunc(attitude).subs(x.inv_mass, 1 / x.mass)
+        # cos(Phi)*cos(Theta) is R(2, 2), the altitude gain is inverted with a single division
+        self.g_z_inv = x.mass / x.R[2, 2]
+
+
+def position_law(x, k):
+    """
+    Position stages, run when the local position changes: x/y position and
+    velocity (A1, A2) and the altitude part of A5, A6.
+
+    @return list of (C++ lvalue, expression) in assignment order
+    """
+    A1, A2, A3, A4, A5, A6, A7 = x.A[1:]
+    Rt = k.Rt
+    out = []
+
+    # linear drag in NED frame
+    acc_drag = Rt * (-x.lin_drag * (Rt.T * x.vel)) * x.inv_mass
+
+    # A1, A2: x/y position and velocity, Varphi0 = [sin(Phi); cos(Phi)*sin(Theta)]
+    e1 = x.pos_sp[0:2, 0] - x.pos[0:2, 0]
+    vel_xy = x.vel[0:2, 0]
+    vel_xy_sp = A1 * e1 + x.vel_ff[0:2, 0]
+    e2 = vel_xy_sp - vel_xy
+    acc_xy = e1 - A1 * vel_xy + A2 * e2 - acc_drag[0:2, 0]
+    varphi0 = k.g0_inv * acc_xy
+
+    sin_tilt_max = x.sin_tilt_max
+    phi_sp = sp.asin(constrain(varphi0[0], -sin_tilt_max, sin_tilt_max))
+    theta_sp = sp.asin(constrain(varphi0[1] / sp.cos(phi_sp), -sin_tilt_max, sin_tilt_max))
+
+    # A5, A6: altitude part of Varphi2, the integral only acts on yaw
+    e5_z = x.pos_sp[2] - x.pos[2]
+    vel_z_sp = A5[1, 1] * e5_z + x.vel_ff[2]
+    e6_z = vel_z_sp - x.vel[2]
+    acc_z = e5_z - A5[1, 1] * x.vel[2] + A6[1, 1] * e6_z - (ONE_G + acc_drag[2])
+
+    out.append(('outer.phi_sp', phi_sp))
+    out.append(('outer.theta_sp', theta_sp))
+    out.append(('outer.acc_z', acc_z))
+    out.append(('outer.vel_sp(0)', sp.Piecewise((vel_xy_sp[0], x.position_enabled), (0, True))))
+    out.append(('outer.vel_sp(1)', sp.Piecewise((vel_xy_sp[1], x.position_enabled), (0, True))))
+    out.append(('outer.vel_sp(2)', sp.Piecewise((vel_z_sp, x.altitude_enabled), (0, True))))
+
+    return out
+
+
+def attitude_law(x, k):
+    """
+    Attitude stages, run on every attitude sample with the references held
+    from the last position update: roll and pitch (A3, A4), the yaw part of
+    A5, A6, allocation and rotor forces (A7).
+
+    @return list of (C++ lvalue, expression) in assignment order
+    """
+    A1, A2, A3, A4, A5, A6, A7 = x.A[1:]
+    eta_dot = k.eta_dot
+    out = []
+
+    # rotational drag in body frame
+    moment_drag = -x.rot_drag * x.rates
+
+    # attitude references, held from the last position update
+    phi_sp = sp.Piecewise((x.outer_phi_sp, x.position_enabled), (x.roll_sp, True))
+    theta_sp = sp.Piecewise((x.outer_theta_sp, x.position_enabled), (x.pitch_sp, True))
+
+    # A3, A4: roll and pitch, Varphi1 = [u_Phi; u_Theta]
+    e3 = sp.Matrix([phi_sp - x.phi, theta_sp - x.theta])
+    eta_dot_rp = eta_dot[0:2, 0]
+    eta_dot_rp_sp = A3 * e3
+    e4 = eta_dot_rp_sp - eta_dot_rp
+    rates_int = [constrain(x.rates_int[i] + e4[i] * x.dt, -RATES_I_LIMIT, RATES_I_LIMIT) for i in range(2)]
+    e4_int = e4 + sp.Matrix(rates_int)
+    acc_rp = e3 - A3 * eta_dot_rp + A4 * e4_int
+
+    # A5, A6: yaw part of Varphi2 = [u_Psy; u_z]
+    e5_psi = wrap_pi(x.yaw_sp - x.psi)
+    eta_dot_psi_sp = A5[0, 0] * e5_psi
+    e6_psi = eta_dot_psi_sp - eta_dot[2]
+    rates_int.append(constrain(x.rates_int[2] + e6_psi * x.dt, -RATES_I_LIMIT, RATES_I_LIMIT))
+    acc_psi = e5_psi - A5[0, 0] * eta_dot[2] + A6[0, 0] * (e6_psi + rates_int[2])
+
+    # torques: the body angular acceleration is Rr*eta_ddot + dRr/dt*eta_dot, Rr is not inverted
+    eta_ddot_sp = sp.Matrix([acc_rp[0], acc_rp[1], acc_psi])
+    torques = x.inertia * (k.Rr * eta_ddot_sp + k.rates_drift)
+
+    # the held vertical acceleration, through the gain of the current tilt
+    u_z_sp = sp.Piecewise((x.outer_acc_z * k.g_z_inv, x.altitude_enabled),
+                          (-x.thrust_sp * x.thrust_to_u_z, True))
+
+    # virtual controls, with the rotational drag compensated
+    u = sp.Matrix([u_z_sp, torques[0] - moment_drag[0], torques[1] - moment_drag[1], torques[2] - moment_drag[2]])
+
+    # body rates setpoint
+    eta_dot_sp = sp.Matrix([eta_dot_rp_sp[0], eta_dot_rp_sp[1], eta_dot_psi_sp])
+    rates_sp = k.Rr * eta_dot_sp
+
+    # inverse of the allocation built by nlibs_allocation_build(), then A7: rotor forces
+    # lag the allocation at A7 (1/s), one step never goes past it
+    forces_sp = x.B_inv * u
+    lag = [constrain(A7[i, i] * x.dt, sp.Float(0), sp.Float(1)) for i in range(4)]
+    forces = [constrain(x.forces[i] + lag[i] * (forces_sp[i] - x.forces[i]), x.f_min, x.f_max) for i in range(4)]
+
+    # normalized motor commands back to thrust and torques for the mixer
+    n = [f * x.inv_motor_cst for f in forces]
+
+    for i in range(3):
+        out.append(('rates_int[%d]' % i, rates_int[i]))
+
+    for i in range(4):
+        out.append(('forces[%d]' % i, forces[i]))
+        out.append(('out.forces(%d)' % i, forces[i]))
+        out.append(('out.motors(%d)' % i, n[i]))
+
+    out.append(('out.att_control(0)', ((n[2] + n[1]) - (n[0] + n[3])) / 4))
+    out.append(('out.att_control(1)', ((n[0] + n[2]) - (n[1] + n[3])) / 4))
+    out.append(('out.att_control(2)', ((n[0] + n[1]) - (n[2] + n[3])) / 4))
+    out.append(('out.thrust', (n[0] + n[1] + n[2] + n[3]) / 4))
+
+    for i in range(3):
+        out.append(('out.rates_sp(%d)' % i, rates_sp[i]))
+
+    for i in range(3):
+        out.append(('out.vel_sp(%d)' % i, x.outer_vel_sp[i]))
+
+    return out
@@ -0,0 +1,218 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_batch.cpp
+ * Structure of arrays batch evaluation of the NLIBS control law: the
+ * columns, and the steps over them. The step itself is generated in
+ * nlibs_batch_kernel.cpp.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_batch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH_ALIGN			64
+#define BATCH_COLUMNS		71
+
+NLIBSBatch::NLIBSBatch(unsigned count) :
+	_count(count),
+	_padded((count + NLIBS_BATCH_LANES - 1) / NLIBS_BATCH_LANES * NLIBS_BATCH_LANES),
+	_data(nullptr)
+{
+	/* whole cache lines per column so that every column stays aligned */
+	_padded = (_padded + BATCH_ALIGN / sizeof(float) - 1) / (BATCH_ALIGN / sizeof(float)) * (BATCH_ALIGN / sizeof(float));
+
+	void *data = nullptr;
+
+	if (posix_memalign(&data, BATCH_ALIGN, (size_t)BATCH_COLUMNS * _padded * sizeof(float)) != 0) {
+		data = nullptr;
+	}
+
+	/* an empty batch when out of memory, count() tells */
+	if (data == nullptr) {
+		_count = 0;
+		_padded = 0;
+	}
+
+	_data = (float *)data;
+
+	if (_data != nullptr) {
+		memset(_data, 0, (size_t)BATCH_COLUMNS * _padded * sizeof(float));
+	}
+
+	float *p = _data;
+
+#define COLUMN(c)	do { c = p; p += _padded; } while (0)
+
+	for (unsigned r = 0; r < 3; r++) {
+		for (unsigned c = 0; c < 3; c++) {
+			COLUMN(R[r][c]);
+		}
+	}
+
+	COLUMN(phi);
+	COLUMN(theta);
+	COLUMN(psi);
+
+	for (unsigned k = 0; k < 3; k++) {
+		COLUMN(rates[k]);
+		COLUMN(pos[k]);
+		COLUMN(vel[k]);
+		COLUMN(pos_sp[k]);
+		COLUMN(vel_ff[k]);
+		COLUMN(rates_int[k]);
+		COLUMN(att_control[k]);
+		COLUMN(rates_sp[k]);
+		COLUMN(vel_sp[k]);
+	}
+
+	COLUMN(roll_sp);
+	COLUMN(pitch_sp);
+	COLUMN(yaw_sp);
+	COLUMN(thrust_sp);
+	COLUMN(thrust);
+	COLUMN(phi_sp);
+	COLUMN(theta_sp);
+	COLUMN(acc_z);
+
+	for (unsigned k = 0; k < 2; k++) {
+		COLUMN(A1[k]);
+		COLUMN(A2[k]);
+		COLUMN(A3[k]);
+		COLUMN(A4[k]);
+		COLUMN(A5[k]);
+		COLUMN(A6[k]);
+	}
+
+	for (unsigned k = 0; k < 4; k++) {
+		COLUMN(A7[k]);
+		COLUMN(forces[k]);
+		COLUMN(motors[k]);
+	}
+
+#undef COLUMN
+}
+
+NLIBSBatch::~NLIBSBatch()
+{
+	free(_data);
+}
+
+void NLIBSBatch::reset()
+{
+	if (_data == nullptr) {
+		return;
+	}
+
+	for (unsigned k = 0; k < 3; k++) {
+		memset(rates_int[k], 0, _padded * sizeof(float));
+	}
+
+	for (unsigned k = 0; k < 4; k++) {
+		memset(forces[k], 0, _padded * sizeof(float));
+	}
+}
+
+void NLIBSBatch::set_gains(unsigned i, const struct nlibs_params_s &params)
+{
+	for (unsigned k = 0; k < 2; k++) {
+		A1[k][i] = params.A1_gain(k);
+		A2[k][i] = params.A2_gain(k);
+		A3[k][i] = params.A3_gain(k);
+		A4[k][i] = params.A4_gain(k);
+		A5[k][i] = params.A5_gain(k);
+		A6[k][i] = params.A6_gain(k);
+	}
+
+	for (unsigned k = 0; k < 4; k++) {
+		A7[k][i] = params.A7_gain(k);
+	}
+}
+
+void NLIBSBatch::set_input(unsigned i, const struct nlibs_input_s &in)
+{
+	for (unsigned r = 0; r < 3; r++) {
+		for (unsigned c = 0; c < 3; c++) {
+			R[r][c][i] = in.R(r, c);
+		}
+	}
+
+	phi[i] = in.phi;
+	theta[i] = in.theta;
+	psi[i] = in.psi;
+
+	for (unsigned k = 0; k < 3; k++) {
+		rates[k][i] = in.rates(k);
+		pos[k][i] = in.pos(k);
+		vel[k][i] = in.vel(k);
+		pos_sp[k][i] = in.pos_sp(k);
+		vel_ff[k][i] = in.vel_ff(k);
+	}
+
+	roll_sp[i] = in.roll_sp;
+	pitch_sp[i] = in.pitch_sp;
+	yaw_sp[i] = in.yaw_sp;
+	thrust_sp[i] = in.thrust_sp;
+}
+
+void NLIBSBatch::get_output(unsigned i, struct nlibs_output_s &out) const
+{
+	for (unsigned k = 0; k < 3; k++) {
+		out.att_control(k) = att_control[k][i];
+		out.rates_sp(k) = rates_sp[k][i];
+		out.vel_sp(k) = vel_sp[k][i];
+	}
+
+	out.thrust = thrust[i];
+
+	for (unsigned k = 0; k < 4; k++) {
+		out.forces(k) = forces[k][i];
+		out.motors(k) = motors[k][i];
+	}
+}
+
+void NLIBSBatch::control(const struct nlibs_params_s &params, bool position_enabled, bool altitude_enabled, float dt)
+{
+	/* both stages on every step, as NLIBSControlLaw::control() */
+	for (unsigned i = 0; i < _padded; i += NLIBS_BATCH_LANES) {
+		position_lanes(params, position_enabled, altitude_enabled, i);
+		attitude_lanes(params, position_enabled, altitude_enabled, dt, i);
+	}
+}
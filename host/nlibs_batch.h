@@ -0,0 +1,166 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_batch.h
+ * Structure of arrays batch evaluation of the NLIBS control law.
+ *
+ * Many independent controllers, each with its own state and A1..A7 gains,
+ * are stepped together: every quantity is a column with one entry per
+ * controller and the control law runs over NLIBS_BATCH_LANES controllers
+ * per vector instruction, 8 with AVX, 4 with SSE and 1 otherwise.
+ *
+ * The step is generated along with the kernel of NLIBSControlLaw::control(),
+ * from the same model and common subexpressions: the arithmetic is the same
+ * operation by operation and the transcendental functions are the libm ones
+ * evaluated per lane, so that every lane gives the same bits as control()
+ * fed with the same input and state. This holds as long as both are built
+ * with the same floating point contraction, i.e. -ffp-contract=off when FMA
+ * is enabled. tests/test_batch.cpp checks it.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include "../nlibs_control_law.h"
+
+/* -DNLIBS_BATCH_LANES=1 forces the scalar code on x86 */
+#ifndef NLIBS_BATCH_LANES
+#if defined(__AVX__)
+#define NLIBS_BATCH_LANES	8
+#elif defined(__SSE2__)
+#define NLIBS_BATCH_LANES	4
+#else
+#define NLIBS_BATCH_LANES	1
+#endif
+#endif
+
+class NLIBSBatch
+{
+public:
+	/**
+	 * @param count		number of controllers, the columns are padded to a multiple of the lanes;
+	 *			count() reads 0 when the columns could not be allocated
+	 */
+	NLIBSBatch(unsigned count);
+	~NLIBSBatch();
+
+	unsigned	count() const { return _count; }
+
+	/**
+	 * Zero the integrators and rotor forces of every controller, as NLIBSControlLaw::reset().
+	 */
+	void	reset();
+
+	/**
+	 * Copy the A1..A7 gains of a parameter set to one controller.
+	 */
+	void	set_gains(unsigned i, const struct nlibs_params_s &params);
+
+	/**
+	 * Copy the state and setpoints of one controller, the mode flags are not
+	 * per controller and are passed to control().
+	 */
+	void	set_input(unsigned i, const struct nlibs_input_s &in);
+
+	void	get_output(unsigned i, struct nlibs_output_s &out) const;
+
+	/**
+	 * Step every controller.
+	 *
+	 * @param params	physical model and limits shared by all controllers, its gains are not used
+	 */
+	void	control(const struct nlibs_params_s &params, bool position_enabled, bool altitude_enabled, float dt);
+
+	/* inputs */
+	float *R[3][3];
+	float *phi;
+	float *theta;
+	float *psi;
+	float *rates[3];
+	float *pos[3];
+	float *vel[3];
+	float *pos_sp[3];
+	float *vel_ff[3];
+	float *roll_sp;
+	float *pitch_sp;
+	float *yaw_sp;
+	float *thrust_sp;
+
+	/* diagonals of the gains */
+	float *A1[2];
+	float *A2[2];
+	float *A3[2];
+	float *A4[2];
+	float *A5[2];
+	float *A6[2];
+	float *A7[4];
+
+	/* controller state */
+	float *rates_int[3];
+	float *forces[4];
+
+	/* references of the position stages, vel_sp below is the velocity setpoint */
+	float *phi_sp;
+	float *theta_sp;
+	float *acc_z;
+
+	/* outputs */
+	float *att_control[3];
+	float *thrust;
+	float *motors[4];
+	float *rates_sp[3];
+	float *vel_sp[3];
+
+private:
+	unsigned _count;
+	unsigned _padded;				/**< column length, multiple of NLIBS_BATCH_LANES */
+	float *_data;					/**< all the columns, one allocation */
+
+	/*
+	 * Position and attitude stages of the controllers in columns i to
+	 * i + NLIBS_BATCH_LANES - 1, generated in nlibs_batch_kernel.cpp.
+	 */
+	void	position_lanes(const struct nlibs_params_s &params, bool position_enabled, bool altitude_enabled,
+			       unsigned i);
+	void	attitude_lanes(const struct nlibs_params_s &params, bool position_enabled, bool altitude_enabled,
+			       float dt, unsigned i);
+
+	/* not copyable, the columns point into _data */
+	NLIBSBatch(const NLIBSBatch &);
+	NLIBSBatch operator=(const NLIBSBatch &);
+};
@@ -0,0 +1,233 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_batch_kernel.cpp
+ * Structure of arrays kernel of NLIBSBatch, NLIBS_BATCH_LANES controllers at a time.
+ *
+ * GENERATED by codegen/nlibs_codegen.py from codegen/nlibs_model.py, along
+ * with nlibs_control_kernel.cpp, do not edit: change the model and run the
+ * generator again.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_batch.h"
+#include "nlibs_lanes.h"
+
+#include <lib/geo/geo.h>
+
+#define SIGMA                   0.000001f
+#define RATES_I_LIMIT           0.3f
+
+void NLIBSBatch::position_lanes(const struct nlibs_params_s &params, bool position_enabled, bool altitude_enabled,
+				unsigned i)
+{
+	const vfloat forces_0 = vload(&forces[0][i]);
+	const vfloat forces_1 = vload(&forces[1][i]);
+	const vfloat forces_2 = vload(&forces[2][i]);
+	const vfloat forces_3 = vload(&forces[3][i]);
+	const vfloat in_R_0_0 = vload(&R[0][0][i]);
+	const vfloat in_R_0_1 = vload(&R[0][1][i]);
+	const vfloat in_R_0_2 = vload(&R[0][2][i]);
+	const vfloat in_R_1_0 = vload(&R[1][0][i]);
+	const vfloat in_R_1_1 = vload(&R[1][1][i]);
+	const vfloat in_R_1_2 = vload(&R[1][2][i]);
+	const vfloat in_R_2_0 = vload(&R[2][0][i]);
+	const vfloat in_R_2_1 = vload(&R[2][1][i]);
+	const vfloat in_R_2_2 = vload(&R[2][2][i]);
+	const vfloat in_pos_0 = vload(&pos[0][i]);
+	const vfloat in_pos_1 = vload(&pos[1][i]);
+	const vfloat in_pos_2 = vload(&pos[2][i]);
+	const vfloat in_pos_sp_0 = vload(&pos_sp[0][i]);
+	const vfloat in_pos_sp_1 = vload(&pos_sp[1][i]);
+	const vfloat in_pos_sp_2 = vload(&pos_sp[2][i]);
+	const vfloat in_vel_0 = vload(&vel[0][i]);
+	const vfloat in_vel_1 = vload(&vel[1][i]);
+	const vfloat in_vel_2 = vload(&vel[2][i]);
+	const vfloat in_vel_ff_0 = vload(&vel_ff[0][i]);
+	const vfloat in_vel_ff_1 = vload(&vel_ff[1][i]);
+	const vfloat in_vel_ff_2 = vload(&vel_ff[2][i]);
+	const vfloat params_A1_gain_0 = vload(&A1[0][i]);
+	const vfloat params_A1_gain_1 = vload(&A1[1][i]);
+	const vfloat params_A2_gain_0 = vload(&A2[0][i]);
+	const vfloat params_A2_gain_1 = vload(&A2[1][i]);
+	const vfloat params_A5_gain_1 = vload(&A5[1][i]);
+	const vfloat params_A6_gain_1 = vload(&A6[1][i]);
+
+	const auto t0 = vsqrtf(in_R_2_1*in_R_2_1 + in_R_2_2*in_R_2_2);
+	const auto t1 = SIGMA < t0;
+	const auto t2 = ((t1) ? (1.0F/(t0)) : (1.0F/(SIGMA)));
+	const auto t3 = ((t1) ? (in_R_0_0*t2) : (in_R_1_1));
+	const auto t4 = params.q_xlin_drag*(in_R_0_0*in_vel_0 + in_R_1_0*in_vel_1 + in_R_2_0*in_vel_2);
+	const auto t5 = params.q_ylin_drag*(in_R_0_1*in_vel_0 + in_R_1_1*in_vel_1 + in_R_2_1*in_vel_2);
+	const auto t6 = params.q_zlin_drag*(in_R_0_2*in_vel_0 + in_R_1_2*in_vel_1 + in_R_2_2*in_vel_2);
+	const auto t7 = in_pos_1 - in_pos_sp_1;
+	const auto t8 = in_vel_ff_1 - params_A1_gain_1*t7;
+	const auto t9 = params.q_mass/vfminf(-params.derived.u_z_min, -forces_0 - forces_1 - forces_2 - forces_3);
+	const auto t10 = t9*(-in_vel_1*params_A1_gain_1 + params_A2_gain_1*(-in_vel_1 + t8) - params.derived.inv_mass*(-in_R_1_0*t4 - in_R_1_1*t5 - in_R_1_2*t6) - t7);
+	const auto t11 = ((t1) ? (in_R_1_0*t2) : (-in_R_0_1));
+	const auto t12 = in_pos_0 - in_pos_sp_0;
+	const auto t13 = in_vel_ff_0 - params_A1_gain_0*t12;
+	const auto t14 = t9*(-in_vel_0*params_A1_gain_0 + params_A2_gain_0*(-in_vel_0 + t13) - params.derived.inv_mass*(-in_R_0_0*t4 - in_R_0_1*t5 - in_R_0_2*t6) - t12);
+	const auto t15 = -params.derived.sin_tilt_max;
+	const auto t16 = vconstrain(-t10*t3 + t11*t14, t15, params.derived.sin_tilt_max);
+	const auto t17 = in_pos_2 - in_pos_sp_2;
+	const auto t18 = in_vel_ff_2 - params_A5_gain_1*t17;
+
+	vstore(&phi_sp[i], vasinf(t16));
+	vstore(&theta_sp[i], vasinf(vconstrain((t10*t11 + t14*t3)/vsqrtf(1 - t16*t16), t15, params.derived.sin_tilt_max)));
+	vstore(&acc_z[i], -CONSTANTS_ONE_G - in_vel_2*params_A5_gain_1 + params_A6_gain_1*(-in_vel_2 + t18) - params.derived.inv_mass*(-in_R_2_0*t4 - in_R_2_1*t5 - in_R_2_2*t6) - t17);
+	vstore(&vel_sp[0][i], ((position_enabled) ? (t13) : (vset(0.0F))));
+	vstore(&vel_sp[1][i], ((position_enabled) ? (t8) : (vset(0.0F))));
+	vstore(&vel_sp[2][i], ((altitude_enabled) ? (t18) : (vset(0.0F))));
+}
+
+void NLIBSBatch::attitude_lanes(const struct nlibs_params_s &params, bool position_enabled, bool altitude_enabled,
+				float dt, unsigned i)
+{
+	const vfloat forces_0 = vload(&forces[0][i]);
+	const vfloat forces_1 = vload(&forces[1][i]);
+	const vfloat forces_2 = vload(&forces[2][i]);
+	const vfloat forces_3 = vload(&forces[3][i]);
+	const vfloat in_R_2_0 = vload(&R[2][0][i]);
+	const vfloat in_R_2_1 = vload(&R[2][1][i]);
+	const vfloat in_R_2_2 = vload(&R[2][2][i]);
+	const vfloat in_phi = vload(&phi[i]);
+	const vfloat in_pitch_sp = vload(&pitch_sp[i]);
+	const vfloat in_psi = vload(&psi[i]);
+	const vfloat in_rates_0 = vload(&rates[0][i]);
+	const vfloat in_rates_1 = vload(&rates[1][i]);
+	const vfloat in_rates_2 = vload(&rates[2][i]);
+	const vfloat in_roll_sp = vload(&roll_sp[i]);
+	const vfloat in_theta = vload(&theta[i]);
+	const vfloat in_thrust_sp = vload(&thrust_sp[i]);
+	const vfloat in_yaw_sp = vload(&yaw_sp[i]);
+	const vfloat outer_acc_z = vload(&acc_z[i]);
+	const vfloat outer_phi_sp = vload(&phi_sp[i]);
+	const vfloat outer_theta_sp = vload(&theta_sp[i]);
+	const vfloat outer_vel_sp_0 = vload(&vel_sp[0][i]);
+	const vfloat outer_vel_sp_1 = vload(&vel_sp[1][i]);
+	const vfloat outer_vel_sp_2 = vload(&vel_sp[2][i]);
+	const vfloat params_A3_gain_0 = vload(&A3[0][i]);
+	const vfloat params_A3_gain_1 = vload(&A3[1][i]);
+	const vfloat params_A4_gain_0 = vload(&A4[0][i]);
+	const vfloat params_A4_gain_1 = vload(&A4[1][i]);
+	const vfloat params_A5_gain_0 = vload(&A5[0][i]);
+	const vfloat params_A6_gain_0 = vload(&A6[0][i]);
+	const vfloat params_A7_gain_0 = vload(&A7[0][i]);
+	const vfloat params_A7_gain_1 = vload(&A7[1][i]);
+	const vfloat params_A7_gain_2 = vload(&A7[2][i]);
+	const vfloat params_A7_gain_3 = vload(&A7[3][i]);
+	const vfloat rates_int_0 = vload(&rates_int[0][i]);
+	const vfloat rates_int_1 = vload(&rates_int[1][i]);
+	const vfloat rates_int_2 = vload(&rates_int[2][i]);
+
+	const auto t0 = ((position_enabled) ? (outer_phi_sp) : (in_roll_sp));
+	const auto t1 = params_A3_gain_0*(-in_phi + t0);
+	const auto t2 = vsqrtf(in_R_2_1*in_R_2_1 + in_R_2_2*in_R_2_2);
+	const auto t3 = SIGMA < t2;
+	const auto t4 = ((t3) ? (1.0F/(t2)) : (1.0F/(SIGMA)));
+	const auto t5 = ((t3) ? (in_R_2_1*t4) : (vset(0.0F)));
+	const auto t6 = in_rates_1*t4*t5;
+	const auto t7 = ((t3) ? (in_R_2_2*t4) : (vset(1.0F)));
+	const auto t8 = in_rates_2*t4*t7;
+	const auto t9 = in_R_2_0*t6 + in_R_2_0*t8 - in_rates_0;
+	const auto t10 = t1 + t9;
+	const auto t11 = -RATES_I_LIMIT;
+	const auto t12 = vconstrain(dt*t10 + rates_int_0, t11, RATES_I_LIMIT);
+	const auto t13 = in_theta - ((position_enabled) ? (outer_theta_sp) : (in_pitch_sp));
+	const auto t14 = -params_A3_gain_1*t13;
+	const auto t15 = in_rates_2*t5;
+	const auto t16 = in_rates_1*t7;
+	const auto t17 = t14 + t15 - t16;
+	const auto t18 = vconstrain(dt*t17 + rates_int_1, t11, RATES_I_LIMIT);
+	const auto t19 = vwrap_pi(-in_psi + in_yaw_sp);
+	const auto t20 = t6 + t8;
+	const auto t21 = -params_A5_gain_0*t19 + t20;
+	const auto t22 = vconstrain(-dt*t21 + rates_int_2, t11, RATES_I_LIMIT);
+	const auto t23 = ((altitude_enabled) ? (outer_acc_z*params.q_mass/in_R_2_2) : (-in_thrust_sp*params.derived.thrust_to_u_z));
+	const auto t24 = -t9;
+	const auto t25 = -t15 + t16;
+	const auto t26 = -params_A5_gain_0*t20 + params_A6_gain_0*(-t21 + t22) + t19;
+	const auto t27 = in_rates_0*params.q_xrot_drag + params.q_ix_moment*(in_R_2_0*t26 - in_phi - params_A3_gain_0*t24 + params_A4_gain_0*(t10 + t12) + t0 - t2*t20*t25);
+	const auto t28 = t25*t5;
+	const auto t29 = -params_A3_gain_1*t25 + params_A4_gain_1*(t17 + t18) - t13;
+	const auto t30 = t2*t24;
+	const auto t31 = t2*t26;
+	const auto t32 = in_rates_1*params.q_yrot_drag + params.q_iy_moment*(t20*(in_R_2_0*t28 + t30*t7) - t24*t28 + t29*t7 + t31*t5);
+	const auto t33 = t25*t7;
+	const auto t34 = in_rates_2*params.q_zrot_drag + params.q_iz_moment*(t20*(in_R_2_0*t33 - t30*t5) - t24*t33 - t29*t5 + t31*t7);
+	const auto t35 = vconstrain(forces_0 + (-forces_0 + params.derived.allocation.B_inv(0, 0)*t23 + params.derived.allocation.B_inv(0, 1)*t27 + params.derived.allocation.B_inv(0, 2)*t32 + params.derived.allocation.B_inv(0, 3)*t34)*vconstrain(dt*params_A7_gain_0, 0.0F, 1.0F), params.derived.f_min, params.derived.f_max);
+	const auto t36 = params.derived.inv_motor_cst*t35;
+	const auto t37 = vconstrain(forces_1 + (-forces_1 + params.derived.allocation.B_inv(1, 0)*t23 + params.derived.allocation.B_inv(1, 1)*t27 + params.derived.allocation.B_inv(1, 2)*t32 + params.derived.allocation.B_inv(1, 3)*t34)*vconstrain(dt*params_A7_gain_1, 0.0F, 1.0F), params.derived.f_min, params.derived.f_max);
+	const auto t38 = params.derived.inv_motor_cst*t37;
+	const auto t39 = vconstrain(forces_2 + (-forces_2 + params.derived.allocation.B_inv(2, 0)*t23 + params.derived.allocation.B_inv(2, 1)*t27 + params.derived.allocation.B_inv(2, 2)*t32 + params.derived.allocation.B_inv(2, 3)*t34)*vconstrain(dt*params_A7_gain_2, 0.0F, 1.0F), params.derived.f_min, params.derived.f_max);
+	const auto t40 = params.derived.inv_motor_cst*t39;
+	const auto t41 = vconstrain(forces_3 + (-forces_3 + params.derived.allocation.B_inv(3, 0)*t23 + params.derived.allocation.B_inv(3, 1)*t27 + params.derived.allocation.B_inv(3, 2)*t32 + params.derived.allocation.B_inv(3, 3)*t34)*vconstrain(dt*params_A7_gain_3, 0.0F, 1.0F), params.derived.f_min, params.derived.f_max);
+	const auto t42 = params.derived.inv_motor_cst*t41;
+	const auto t43 = (0.25F)*t40;
+	const auto t44 = -t43;
+	const auto t45 = (0.25F)*t42;
+	const auto t46 = (0.25F)*t38;
+	const auto t47 = (0.25F)*t36;
+	const auto t48 = -t46 + t47;
+	const auto t49 = -t45;
+	const auto t50 = t46 + t47;
+	const auto t51 = params_A5_gain_0*t19;
+
+	vstore(&rates_int[0][i], t12);
+	vstore(&rates_int[1][i], t18);
+	vstore(&rates_int[2][i], t22);
+	vstore(&forces[0][i], t35);
+	vstore(&motors[0][i], t36);
+	vstore(&forces[1][i], t37);
+	vstore(&motors[1][i], t38);
+	vstore(&forces[2][i], t39);
+	vstore(&motors[2][i], t40);
+	vstore(&forces[3][i], t41);
+	vstore(&motors[3][i], t42);
+	vstore(&att_control[0][i], -t44 - t45 - t48);
+	vstore(&att_control[1][i], t43 + t48 + t49);
+	vstore(&att_control[2][i], t44 + t49 + t50);
+	vstore(&thrust[i], t43 + t45 + t50);
+	vstore(&rates_sp[0][i], in_R_2_0*t51 + t1);
+	vstore(&rates_sp[1][i], t14*t7 + t2*t5*t51);
+	vstore(&rates_sp[2][i], params_A5_gain_0*t19*t2*t7 - t14*t5);
+	vstore(&vel_sp[0][i], outer_vel_sp_0);
+	vstore(&vel_sp[1][i], outer_vel_sp_1);
+	vstore(&vel_sp[2][i], outer_vel_sp_2);
+}
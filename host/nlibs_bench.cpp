@@ -0,0 +1,372 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_bench.cpp
+ * Microbenchmarks of the NLIBS control law, whole step and per stage.
+ *
+ * Every benchmark runs its stage over a table of attitude and position
+ * samples until the minimum time is reached, then reports the time and
+ * CPU cycles per call as JSON. control_att_and_pos runs the generated
+ * kernel, control_reference the hand written stages timed one by one
+ * after it. control_batch steps a whole NLIBSBatch per call and also
+ * reports the controllers stepped per second.
+ *
+ * usage: nlibs_bench [-t min_time_s] [-o output.json]
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nlibs_batch.h"
+#include "nlibs_host.h"
+
+#define BENCH_SAMPLES		64
+#define BENCH_DT			0.004f
+#define BENCH_BATCH			1024
+
+struct bench_ctx_s {
+	NLIBSControlLaw law;
+	struct nlibs_params_s params;
+	struct nlibs_input_s in[BENCH_SAMPLES];
+	struct nlibs_matrices_s m;
+	struct nlibs_outer_s outer;
+	struct nlibs_output_s out;
+	math::Vector<4> u;
+	unsigned i;
+
+	NLIBSBatch batch;
+
+	bench_ctx_s() : batch(BENCH_BATCH) {}
+};
+
+struct bench_s {
+	const char *name;
+	void (*run)(struct bench_ctx_s &ctx);
+	unsigned items;			/**< controllers stepped per call */
+};
+
+struct bench_result_s {
+	uint64_t iterations;
+	double real_ns;
+	double cpu_ns;
+	double cycles;
+};
+
+static void bench_control(struct bench_ctx_s &ctx)
+{
+	ctx.law.control(ctx.params, ctx.in[ctx.i], BENCH_DT, ctx.out);
+}
+
+static void bench_update_position(struct bench_ctx_s &ctx)
+{
+	ctx.law.update_position(ctx.params, ctx.in[ctx.i]);
+}
+
+static void bench_control_attitude(struct bench_ctx_s &ctx)
+{
+	ctx.law.control_attitude(ctx.params, ctx.in[ctx.i], BENCH_DT, ctx.out);
+}
+
+static void bench_control_reference(struct bench_ctx_s &ctx)
+{
+	ctx.law.control_reference(ctx.params, ctx.in[ctx.i], BENCH_DT, ctx.out);
+}
+
+static void bench_trig(struct bench_ctx_s &ctx)
+{
+	const struct nlibs_input_s &in = ctx.in[ctx.i];
+	ctx.law.update_trig(in.R);
+}
+
+static void bench_rotation(struct bench_ctx_s &ctx)
+{
+	ctx.law.build_rotation(ctx.in[ctx.i].R, ctx.m);
+}
+
+static void bench_rotation_derivatives(struct bench_ctx_s &ctx)
+{
+	ctx.law.build_rotation_derivatives(ctx.m);
+}
+
+static void bench_gains(struct bench_ctx_s &ctx)
+{
+	ctx.law.build_gains(ctx.params, ctx.m);
+}
+
+static void bench_position(struct bench_ctx_s &ctx)
+{
+	ctx.law.position(ctx.params, ctx.in[ctx.i], ctx.m, ctx.outer);
+}
+
+static void bench_backstepping(struct bench_ctx_s &ctx)
+{
+	ctx.law.backstepping(ctx.params, ctx.in[ctx.i], BENCH_DT, ctx.m, ctx.outer, ctx.u, ctx.out);
+}
+
+static void bench_mix(struct bench_ctx_s &ctx)
+{
+	ctx.law.mix(ctx.params, ctx.u, BENCH_DT, ctx.out);
+}
+
+static void bench_batch(struct bench_ctx_s &ctx)
+{
+	ctx.batch.control(ctx.params, true, true, BENCH_DT);
+}
+
+static const struct bench_s benchmarks[] = {
+	{ "control_att_and_pos", bench_control, 1 },
+	{ "update_position", bench_update_position, 1 },
+	{ "control_attitude", bench_control_attitude, 1 },
+	{ "control_reference", bench_control_reference, 1 },
+	{ "trig", bench_trig, 1 },
+	{ "rotation", bench_rotation, 1 },
+	{ "rotation_derivatives", bench_rotation_derivatives, 1 },
+	{ "gains", bench_gains, 1 },
+	{ "position", bench_position, 1 },
+	{ "backstepping", bench_backstepping, 1 },
+	{ "mixer", bench_mix, 1 },
+	{ "control_batch", bench_batch, BENCH_BATCH },
+};
+
+static void bench_init(struct bench_ctx_s &ctx)
+{
+	nlibs_host_default_params(ctx.params);
+
+	/* deterministic spread of attitudes, positions and setpoints */
+	srand(1);
+
+	for (unsigned i = 0; i < BENCH_SAMPLES; i++) {
+		struct nlibs_input_s &in = ctx.in[i];
+
+		float r[12];
+
+		for (unsigned k = 0; k < 12; k++) {
+			r[k] = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+		}
+
+		in.phi = 0.5f * r[0];
+		in.theta = 0.5f * r[1];
+		in.psi = 3.0f * r[2];
+		in.R.from_euler(in.phi, in.theta, in.psi);
+		in.rates(0) = r[3];
+		in.rates(1) = r[4];
+		in.rates(2) = r[5];
+		in.pos(0) = 10.0f * r[6];
+		in.pos(1) = 10.0f * r[7];
+		in.pos(2) = -5.0f + r[8];
+		in.vel(0) = 2.0f * r[9];
+		in.vel(1) = 2.0f * r[10];
+		in.vel(2) = r[11];
+		in.pos_sp.zero();
+		in.pos_sp(2) = -5.0f;
+		in.vel_ff.zero();
+		in.roll_sp = 0.0f;
+		in.pitch_sp = 0.0f;
+		in.yaw_sp = 0.0f;
+		in.thrust_sp = 0.0f;
+		in.position_enabled = true;
+		in.altitude_enabled = true;
+	}
+
+	/* the batch runs the same samples over and over */
+	for (unsigned i = 0; i < BENCH_BATCH; i++) {
+		ctx.batch.set_gains(i, ctx.params);
+		ctx.batch.set_input(i, ctx.in[i % BENCH_SAMPLES]);
+	}
+
+	/* prime the intermediate results used by the single stage benchmarks */
+	ctx.i = 0;
+	ctx.law.control(ctx.params, ctx.in[0], BENCH_DT, ctx.out);
+	ctx.law.update_trig(ctx.in[0].R);
+	ctx.law.build_rotation(ctx.in[0].R, ctx.m);
+	ctx.law.build_rotation_derivatives(ctx.m);
+	ctx.law.build_gains(ctx.params, ctx.m);
+	ctx.law.position(ctx.params, ctx.in[0], ctx.m, ctx.outer);
+	ctx.law.backstepping(ctx.params, ctx.in[0], BENCH_DT, ctx.m, ctx.outer, ctx.u, ctx.out);
+}
+
+static void bench_run(const struct bench_s &b, struct bench_ctx_s &ctx, double min_time, struct bench_result_s &res)
+{
+	uint64_t iterations = 64;
+
+	for (;;) {
+		uint64_t t0 = nlibs_host_time_ns();
+		uint64_t c0 = nlibs_host_cpu_time_ns();
+		uint64_t k0 = nlibs_host_cycles();
+
+		for (uint64_t n = 0; n < iterations; n++) {
+			ctx.i = (unsigned)(n % BENCH_SAMPLES);
+			b.run(ctx);
+		}
+
+		uint64_t k1 = nlibs_host_cycles();
+		uint64_t c1 = nlibs_host_cpu_time_ns();
+		uint64_t t1 = nlibs_host_time_ns();
+
+		double elapsed = (double)(t1 - t0) * 1e-9;
+
+		if (elapsed >= min_time || iterations >= (1ULL << 40)) {
+			res.iterations = iterations;
+			res.real_ns = (double)(t1 - t0) / (double)iterations;
+			res.cpu_ns = (double)(c1 - c0) / (double)iterations;
+			res.cycles = (double)(k1 - k0) / (double)iterations;
+			return;
+		}
+
+		/* aim a bit above the minimum time on the next pass */
+		double scale = (elapsed > 0.0) ? 1.4 * min_time / elapsed : 10.0;
+
+		if (scale > 10.0) {
+			scale = 10.0;
+		}
+
+		iterations = (uint64_t)((double)iterations * scale) + 1;
+	}
+}
+
+/* a JSON string, quotes included, escaping what JSON does not allow as is */
+static void json_string(FILE *f, const char *str)
+{
+	fputc('"', f);
+
+	for (const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			fprintf(f, "\\%c", *c);
+
+		} else if (*c < 0x20) {
+			fprintf(f, "\\u%04x", *c);
+
+		} else {
+			fputc(*c, f);
+		}
+	}
+
+	fputc('"', f);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t min_time_s] [-o output.json]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	double min_time = 0.5;
+	const char *out_path = nullptr;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "t:o:h")) != -1) {
+		switch (ch) {
+		case 't':
+			min_time = atof(optarg);
+			break;
+
+		case 'o':
+			out_path = optarg;
+			break;
+
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	FILE *f = stdout;
+
+	if (out_path != nullptr) {
+		f = fopen(out_path, "w");
+
+		if (f == nullptr) {
+			perror(out_path);
+			return 1;
+		}
+	}
+
+	static struct bench_ctx_s ctx;
+	bench_init(ctx);
+
+	char date[32];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+	fprintf(f, "{\n");
+	fprintf(f, "  \"context\": {\n");
+	fprintf(f, "    \"date\": \"%s\",\n", date);
+	fprintf(f, "    \"executable\": ");
+	json_string(f, argv[0]);
+	fprintf(f, ",\n");
+	fprintf(f, "    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+	fprintf(f, "    \"min_time\": %g\n", min_time);
+	fprintf(f, "  },\n");
+	fprintf(f, "  \"benchmarks\": [\n");
+
+	const unsigned count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+	for (unsigned i = 0; i < count; i++) {
+		struct bench_result_s res;
+		bench_run(benchmarks[i], ctx, min_time, res);
+
+		fprintf(f, "    {\n");
+		fprintf(f, "      \"name\": \"nlibs/%s\",\n", benchmarks[i].name);
+		fprintf(f, "      \"iterations\": %llu,\n", (unsigned long long)res.iterations);
+		fprintf(f, "      \"real_time\": %.3f,\n", res.real_ns);
+		fprintf(f, "      \"cpu_time\": %.3f,\n", res.cpu_ns);
+		fprintf(f, "      \"time_unit\": \"ns\",\n");
+
+		if (benchmarks[i].items > 1) {
+			fprintf(f, "      \"items_per_second\": %.0f,\n", (double)benchmarks[i].items * 1e9 / res.real_ns);
+		}
+
+		fprintf(f, "      \"cycles\": %.1f\n", res.cycles);
+		fprintf(f, "    }%s\n", (i + 1 < count) ? "," : "");
+	}
+
+	fprintf(f, "  ]\n");
+	fprintf(f, "}\n");
+
+	if (f != stdout) {
+		fclose(f);
+	}
+
+	return 0;
+}
@@ -0,0 +1,367 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_columns.cpp
+ * Append only columnar result files for the host side NLIBS tools.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_columns.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define HEADER_FILE		"header.txt"
+#define INDEX_FILE		"index.u64"
+#define VALUE_SUFFIX	".f32"
+
+static bool write_all(int fd, const void *data, size_t size)
+{
+	const char *p = (const char *)data;
+
+	while (size > 0) {
+		ssize_t n = write(fd, p, size);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (n <= 0) {
+			return false;
+		}
+
+		p += n;
+		size -= (size_t)n;
+	}
+
+	return true;
+}
+
+/**
+ * Whole file in a malloc'ed, nul terminated buffer.
+ */
+static char *read_file(const char *path, size_t &size)
+{
+	FILE *f = fopen(path, "rb");
+
+	if (f == nullptr) {
+		return nullptr;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	char *buf = (len >= 0) ? (char *)malloc((size_t)len + 1) : nullptr;
+
+	if (buf != nullptr && fread(buf, 1, (size_t)len, f) != (size_t)len) {
+		free(buf);
+		buf = nullptr;
+	}
+
+	fclose(f);
+
+	if (buf != nullptr) {
+		buf[len] = '\0';
+		size = (size_t)len;
+	}
+
+	return buf;
+}
+
+NLIBSColumns::NLIBSColumns() :
+	_count(0),
+	_rows(0),
+	_index_fd(-1),
+	_index(nullptr)
+{
+	for (unsigned c = 0; c < NLIBS_COLUMNS_MAX; c++) {
+		_names[c][0] = '\0';
+		_value_fd[c] = -1;
+		_values[c] = nullptr;
+	}
+}
+
+NLIBSColumns::~NLIBSColumns()
+{
+	close();
+}
+
+void NLIBSColumns::close()
+{
+	if (_index_fd >= 0) {
+		::close(_index_fd);
+		_index_fd = -1;
+	}
+
+	for (unsigned c = 0; c < NLIBS_COLUMNS_MAX; c++) {
+		if (_value_fd[c] >= 0) {
+			::close(_value_fd[c]);
+			_value_fd[c] = -1;
+		}
+
+		free(_values[c]);
+		_values[c] = nullptr;
+	}
+
+	free(_index);
+	_index = nullptr;
+	_count = 0;
+	_rows = 0;
+}
+
+bool NLIBSColumns::open(const char *dir, const char *header, const char *const *names, unsigned count)
+{
+	close();
+
+	if (count > NLIBS_COLUMNS_MAX) {
+		return false;
+	}
+
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+		return false;
+	}
+
+	/* the header names the run and its columns */
+	size_t len = strlen(header) + 32;
+
+	for (unsigned c = 0; c < count; c++) {
+		len += strlen(names[c]) + 1;
+	}
+
+	char *text = (char *)malloc(len);
+
+	if (text == nullptr) {
+		return false;
+	}
+
+	int n = snprintf(text, len, "%s\ncolumns", header);
+
+	for (unsigned c = 0; c < count; c++) {
+		n += snprintf(text + n, len - (size_t)n, " %s", names[c]);
+	}
+
+	snprintf(text + n, len - (size_t)n, "\n");
+
+	char path[512];
+	snprintf(path, sizeof(path), "%s/" HEADER_FILE, dir);
+
+	size_t size;
+	char *existing = read_file(path, size);
+	bool ok = true;
+
+	if (existing != nullptr) {
+		ok = (strcmp(existing, text) == 0);
+		free(existing);
+
+	} else {
+		FILE *f = fopen(path, "w");
+		ok = (f != nullptr && fputs(text, f) >= 0);
+
+		if (f != nullptr && fclose(f) != 0) {
+			ok = false;
+		}
+	}
+
+	free(text);
+
+	if (!ok) {
+		return false;
+	}
+
+	_count = count;
+
+	for (unsigned c = 0; c < count; c++) {
+		snprintf(_names[c], sizeof(_names[c]), "%s", names[c]);
+	}
+
+	/* complete rows only, a run may have been killed in the middle of an append */
+	if (!read_back(dir)) {
+		close();
+		return false;
+	}
+
+	snprintf(path, sizeof(path), "%s/" INDEX_FILE, dir);
+	_index_fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+	if (_index_fd < 0 || ftruncate(_index_fd, (off_t)(_rows * sizeof(uint64_t))) != 0) {
+		close();
+		return false;
+	}
+
+	for (unsigned c = 0; c < count; c++) {
+		snprintf(path, sizeof(path), "%s/%s" VALUE_SUFFIX, dir, _names[c]);
+		_value_fd[c] = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+		if (_value_fd[c] < 0 || ftruncate(_value_fd[c], (off_t)(_rows * sizeof(float))) != 0) {
+			close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool NLIBSColumns::read_back(const char *dir)
+{
+	char path[512];
+	size_t size = 0;
+
+	snprintf(path, sizeof(path), "%s/" INDEX_FILE, dir);
+	char *index = read_file(path, size);
+	uint64_t rows = (index != nullptr) ? size / sizeof(uint64_t) : 0;
+
+	for (unsigned c = 0; c < _count; c++) {
+		snprintf(path, sizeof(path), "%s/%s" VALUE_SUFFIX, dir, _names[c]);
+		char *values = read_file(path, size);
+
+		if (values == nullptr) {
+			size = 0;
+		}
+
+		if (size / sizeof(float) < rows) {
+			rows = size / sizeof(float);
+		}
+
+		free(_values[c]);
+		_values[c] = (float *)values;
+	}
+
+	free(_index);
+	_index = (uint64_t *)index;
+	_rows = rows;
+
+	return true;
+}
+
+bool NLIBSColumns::append(const uint64_t *index, const float *values, unsigned rows)
+{
+	if (_index_fd < 0 || rows == 0) {
+		return _index_fd >= 0;
+	}
+
+	float *column = (float *)malloc(rows * sizeof(float));
+
+	if (column == nullptr) {
+		return false;
+	}
+
+	bool ok = true;
+
+	for (unsigned c = 0; c < _count && ok; c++) {
+		for (unsigned r = 0; r < rows; r++) {
+			column[r] = values[r * _count + c];
+		}
+
+		ok = write_all(_value_fd[c], column, rows * sizeof(float));
+	}
+
+	free(column);
+
+	/* index last, the rows only count once it is written */
+	ok = ok && write_all(_index_fd, index, rows * sizeof(uint64_t));
+
+	if (ok) {
+		_rows += rows;
+	}
+
+	return ok;
+}
+
+bool NLIBSColumns::load(const char *dir)
+{
+	close();
+
+	char path[512];
+	size_t size;
+
+	snprintf(path, sizeof(path), "%s/" HEADER_FILE, dir);
+	char *text = read_file(path, size);
+
+	if (text == nullptr) {
+		return false;
+	}
+
+	const char *line = strstr(text, "columns");
+
+	while (line != nullptr && line != text && line[-1] != '\n') {
+		line = strstr(line + 1, "columns");
+	}
+
+	if (line == nullptr) {
+		free(text);
+		return false;
+	}
+
+	/* column names, space separated up to the end of the line */
+	const char *p = line + strlen("columns");
+
+	while (*p == ' ' && _count < NLIBS_COLUMNS_MAX) {
+		p++;
+		size_t len = strcspn(p, " \n");
+
+		if (len == 0 || len >= sizeof(_names[0])) {
+			break;
+		}
+
+		memcpy(_names[_count], p, len);
+		_names[_count][len] = '\0';
+		_count++;
+		p += len;
+	}
+
+	free(text);
+
+	return read_back(dir);
+}
+
+int NLIBSColumns::find(const char *name) const
+{
+	for (unsigned c = 0; c < _count; c++) {
+		if (strcmp(_names[c], name) == 0) {
+			return (int)c;
+		}
+	}
+
+	return -1;
+}
@@ -0,0 +1,112 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_columns.h
+ * Append only columnar result files for the host side NLIBS tools.
+ *
+ * A result set is a directory with one raw little endian file per column:
+ * index.u64 holds the job number of every row, <name>.f32 one float per
+ * row. header.txt describes the run and lists the columns. Rows are written
+ * value columns first and index last, so the index column never holds a row
+ * the others miss; a run killed half way is cut back to its complete rows
+ * when reopened, which is what makes runs resumable.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define NLIBS_COLUMNS_MAX	64
+
+class NLIBSColumns
+{
+public:
+	NLIBSColumns();
+	~NLIBSColumns();
+
+	/**
+	 * Create a result directory, or reopen it for appending.
+	 *
+	 * @param header	description of the run, a reopened directory must hold the same
+	 * @param names		names of the float columns
+	 * @return false on I/O error or when the directory holds another run
+	 */
+	bool	open(const char *dir, const char *header, const char *const *names, unsigned count);
+
+	/**
+	 * Append rows.
+	 *
+	 * @param index		job number of every row
+	 * @param values	row major, count floats per row
+	 */
+	bool	append(const uint64_t *index, const float *values, unsigned rows);
+
+	/**
+	 * Read a result directory back in memory.
+	 */
+	bool	load(const char *dir);
+
+	void	close();
+
+	uint64_t	rows() const { return _rows; }
+	unsigned	columns() const { return _count; }
+	const char	*name(unsigned c) const { return _names[c]; }
+
+	/**
+	 * Column number by name, -1 when there is none.
+	 */
+	int	find(const char *name) const;
+
+	/* loaded data, valid after load() or open() */
+	const uint64_t	*index() const { return _index; }
+	const float	*column(unsigned c) const { return _values[c]; }
+
+private:
+	unsigned _count;
+	char _names[NLIBS_COLUMNS_MAX][64];
+	uint64_t _rows;
+
+	int _index_fd;
+	int _value_fd[NLIBS_COLUMNS_MAX];
+
+	uint64_t *_index;
+	float *_values[NLIBS_COLUMNS_MAX];
+
+	bool	read_back(const char *dir);
+};
@@ -0,0 +1,286 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_host.cpp
+ * Helpers shared by the host side NLIBS tools.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_host.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+void nlibs_host_default_params(struct nlibs_params_s &params)
+{
+	params.q_mass = 1.0f;
+	params.q_ix_moment = 0.0001f;
+	params.q_iy_moment = 0.0001f;
+	params.q_iz_moment = 0.0001f;
+	params.q_arm_length = 0.01f;
+	params.q_drag_coeff = 0.01f;
+	params.q_xlin_drag = 0.01f;
+	params.q_ylin_drag = 0.01f;
+	params.q_zlin_drag = 0.01f;
+	params.q_xrot_drag = 0.01f;
+	params.q_yrot_drag = 0.01f;
+	params.q_zrot_drag = 0.01f;
+	params.q_rotor_radius = 0.25f;
+	params.q_rotor_twist_angle = 0.01f;
+	params.q_rotor_root_angle = 0.01f;
+	params.q_motor_cst = 5.0f;
+
+	params.thr_min = 0.1f;
+	params.thr_max = 1.0f;
+	params.tilt_max_air = math::radians(45.0f);
+	params.land_speed = 1.0f;
+	params.tilt_max_land = math::radians(15.0f);
+	params.man_roll_max = math::radians(35.0f);
+	params.man_pitch_max = math::radians(35.0f);
+	params.man_yaw_max = math::radians(120.0f);
+	params.roll_rate_max = 360.0f;
+	params.pitch_rate_max = 360.0f;
+	params.yaw_rate_max = 360.0f;
+	params.xy_vel_max = 5.0f;
+	params.xy_ff = 0.5f;
+
+	params.nlibs_rate_max(0) = math::radians(params.roll_rate_max);
+	params.nlibs_rate_max(1) = math::radians(params.pitch_rate_max);
+	params.nlibs_rate_max(2) = math::radians(params.yaw_rate_max);
+
+	params.A1_gain(0) = 1.5f;
+	params.A1_gain(1) = 1.5f;
+	params.A2_gain(0) = 1.5f;
+	params.A2_gain(1) = 1.5f;
+	params.A3_gain(0) = 20.0f;
+	params.A3_gain(1) = 20.0f;
+	params.A4_gain(0) = 20.0f;
+	params.A4_gain(1) = 20.0f;
+	params.A5_gain(0) = 4.0f;
+	params.A5_gain(1) = 3.0f;
+	params.A6_gain(0) = 10.0f;
+	params.A6_gain(1) = 3.0f;
+
+	for (unsigned i = 0; i < 4; i++) {
+		params.A7_gain(i) = 100.0f;
+	}
+
+	params.poll_timeout = 5;
+	params.out_direct = 0;
+
+	nlibs_params_derive(params);
+}
+
+float *nlibs_host_param(struct nlibs_params_s &params, const char *name)
+{
+	const struct {
+		const char *name;
+		float *field;
+	} scalars[] = {
+		{ "NLIBSC_QMASS", &params.q_mass },
+		{ "NLIBSC_QIX_MOMENT", &params.q_ix_moment },
+		{ "NLIBSC_QIY_MOMENT", &params.q_iy_moment },
+		{ "NLIBSC_QIZ_MOMENT", &params.q_iz_moment },
+		{ "NLIBSC_QARM_LENGTH", &params.q_arm_length },
+		{ "NLIBSC_QDRAG_COEFF", &params.q_drag_coeff },
+		{ "NLIBSC_QXLIN_DRAG", &params.q_xlin_drag },
+		{ "NLIBSC_QYLIN_DRAG", &params.q_ylin_drag },
+		{ "NLIBSC_QZLIN_DRAG", &params.q_zlin_drag },
+		{ "NLIBSC_QXROT_DRAG", &params.q_xrot_drag },
+		{ "NLIBSC_QYROT_DRAG", &params.q_yrot_drag },
+		{ "NLIBSC_QZROT_DRAG", &params.q_zrot_drag },
+		{ "NLIBSC_QROTOR_RADIUS", &params.q_rotor_radius },
+		{ "NLIBSC_QROTOR_TWIST_ANGLE", &params.q_rotor_twist_angle },
+		{ "NLIBSC_QROTOR_ROOT_ANGLE", &params.q_rotor_root_angle },
+		{ "NLIBSC_QMOTOR_CST", &params.q_motor_cst },
+		{ "NLIBSC_THR_MIN", &params.thr_min },
+		{ "NLIBSC_THR_MAX", &params.thr_max },
+		{ "NLIBSC_LAND_SPEED", &params.land_speed },
+		{ "NLIBSC_XY_VEL_MAX", &params.xy_vel_max },
+		{ "NLIBSC_XY_FF", &params.xy_ff },
+		{ "NLIBSC_X_GAIN", &params.A1_gain(0) },
+		{ "NLIBSC_Y_GAIN", &params.A1_gain(1) },
+		{ "NLIBSC_X_VEL_GAIN", &params.A2_gain(0) },
+		{ "NLIBSC_Y_VEL_GAIN", &params.A2_gain(1) },
+		{ "NLIBSC_PHI_GAIN", &params.A3_gain(0) },
+		{ "NLIBSC_THETA_GAIN", &params.A3_gain(1) },
+		{ "NLIBSC_PHI_RATE_GAIN", &params.A4_gain(0) },
+		{ "NLIBSC_THETA_RATE_GAIN", &params.A4_gain(1) },
+		{ "NLIBSC_PSI_GAIN", &params.A5_gain(0) },
+		{ "NLIBSC_Z_GAIN", &params.A5_gain(1) },
+		{ "NLIBSC_PSI_RATE_GAIN", &params.A6_gain(0) },
+		{ "NLIBSC_Z_VEL_GAIN", &params.A6_gain(1) },
+		{ "NLIBSC_F1_GAIN", &params.A7_gain(0) },
+		{ "NLIBSC_F2_GAIN", &params.A7_gain(1) },
+		{ "NLIBSC_F3_GAIN", &params.A7_gain(2) },
+		{ "NLIBSC_F4_GAIN", &params.A7_gain(3) },
+	};
+
+	for (unsigned i = 0; i < sizeof(scalars) / sizeof(scalars[0]); i++) {
+		if (strcmp(name, scalars[i].name) == 0) {
+			return scalars[i].field;
+		}
+	}
+
+	return nullptr;
+}
+
+bool nlibs_host_set_param(struct nlibs_params_s &params, const char *name, float value)
+{
+	struct scalar_s {
+		const char *name;
+		float *field;
+	};
+
+	float *field = nlibs_host_param(params, name);
+
+	if (field != nullptr) {
+		*field = value;
+		nlibs_params_derive(params);
+		return true;
+	}
+
+	/* angles are stored in radians, as parameters_update() does */
+	const struct scalar_s angles[] = {
+		{ "NLIBSC_TILTMAX_AIR", &params.tilt_max_air },
+		{ "NLIBSC_TILTMAX_LND", &params.tilt_max_land },
+		{ "NLIBSC_MAN_R_MAX", &params.man_roll_max },
+		{ "NLIBSC_MAN_P_MAX", &params.man_pitch_max },
+		{ "NLIBSC_MAN_Y_MAX", &params.man_yaw_max },
+	};
+
+	for (unsigned i = 0; i < sizeof(angles) / sizeof(angles[0]); i++) {
+		if (strcmp(name, angles[i].name) == 0) {
+			*angles[i].field = math::radians(value);
+			nlibs_params_derive(params);
+			return true;
+		}
+	}
+
+	if (strcmp(name, "NLIBSC_ROLL_RATE_MAX") == 0) {
+		params.roll_rate_max = value;
+		params.nlibs_rate_max(0) = math::radians(value);
+
+	} else if (strcmp(name, "NLIBSC_PITCH_RATE_MAX") == 0) {
+		params.pitch_rate_max = value;
+		params.nlibs_rate_max(1) = math::radians(value);
+
+	} else if (strcmp(name, "NLIBSC_YAW_RATE_MAX") == 0) {
+		params.yaw_rate_max = value;
+		params.nlibs_rate_max(2) = math::radians(value);
+
+	} else if (strcmp(name, "NLIBSC_POLL_TMO") == 0) {
+		params.poll_timeout = (int)value;
+
+	} else if (strcmp(name, "NLIBSC_OUT_DIRECT") == 0) {
+		params.out_direct = (int)value;
+
+	} else {
+		return false;
+	}
+
+	nlibs_params_derive(params);
+	return true;
+}
+
+bool nlibs_host_set_params(struct nlibs_params_s &params, const char *list)
+{
+	char buf[256];
+	const char *s = list;
+
+	while (*s != '\0') {
+		size_t len = strcspn(s, ",");
+
+		if (len == 0 || len >= sizeof(buf)) {
+			return false;
+		}
+
+		memcpy(buf, s, len);
+		buf[len] = '\0';
+
+		char *eq = strchr(buf, '=');
+
+		if (eq == nullptr) {
+			return false;
+		}
+
+		*eq = '\0';
+		char *end;
+		float value = strtof(eq + 1, &end);
+
+		if (end == eq + 1 || *end != '\0' || !nlibs_host_set_param(params, buf, value)) {
+			return false;
+		}
+
+		s += len;
+
+		if (*s == ',') {
+			s++;
+		}
+	}
+
+	return true;
+}
+
+uint64_t nlibs_host_time_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t nlibs_host_cpu_time_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t nlibs_host_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
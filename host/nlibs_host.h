@@ -0,0 +1,96 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_host.h
+ * Helpers shared by the host side NLIBS tools.
+ *
+ * The host tools link nlibs_control_law.cpp against mathlib and lib/geo only,
+ * they do not need uORB, the parameter system or NuttX. nlibs_module is the
+ * exception, it runs the module on the shims of host/shim. host/Makefile
+ * builds them all.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "../nlibs_control_law.h"
+
+/**
+ * Fill the parameter cache with the defaults of mc_nlibs_params.c, already
+ * converted the way parameters_update() converts them.
+ */
+void	nlibs_host_default_params(struct nlibs_params_s &params);
+
+/**
+ * Set one parameter by its NLIBSC_* name, in the units of mc_nlibs_params.c.
+ *
+ * @return false when the name is unknown
+ */
+bool	nlibs_host_set_param(struct nlibs_params_s &params, const char *name, float value);
+
+/**
+ * Field of a parameter stored as set, without unit conversion. Call
+ * nlibs_params_derive() after writing through it.
+ *
+ * @return nullptr when the name is unknown or converted on load
+ */
+float	*nlibs_host_param(struct nlibs_params_s &params, const char *name);
+
+/**
+ * Apply a list of NAME=value assignments separated by commas.
+ *
+ * @return false when an assignment cannot be parsed or names an unknown parameter
+ */
+bool	nlibs_host_set_params(struct nlibs_params_s &params, const char *list);
+
+/**
+ * Monotonic time in nanoseconds.
+ */
+uint64_t	nlibs_host_time_ns();
+
+/**
+ * Process CPU time in nanoseconds.
+ */
+uint64_t	nlibs_host_cpu_time_ns();
+
+/**
+ * CPU cycle counter, 0 when the architecture has none we can read.
+ */
+uint64_t	nlibs_host_cycles();
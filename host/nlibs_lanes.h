@@ -0,0 +1,143 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file nlibs_lanes.h
+ * Vectors of NLIBS_BATCH_LANES floats for the generated batch kernel.
+ *
+ * The vectors are GCC vector extensions, the compiler emits SSE or AVX for
+ * them depending on the target. Operators and comparisons apply lane by
+ * lane and take a scalar operand as a vector of copies. The functions below
+ * are the ones the scalar kernel calls, each gives the same bits per lane.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <math.h>
+#include <lib/geo/geo.h>
+
+#include "nlibs_batch.h"
+
+typedef float vfloat __attribute__((vector_size(NLIBS_BATCH_LANES * sizeof(float))));
+
+static inline vfloat vset(float s)
+{
+	vfloat v;
+
+	for (unsigned l = 0; l < NLIBS_BATCH_LANES; l++) {
+		v[l] = s;
+	}
+
+	return v;
+}
+
+static inline vfloat vload(const float *p)
+{
+	return *(const vfloat *)p;
+}
+
+static inline void vstore(float *p, vfloat v)
+{
+	*(vfloat *)p = v;
+}
+
+static inline float vlane(float s, unsigned)
+{
+	return s;
+}
+
+static inline float vlane(vfloat v, unsigned l)
+{
+	return v[l];
+}
+
+/**
+ * Scalar function applied lane by lane, the vector libm functions would not
+ * round the same way as the scalar ones.
+ */
+static inline vfloat vmap(float (*f)(float), vfloat v)
+{
+	vfloat r;
+
+	for (unsigned l = 0; l < NLIBS_BATCH_LANES; l++) {
+		r[l] = f(v[l]);
+	}
+
+	return r;
+}
+
+static inline vfloat vsqrtf(vfloat v)
+{
+	return vmap(sqrtf, v);
+}
+
+static inline vfloat vasinf(vfloat v)
+{
+	return vmap(asinf, v);
+}
+
+static inline vfloat vwrap_pi(vfloat v)
+{
+	return vmap(_wrap_pi, v);
+}
+
+/**
+ * fminf() lane by lane, it orders signed zeros and NaN unlike a vector minimum.
+ */
+template <typename A, typename B>
+static inline vfloat vfminf(A a, B b)
+{
+	vfloat r;
+
+	for (unsigned l = 0; l < NLIBS_BATCH_LANES; l++) {
+		r[l] = fminf(vlane(a, l), vlane(b, l));
+	}
+
+	return r;
+}
+
+/**
+ * Same selection order as math::constrain(), NaN passes through.
+ */
+template <typename L, typename H>
+static inline vfloat vconstrain(vfloat v, L lo, H hi)
+{
+	vfloat r = (v > hi) ? hi : v;
+	return (v < lo) ? lo : r;
+}
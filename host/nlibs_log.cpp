@@ -0,0 +1,334 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_log.cpp
+ * Memory mapped reader of sdlog2 flight logs for the host side NLIBS tools.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_log.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LOG_HEAD_BYTE1		0xA3
+#define LOG_HEAD_BYTE2		0x95
+#define LOG_HEAD_LEN		3
+#define LOG_FORMAT_MSG		0x80
+#define LOG_FORMAT_LEN		(LOG_HEAD_LEN + 1 + 1 + 4 + 16 + 64)
+
+/**
+ * Size in bytes of a sdlog2 field type, 0 when unknown.
+ */
+static unsigned field_size(char type)
+{
+	switch (type) {
+	case 'b':
+	case 'B':
+	case 'M':
+		return 1;
+
+	case 'h':
+	case 'H':
+	case 'c':
+	case 'C':
+		return 2;
+
+	case 'i':
+	case 'I':
+	case 'f':
+	case 'n':
+	case 'e':
+	case 'E':
+	case 'L':
+		return 4;
+
+	case 'q':
+	case 'Q':
+		return 8;
+
+	case 'N':
+		return 16;
+
+	case 'Z':
+		return 64;
+
+	default:
+		return 0;
+	}
+}
+
+template <typename T>
+static T read(const uint8_t *p)
+{
+	T v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+NLIBSLogReader::NLIBSLogReader() :
+	_data(nullptr),
+	_size(0),
+	_pos(0)
+{
+	memset(_formats, 0, sizeof(_formats));
+	memset(_declared, 0, sizeof(_declared));
+}
+
+NLIBSLogReader::~NLIBSLogReader()
+{
+	close();
+}
+
+bool NLIBSLogReader::open(const char *path)
+{
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	/* the log is read once from start to end */
+	madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	_data = (const uint8_t *)data;
+	_size = (size_t)st.st_size;
+	_pos = 0;
+	memset(_declared, 0, sizeof(_declared));
+
+	return true;
+}
+
+void NLIBSLogReader::close()
+{
+	if (_data != nullptr) {
+		munmap((void *)_data, _size);
+		_data = nullptr;
+	}
+
+	_size = 0;
+	_pos = 0;
+}
+
+void NLIBSLogReader::declare(const uint8_t *payload)
+{
+	struct nlibs_log_format_s &fmt = _formats[payload[0]];
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = payload[0];
+	fmt.length = payload[1];
+	memcpy(fmt.name, &payload[2], 4);
+
+	char format[17];
+	memcpy(format, &payload[6], 16);
+	format[16] = '\0';
+
+	char labels[65];
+	memcpy(labels, &payload[22], 64);
+	labels[64] = '\0';
+
+	unsigned offset = 0;
+	const char *label = labels;
+
+	for (unsigned i = 0; format[i] != '\0' && i < NLIBS_LOG_MAX_FIELDS; i++) {
+		size_t len = strcspn(label, ",");
+
+		if (len > 16) {
+			len = 16;
+		}
+
+		fmt.field_type[i] = format[i];
+		fmt.field_offset[i] = offset;
+		memcpy(fmt.field_label[i], label, len);
+		fmt.field_label[i][len] = '\0';
+		fmt.nfields++;
+
+		offset += field_size(format[i]);
+		label += strcspn(label, ",");
+
+		if (*label == ',') {
+			label++;
+		}
+	}
+
+	_declared[fmt.type] = true;
+}
+
+bool NLIBSLogReader::next(const struct nlibs_log_format_s *&fmt, const uint8_t *&payload)
+{
+	while (_pos + LOG_HEAD_LEN <= _size) {
+		const uint8_t *p = &_data[_pos];
+
+		/* resynchronize on the next header after a corrupted message */
+		if (p[0] != LOG_HEAD_BYTE1 || p[1] != LOG_HEAD_BYTE2) {
+			_pos++;
+			continue;
+		}
+
+		if (p[2] == LOG_FORMAT_MSG) {
+			if (_pos + LOG_FORMAT_LEN > _size) {
+				break;
+			}
+
+			declare(&p[LOG_HEAD_LEN]);
+			_pos += LOG_FORMAT_LEN;
+			continue;
+		}
+
+		if (!_declared[p[2]] || _formats[p[2]].length <= LOG_HEAD_LEN) {
+			_pos++;
+			continue;
+		}
+
+		fmt = &_formats[p[2]];
+
+		if (_pos + fmt->length > _size) {
+			break;
+		}
+
+		payload = &p[LOG_HEAD_LEN];
+		_pos += fmt->length;
+		return true;
+	}
+
+	_pos = _size;
+	return false;
+}
+
+const struct nlibs_log_format_s *NLIBSLogReader::find(const char *name) const
+{
+	for (unsigned i = 0; i < 256; i++) {
+		if (_declared[i] && strncmp(_formats[i].name, name, 4) == 0) {
+			return &_formats[i];
+		}
+	}
+
+	return nullptr;
+}
+
+int NLIBSLogReader::field(const struct nlibs_log_format_s *fmt, const char *label)
+{
+	if (fmt == nullptr) {
+		return -1;
+	}
+
+	for (unsigned i = 0; i < fmt->nfields; i++) {
+		if (strcmp(fmt->field_label[i], label) == 0) {
+			return (int)i;
+		}
+	}
+
+	return -1;
+}
+
+double NLIBSLogReader::value(const struct nlibs_log_format_s *fmt, const uint8_t *payload, int index)
+{
+	if (fmt == nullptr || index < 0 || (unsigned)index >= fmt->nfields) {
+		return 0.0;
+	}
+
+	const uint8_t *p = &payload[fmt->field_offset[index]];
+
+	/* the log is little endian, as is every host we build the tools for */
+	switch (fmt->field_type[index]) {
+	case 'b':
+		return read<int8_t>(p);
+
+	case 'B':
+	case 'M':
+		return read<uint8_t>(p);
+
+	case 'h':
+		return read<int16_t>(p);
+
+	case 'H':
+		return read<uint16_t>(p);
+
+	case 'c':
+		return read<int16_t>(p) * 0.01;
+
+	case 'C':
+		return read<uint16_t>(p) * 0.01;
+
+	case 'i':
+		return read<int32_t>(p);
+
+	case 'I':
+		return read<uint32_t>(p);
+
+	case 'e':
+		return read<int32_t>(p) * 0.01;
+
+	case 'E':
+		return read<uint32_t>(p) * 0.01;
+
+	case 'L':
+		return read<int32_t>(p) * 1e-7;
+
+	case 'f':
+		return read<float>(p);
+
+	case 'q':
+		return (double)read<int64_t>(p);
+
+	case 'Q':
+		return (double)read<uint64_t>(p);
+
+	default:
+		return 0.0;
+	}
+}
@@ -0,0 +1,116 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_log.h
+ * Memory mapped reader of sdlog2 flight logs for the host side NLIBS tools.
+ *
+ * The log is self describing, every message type is declared by a FMT
+ * message first. Fields are looked up by their label so that the tools
+ * keep working across firmware versions which append fields to a message.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NLIBS_LOG_MAX_FIELDS	32
+
+struct nlibs_log_format_s {
+	uint8_t type;
+	uint8_t length;					/**< message length, header included */
+	char name[5];
+	unsigned nfields;
+	char field_type[NLIBS_LOG_MAX_FIELDS];
+	unsigned field_offset[NLIBS_LOG_MAX_FIELDS];
+	char field_label[NLIBS_LOG_MAX_FIELDS][17];
+};
+
+class NLIBSLogReader
+{
+public:
+	NLIBSLogReader();
+	~NLIBSLogReader();
+
+	/**
+	 * Map a log file.
+	 *
+	 * @return false when the file cannot be opened or mapped
+	 */
+	bool	open(const char *path);
+
+	void	close();
+
+	/**
+	 * Move to the next data message, FMT messages are consumed on the way.
+	 *
+	 * @param fmt		format of the message
+	 * @param payload	message payload, header excluded
+	 * @return false at the end of the log
+	 */
+	bool	next(const struct nlibs_log_format_s *&fmt, const uint8_t *&payload);
+
+	/**
+	 * Format of a message by name, nullptr when the log does not declare it.
+	 */
+	const struct nlibs_log_format_s *find(const char *name) const;
+
+	/**
+	 * Index of a field by label, -1 when the message has no such field.
+	 */
+	static int	field(const struct nlibs_log_format_s *fmt, const char *label);
+
+	/**
+	 * Numeric value of a field, scaled the way sdlog2 declares it.
+	 * Returns 0 for a missing field.
+	 */
+	static double	value(const struct nlibs_log_format_s *fmt, const uint8_t *payload, int index);
+
+	size_t	size() const { return _size; }
+
+private:
+	const uint8_t *_data;			/**< mapped log */
+	size_t _size;					/**< mapped size */
+	size_t _pos;					/**< read position */
+
+	struct nlibs_log_format_s _formats[256];
+	bool _declared[256];
+
+	void	declare(const uint8_t *payload);
+};
@@ -0,0 +1,500 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_module.cpp
+ * Run the mc_nlibs_control module itself against the plant model, in real
+ * time, through the uORB, parameter and work queue shims of host/shim.
+ *
+ * The vehicle is armed in auto mode and flies the default simulation step.
+ * Attitude is published at 250 Hz, the local position every -d-th sample,
+ * and the plant follows actuator_controls_0. The end reports the position
+ * error, the attitude to actuator latency seen from outside the module and
+ * the module status. It fails when no control came back or when the
+ * vehicle did not end within the settle band of the setpoint.
+ *
+ * -s hands the outputs to a stand-in for the stock controllers over the
+ * middle third of the run: the same law with softer attitude gains,
+ * published on actuator_controls_virtual_mc. The module must pass its
+ * controls on, then take over again.
+ *
+ * -r stops the module halfway and starts a new instance, as from the shell.
+ * It must resume from the checkpoint without a step in the controls. After
+ * the run, new instances are started on the last checkpoint: they must
+ * resume from it when fresh, and refuse it when corrupted or stale. Every
+ * stop, in flight or without attitude, must end within STOP_TIME_MAX.
+ *
+ * usage: nlibs_module [-T duration_s] [-d divider] [-s] [-r]
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+
+#include "nlibs_host.h"
+#include "nlibs_sim.h"
+
+/* the module class is file local, build it into the driver */
+#include "../mc_nlibs_control_main.cpp"
+
+#define MODULE_RATE			250			/**< attitude publication rate, Hz */
+#define MODULE_SUBSTEPS		4			/**< plant steps per attitude sample */
+#define MODULE_WAIT			20			/**< longest wait for the actuator controls, ms */
+#define RESTART_STEP_MAX	0.05f		/**< largest control step across a restart */
+#define STOP_TIME_MAX		10000		/**< longest stop, a control period and the host scheduling, us */
+
+static hrt_abstime stop_time_max;		/**< longest stop so far, us */
+
+/* stop the instance, keeping the longest stop */
+static int stop_timed(MulticopterNLIBSControl *control)
+{
+	hrt_abstime t0 = hrt_absolute_time();
+	int ret = control->stop();
+	hrt_abstime t = hrt_elapsed_time(&t0);
+	stop_time_max = t > stop_time_max ? t : stop_time_max;
+	return ret;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-T duration_s] [-d divider] [-s] [-r]\n", name);
+}
+
+template <typename T>
+static orb_advert_t publish(const struct orb_metadata *meta, orb_advert_t pub, const T &data)
+{
+	if (pub > 0) {
+		orb_publish(meta, pub, &data);
+		return pub;
+	}
+
+	return orb_advertise(meta, &data);
+}
+
+static void sleep_until(hrt_abstime t)
+{
+	struct timespec ts;
+	ts.tv_sec = t / 1000000;
+	ts.tv_nsec = (t % 1000000) * 1000;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+}
+
+/* stop the instance and start a new one, as mc_nlibs_control stop and start do */
+static MulticopterNLIBSControl *restart_instance(MulticopterNLIBSControl *control)
+{
+	if (stop_timed(control) != OK) {
+		return nullptr;
+	}
+
+	delete control;
+	control = new MulticopterNLIBSControl;
+	nlibs_control::g_control = control;
+
+	if (control->start() != OK) {
+		delete control;
+		nlibs_control::g_control = nullptr;
+		return nullptr;
+	}
+
+	return control;
+}
+
+/* date the checkpoint and seal it with its crc, as checkpoint_save does */
+static void checkpoint_seal(struct nlibs_checkpoint_s &c, hrt_abstime timestamp)
+{
+	c.timestamp = timestamp;
+	c.crc = crc32((const uint8_t *)&c, offsetof(struct nlibs_checkpoint_s, crc));
+}
+
+/* start a new instance on the checkpoint and stop it again, OK or the error of start or stop */
+static int start_on(const struct nlibs_checkpoint_s &c, bool &resumed)
+{
+	nlibs_control::g_checkpoint = c;
+
+	MulticopterNLIBSControl *control = new MulticopterNLIBSControl;
+	nlibs_control::g_control = control;
+
+	int ret = control->start();
+
+	if (ret != OK) {
+		delete control;
+		nlibs_control::g_control = nullptr;
+		return ret;
+	}
+
+	resumed = control->resumed();
+
+	/* the task may still use an instance that did not stop, leave it */
+	ret = stop_timed(control);
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	delete control;
+	nlibs_control::g_control = nullptr;
+
+	return OK;
+}
+
+/* the checkpoint of the last stop, true if resumed when fresh and refused when corrupted or stale */
+static bool check_checkpoint()
+{
+	struct nlibs_checkpoint_s fresh = nlibs_control::g_checkpoint;
+	checkpoint_seal(fresh, hrt_absolute_time());
+
+	struct nlibs_checkpoint_s corrupted = fresh;
+	corrupted.law.rates_int[0] += 0.1f;
+
+	struct nlibs_checkpoint_s stale = fresh;
+	checkpoint_seal(stale, hrt_absolute_time() - CHECKPOINT_MAX_AGE - STOP_TIMEOUT);
+
+	bool resumed_fresh = false;
+	bool resumed_corrupted = true;
+	bool resumed_stale = true;
+
+	if (start_on(fresh, resumed_fresh) != OK ||
+	    start_on(corrupted, resumed_corrupted) != OK ||
+	    start_on(stale, resumed_stale) != OK) {
+		fprintf(stderr, "checkpoint start or stop failed\n");
+		return false;
+	}
+
+	printf("checkpoint resumed: fresh %d, corrupted %d, stale %d\n",
+	       resumed_fresh, resumed_corrupted, resumed_stale);
+
+	return resumed_fresh && !resumed_corrupted && !resumed_stale;
+}
+
+int main(int argc, char *argv[])
+{
+	struct nlibs_sim_config_s config;
+	struct nlibs_params_s model;
+	bool stock_switch = false;
+	bool restart = false;
+	int ch;
+
+	nlibs_sim_default_config(config);
+	nlibs_host_default_params(model);
+	config.duration = 5.0f;
+
+	while ((ch = getopt(argc, argv, "T:d:srh")) != -1) {
+		switch (ch) {
+		case 'T':
+			config.duration = strtof(optarg, nullptr);
+			break;
+
+		case 'd':
+			config.position_divider = (unsigned)atoi(optarg);
+			break;
+
+		case 's':
+			stock_switch = true;
+			break;
+
+		case 'r':
+			restart = true;
+			break;
+
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!(config.duration > 0.0f) || config.position_divider == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	NLIBSPlant plant;
+	plant.set_model(model);
+	plant.reset(config.pos0, config.yaw0);
+
+	/* armed, flying the local position setpoint */
+	struct actuator_armed_s armed;
+	memset(&armed, 0, sizeof(armed));
+	armed.timestamp = hrt_absolute_time();
+	armed.armed = true;
+	orb_advertise(ORB_ID(actuator_armed), &armed);
+
+	struct vehicle_control_mode_s mode;
+	memset(&mode, 0, sizeof(mode));
+	mode.timestamp = hrt_absolute_time();
+	mode.flag_armed = true;
+	mode.flag_control_auto_enabled = true;
+	mode.flag_control_rates_enabled = true;
+	mode.flag_control_attitude_enabled = true;
+	mode.flag_control_velocity_enabled = true;
+	mode.flag_control_position_enabled = config.position_enabled;
+	mode.flag_control_altitude_enabled = config.altitude_enabled;
+	mode.flag_control_climb_rate_enabled = config.altitude_enabled;
+	orb_advertise(ORB_ID(vehicle_control_mode), &mode);
+
+	struct vehicle_local_position_setpoint_s pos_sp;
+	memset(&pos_sp, 0, sizeof(pos_sp));
+	pos_sp.timestamp = hrt_absolute_time();
+	pos_sp.x = config.pos_sp(0);
+	pos_sp.y = config.pos_sp(1);
+	pos_sp.z = config.pos_sp(2);
+	pos_sp.yaw = config.yaw_sp;
+	orb_advertise(ORB_ID(vehicle_local_position_setpoint), &pos_sp);
+
+	int actuators_sub = orb_subscribe(ORB_ID(actuator_controls_0));
+
+	/* stand-in for the stock controllers, a differently tuned controller with its own integrals */
+	NLIBSControlLaw stock;
+	struct nlibs_params_s stock_params = model;
+
+	for (unsigned i = 0; i < 2; i++) {
+		stock_params.A3_gain(i) *= 0.6f;
+		stock_params.A4_gain(i) *= 0.6f;
+	}
+
+	nlibs_params_derive(stock_params);
+
+	struct nlibs_input_s stock_in;
+	stock_in.pos_sp = config.pos_sp;
+	stock_in.vel_ff.zero();
+	stock_in.roll_sp = 0.0f;
+	stock_in.pitch_sp = 0.0f;
+	stock_in.yaw_sp = config.yaw_sp;
+	stock_in.thrust_sp = 0.0f;
+	stock_in.position_enabled = config.position_enabled;
+	stock_in.altitude_enabled = config.altitude_enabled;
+
+	/* NLIBS is off by default, the run is meant to fly it */
+	int32_t active = 1;
+	param_set(param_find("NLIBSC_ACTIVE"), &active);
+
+	MulticopterNLIBSControl *control = new MulticopterNLIBSControl;
+
+	/* the control task finds the instance there, as when started from the shell */
+	nlibs_control::g_control = control;
+
+	if (control->start() != OK) {
+		fprintf(stderr, "start failed\n");
+		return 1;
+	}
+
+	struct vehicle_attitude_s att;
+	struct vehicle_local_position_s local_pos;
+	struct actuator_controls_s actuators;
+	struct actuator_controls_s stock_controls;
+	struct actuator_controls_s restart_controls;
+	memset(&att, 0, sizeof(att));
+	memset(&local_pos, 0, sizeof(local_pos));
+	memset(&actuators, 0, sizeof(actuators));
+	memset(&stock_controls, 0, sizeof(stock_controls));
+	orb_advert_t att_pub = -1;
+	orb_advert_t local_pos_pub = -1;
+	orb_advert_t stock_pub = -1;
+
+	const hrt_abstime period = 1000000 / MODULE_RATE;
+	const float control_dt = 1.0f / MODULE_RATE;
+	const uint64_t steps = (uint64_t)(config.duration * MODULE_RATE);
+
+	uint64_t received = 0;
+	uint64_t received_stock = 0;
+	uint64_t missed = 0;
+	uint64_t latency_sum = 0;
+	uint64_t latency_max = 0;
+	float tilt_max = 0.0f;
+	float err_len = 0.0f;
+	bool restart_pending = false;
+	float restart_step = 0.0f;
+
+	hrt_abstime next = hrt_absolute_time();
+
+	for (uint64_t k = 0; k < steps; k++) {
+		const struct nlibs_plant_state_s &s = plant.state();
+		bool stock_owns = stock_switch && k >= steps / 3 && k < 2 * steps / 3;
+
+		if (stock_switch && (k == steps / 3 || k == 2 * steps / 3)) {
+			control->set_active(!stock_owns);
+		}
+
+		if (restart && k == steps / 2) {
+			control = restart_instance(control);
+
+			if (control == nullptr) {
+				fprintf(stderr, "restart failed\n");
+				return 1;
+			}
+
+			if (!control->resumed()) {
+				fprintf(stderr, "restart did not resume from the checkpoint\n");
+				return 1;
+			}
+
+			/* the controls before the stop, against the first ones of the new instance */
+			restart_controls = actuators;
+			restart_pending = true;
+		}
+
+		/* the stock controllers run on every sample, whoever owns the outputs */
+		if (stock_switch) {
+			struct nlibs_output_s stock_out;
+			plant.measure(stock_in);
+			stock.control(stock_params, stock_in, control_dt, stock_out);
+
+			for (unsigned i = 0; i < 3; i++) {
+				stock_controls.control[i] = stock_out.att_control(i);
+			}
+
+			stock_controls.control[3] = stock_out.thrust;
+			stock_controls.timestamp = hrt_absolute_time();
+			stock_pub = publish(ORB_ID(actuator_controls_virtual_mc), stock_pub, stock_controls);
+		}
+
+		if (k % config.position_divider == 0) {
+			local_pos.timestamp = hrt_absolute_time();
+			local_pos.xy_valid = true;
+			local_pos.z_valid = true;
+			local_pos.v_xy_valid = true;
+			local_pos.v_z_valid = true;
+			local_pos.x = s.pos(0);
+			local_pos.y = s.pos(1);
+			local_pos.z = s.pos(2);
+			local_pos.vx = s.vel(0);
+			local_pos.vy = s.vel(1);
+			local_pos.vz = s.vel(2);
+			local_pos.yaw = s.att(2);
+			local_pos_pub = publish(ORB_ID(vehicle_local_position), local_pos_pub, local_pos);
+		}
+
+		math::Matrix<3, 3> R;
+		R.from_euler(s.att(0), s.att(1), s.att(2));
+
+		att.roll = s.att(0);
+		att.pitch = s.att(1);
+		att.yaw = s.att(2);
+		att.rollspeed = s.rates(0);
+		att.pitchspeed = s.rates(1);
+		att.yawspeed = s.rates(2);
+		memcpy(att.R, R.data, sizeof(att.R));
+		att.R_valid = true;
+		att.timestamp = hrt_absolute_time();
+		att_pub = publish(ORB_ID(vehicle_attitude), att_pub, att);
+
+		/* the controls of this sample, the previous ones are held when they are late */
+		struct pollfd fds[1];
+		fds[0].fd = actuators_sub;
+		fds[0].events = POLLIN;
+
+		if (poll(fds, 1, MODULE_WAIT) > 0) {
+			orb_copy(ORB_ID(actuator_controls_0), actuators_sub, &actuators);
+			hrt_abstime latency = hrt_absolute_time() - att.timestamp;
+			latency_sum += latency;
+			latency_max = latency > latency_max ? latency : latency_max;
+			received++;
+			received_stock += stock_owns ? 1 : 0;
+
+			if (restart_pending) {
+				for (unsigned i = 0; i < 4; i++) {
+					float step = fabsf(actuators.control[i] - restart_controls.control[i]);
+					restart_step = step > restart_step ? step : restart_step;
+				}
+
+				restart_pending = false;
+			}
+
+		} else {
+			missed++;
+		}
+
+		math::Vector<3> att_control;
+		att_control(0) = actuators.control[0];
+		att_control(1) = actuators.control[1];
+		att_control(2) = actuators.control[2];
+		plant.set_actuators(att_control, actuators.control[3]);
+
+		for (unsigned i = 0; i < MODULE_SUBSTEPS; i++) {
+			plant.step(control_dt / MODULE_SUBSTEPS);
+		}
+
+		math::Vector<3> err = config.pos_sp - plant.state().pos;
+		err_len = err.length();
+		float tilt = acosf(math::constrain(cosf(plant.state().att(0)) * cosf(plant.state().att(1)), -1.0f, 1.0f));
+		tilt_max = tilt > tilt_max ? tilt : tilt_max;
+
+		next += period;
+		sleep_until(next);
+	}
+
+	printf("steps %llu, pos err final %.4f m, tilt max %.3f rad\n",
+	       (unsigned long long)steps, (double)err_len, (double)tilt_max);
+	printf("controls %llu, missed %llu, latency avg %llu us, max %llu us\n",
+	       (unsigned long long)received, (unsigned long long)missed,
+	       (unsigned long long)(received > 0 ? latency_sum / received : 0), (unsigned long long)latency_max);
+
+	if (stock_switch) {
+		printf("stock controls passed on %llu\n", (unsigned long long)received_stock);
+	}
+
+	if (restart) {
+		printf("restart control step %.4f\n", (double)restart_step);
+	}
+
+	control->print_status();
+
+	if (stop_timed(control) != OK) {
+		fprintf(stderr, "stop timed out\n");
+		return 1;
+	}
+
+	delete control;
+	nlibs_control::g_control = nullptr;
+	orb_unsubscribe(actuators_sub);
+
+	if (stock_switch && received_stock == 0) {
+		return 1;
+	}
+
+	if (restart && (restart_step > RESTART_STEP_MAX || !check_checkpoint())) {
+		return 1;
+	}
+
+	printf("stop max %llu us\n", (unsigned long long)stop_time_max);
+
+	if (stop_time_max > STOP_TIME_MAX) {
+		return 1;
+	}
+
+	return (received > 0 && err_len < config.settle_pos) ? 0 : 1;
+}
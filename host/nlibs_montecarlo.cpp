@@ -0,0 +1,596 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_montecarlo.cpp
+ * Monte-Carlo robustness analysis of the NLIBS control law.
+ *
+ * The controller keeps its nominal model while the simulated vehicle draws
+ * its physical parameters from the given distributions, one draw per
+ * sample. Every sample flies the tuning scenarios on the plant model, the
+ * samples being spread over all cores by the work stealing pool. Sample i
+ * always draws the same values for a given seed, whatever the number of
+ * threads, so runs are reproducible and resumable.
+ *
+ * The report gives the share of stable samples, those which settled within
+ * the tolerance of the scenarios before the end of the run, and of diverged
+ * ones. It follows with percentiles of the tracking metrics over the samples
+ * which did not diverge, and for every sampled parameter the ratio to
+ * nominal of the closest diverged samples below and above nominal, the
+ * stability margin seen by the run.
+ *
+ * distributions: NAME=normal:mean:std, NAME=uniform:min:max,
+ *                NAME=lognormal:median:sigma; draws <= 0 are redrawn
+ *
+ * usage: nlibs_montecarlo -n samples -d NAME=dist:a:b [-d ...] [-p NAME=value,...]
+ *                         [-T duration_s] [-s seed] [-j threads] [-o dir]
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nlibs_columns.h"
+#include "nlibs_host.h"
+#include "nlibs_pool.h"
+#include "nlibs_sim.h"
+
+#define MC_MAX_DISTS		16
+#define MC_FLUSH_ROWS		64
+#define MC_MAX_WORKERS		256
+#define MC_MAX_REDRAWS		64
+
+enum mc_dist_e {
+	DIST_NORMAL = 0,
+	DIST_UNIFORM,
+	DIST_LOGNORMAL
+};
+
+struct mc_dist_s {
+	char name[48];
+	enum mc_dist_e type;
+	float a;
+	float b;
+	float nominal;				/**< value the controller assumes */
+};
+
+struct mc_buffer_s {
+	uint64_t index[MC_FLUSH_ROWS];
+	float values[MC_FLUSH_ROWS * (MC_MAX_DISTS + NLIBS_SIM_METRICS)];
+	unsigned rows;
+} __attribute__((aligned(64)));
+
+struct mc_s {
+	struct mc_dist_s dists[MC_MAX_DISTS];
+	unsigned ndists;
+	uint64_t samples;
+	uint64_t seed;
+
+	struct nlibs_params_s params;
+	struct nlibs_sim_config_s scenarios[NLIBS_SIM_SCENARIOS];
+
+	/* every sample, row major, ndists draws then the metrics */
+	float *results;
+	uint8_t *done;
+	uint64_t completed;
+	uint64_t resumed;
+	uint64_t t_start;
+	uint64_t t_report;
+
+	NLIBSColumns out;
+	bool out_enabled;
+	pthread_mutex_t out_lock;
+	bool out_error;
+
+	struct mc_buffer_s *buffers;
+};
+
+static volatile bool g_stop = false;
+
+static void mc_signal(int)
+{
+	g_stop = true;
+}
+
+/**
+ * splitmix64, one independent stream per sample.
+ */
+static uint64_t mc_random(uint64_t &state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * Uniform in (0, 1).
+ */
+static double mc_uniform(uint64_t &state)
+{
+	return ((double)(mc_random(state) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+static double mc_normal(uint64_t &state)
+{
+	/* Box-Muller, one of the pair is enough here */
+	double u1 = mc_uniform(state);
+	double u2 = mc_uniform(state);
+
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static float mc_draw(const struct mc_dist_s &dist, uint64_t &state)
+{
+	for (unsigned i = 0; i < MC_MAX_REDRAWS; i++) {
+		double v;
+
+		switch (dist.type) {
+		case DIST_UNIFORM:
+			v = (double)dist.a + ((double)dist.b - (double)dist.a) * mc_uniform(state);
+			break;
+
+		case DIST_LOGNORMAL:
+			v = (double)dist.a * exp((double)dist.b * mc_normal(state));
+			break;
+
+		case DIST_NORMAL:
+		default:
+			v = (double)dist.a + (double)dist.b * mc_normal(state);
+			break;
+		}
+
+		/* physical parameters are positive */
+		if (v > 0.0) {
+			return (float)v;
+		}
+	}
+
+	return dist.nominal;
+}
+
+static bool parse_dist(const char *arg, struct mc_dist_s &dist)
+{
+	const char *eq = strchr(arg, '=');
+
+	if (eq == nullptr || eq == arg || (size_t)(eq - arg) >= sizeof(dist.name)) {
+		return false;
+	}
+
+	memcpy(dist.name, arg, (size_t)(eq - arg));
+	dist.name[eq - arg] = '\0';
+
+	char type[16];
+
+	if (sscanf(eq + 1, "%15[a-z]:%f:%f", type, &dist.a, &dist.b) != 3) {
+		return false;
+	}
+
+	if (strcmp(type, "normal") == 0) {
+		dist.type = DIST_NORMAL;
+
+	} else if (strcmp(type, "uniform") == 0) {
+		dist.type = DIST_UNIFORM;
+
+	} else if (strcmp(type, "lognormal") == 0) {
+		dist.type = DIST_LOGNORMAL;
+
+	} else {
+		return false;
+	}
+
+	return dist.b >= 0.0f || dist.type == DIST_UNIFORM;
+}
+
+static void mc_flush(struct mc_s &mc, struct mc_buffer_s &buf)
+{
+	if (buf.rows == 0) {
+		return;
+	}
+
+	if (mc.out_enabled) {
+		pthread_mutex_lock(&mc.out_lock);
+
+		if (!mc.out.append(buf.index, buf.values, buf.rows)) {
+			mc.out_error = true;
+			g_stop = true;
+		}
+
+		pthread_mutex_unlock(&mc.out_lock);
+	}
+
+	buf.rows = 0;
+}
+
+static void mc_job(uint64_t index, unsigned worker, void *arg)
+{
+	struct mc_s &mc = *(struct mc_s *)arg;
+
+	if (mc.done[index]) {
+		return;
+	}
+
+	const unsigned ncols = mc.ndists + NLIBS_SIM_METRICS;
+	float *row = &mc.results[index * ncols];
+
+	/* the controller keeps the nominal model, only the vehicle changes */
+	struct nlibs_params_s model = mc.params;
+	uint64_t state = mc.seed ^ (index * 0xD1B54A32D192ED03ULL);
+
+	for (unsigned d = 0; d < mc.ndists; d++) {
+		row[d] = mc_draw(mc.dists[d], state);
+		*nlibs_host_param(model, mc.dists[d].name) = row[d];
+	}
+
+	nlibs_params_derive(model);
+
+	struct nlibs_sim_result_s res;
+	nlibs_sim_run_scenarios(mc.scenarios, NLIBS_SIM_SCENARIOS, mc.params, model, res);
+	nlibs_sim_metrics(res, &row[mc.ndists]);
+
+	struct mc_buffer_s &buf = mc.buffers[worker];
+	memcpy(&buf.values[buf.rows * ncols], row, ncols * sizeof(float));
+	buf.index[buf.rows++] = index;
+
+	if (buf.rows == MC_FLUSH_ROWS) {
+		mc_flush(mc, buf);
+	}
+
+	mc.done[index] = 1;
+
+	uint64_t completed = __atomic_add_fetch(&mc.completed, 1, __ATOMIC_RELAXED);
+
+	/* progress from one worker only */
+	if (worker == 0) {
+		uint64_t now = nlibs_host_time_ns();
+
+		if (now - mc.t_report > 1000000000ULL) {
+			mc.t_report = now;
+			double rate = (double)(completed - mc.resumed) / ((double)(now - mc.t_start) * 1e-9);
+			fprintf(stderr, "%llu / %llu samples, %.0f /s\n", (unsigned long long)completed,
+				(unsigned long long)mc.samples, rate);
+		}
+	}
+}
+
+static int float_compare(const void *a, const void *b)
+{
+	float fa = *(const float *)a;
+	float fb = *(const float *)b;
+
+	return (fa < fb) ? -1 : ((fa > fb) ? 1 : 0);
+}
+
+static void mc_report(const struct mc_s &mc)
+{
+	const unsigned ncols = mc.ndists + NLIBS_SIM_METRICS;
+	uint64_t run = 0;
+	uint64_t stable = 0;
+	uint64_t diverged = 0;
+
+	/* the scenarios share their duration, one that never settled sets the combined settle time to it */
+	const float unsettled = nlibs_sim_unsettled_time(mc.scenarios[0]);
+
+	float *sorted = (float *)malloc((mc.samples + 1) * sizeof(float));
+
+	if (sorted == nullptr) {
+		return;
+	}
+
+	for (uint64_t i = 0; i < mc.samples; i++) {
+		if (mc.done[i]) {
+			const float *row = &mc.results[i * ncols + mc.ndists];
+			run++;
+
+			if (row[NLIBS_SIM_DIVERGED] >= 0.5f) {
+				diverged++;
+
+			} else if (row[NLIBS_SIM_SETTLE_TIME] < unsettled) {
+				stable++;
+			}
+		}
+	}
+
+	printf("%llu samples, %llu stable (%.2f %%), %llu diverged (%.2f %%)\n",
+	       (unsigned long long)run, (unsigned long long)stable, (run > 0) ? 100.0 * (double)stable / (double)run : 0.0,
+	       (unsigned long long)diverged, (run > 0) ? 100.0 * (double)diverged / (double)run : 0.0);
+
+	/* tracking percentiles over the samples which did not diverge */
+	static const unsigned metrics[] = { NLIBS_SIM_POS_ERR_RMS, NLIBS_SIM_SETTLE_TIME, NLIBS_SIM_OVERSHOOT,
+					    NLIBS_SIM_TILT_MAX, NLIBS_SIM_EFFORT
+					  };
+	static const double percentiles[] = { 0.5, 0.9, 0.95, 0.99, 1.0 };
+
+	printf("%-12s %10s %10s %10s %10s %10s\n", "metric", "p50", "p90", "p95", "p99", "max");
+
+	for (unsigned k = 0; k < sizeof(metrics) / sizeof(metrics[0]) && diverged < run; k++) {
+		uint64_t n = 0;
+
+		for (uint64_t i = 0; i < mc.samples; i++) {
+			const float *row = &mc.results[i * ncols];
+
+			if (mc.done[i] && row[mc.ndists + NLIBS_SIM_DIVERGED] < 0.5f) {
+				sorted[n++] = row[mc.ndists + metrics[k]];
+			}
+		}
+
+		qsort(sorted, n, sizeof(float), float_compare);
+
+		printf("%-12s", nlibs_sim_metric_names[metrics[k]]);
+
+		for (unsigned p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); p++) {
+			uint64_t at = (uint64_t)ceil(percentiles[p] * (double)n);
+			printf(" %10.4f", (double)sorted[(at > 0) ? at - 1 : 0]);
+		}
+
+		printf("\n");
+	}
+
+	/* margins: closest divergence below and above nominal, as a ratio to nominal */
+	printf("%-24s %10s %10s %10s %10s\n", "parameter", "sampled lo", "sampled hi", "div below", "div above");
+
+	for (unsigned d = 0; d < mc.ndists; d++) {
+		const struct mc_dist_s &dist = mc.dists[d];
+		float lo = INFINITY;
+		float hi = 0.0f;
+		float below = 0.0f;
+		float above = INFINITY;
+
+		for (uint64_t i = 0; i < mc.samples; i++) {
+			const float *row = &mc.results[i * ncols];
+
+			if (!mc.done[i]) {
+				continue;
+			}
+
+			float ratio = row[d] / dist.nominal;
+			lo = fminf(lo, ratio);
+			hi = fmaxf(hi, ratio);
+
+			if (row[mc.ndists + NLIBS_SIM_DIVERGED] >= 0.5f) {
+				if (ratio <= 1.0f) {
+					below = fmaxf(below, ratio);
+
+				} else {
+					above = fminf(above, ratio);
+				}
+			}
+		}
+
+		printf("%-24s %10.3f %10.3f", dist.name, (double)lo, (double)hi);
+
+		if (below > 0.0f) {
+			printf(" %10.3f", (double)below);
+
+		} else {
+			printf(" %10s", "none");
+		}
+
+		if (isfinite(above)) {
+			printf(" %10.3f\n", (double)above);
+
+		} else {
+			printf(" %10s\n", "none");
+		}
+	}
+
+	free(sorted);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s -n samples -d NAME=normal|uniform|lognormal:a:b [-d ...] [-p NAME=value,...]\n"
+		"\t[-T duration_s] [-s seed] [-j threads] [-o dir]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct mc_s mc;
+	const char *out_dir = nullptr;
+	const char *params_arg = "";
+	unsigned threads = 0;
+	float duration = 10.0f;
+	int ch;
+
+	nlibs_host_default_params(mc.params);
+	mc.seed = 1;
+
+	while ((ch = getopt(argc, argv, "n:d:p:T:s:j:o:h")) != -1) {
+		switch (ch) {
+		case 'n':
+			mc.samples = strtoull(optarg, nullptr, 10);
+			break;
+
+		case 'd':
+			if (mc.ndists == MC_MAX_DISTS || !parse_dist(optarg, mc.dists[mc.ndists])) {
+				fprintf(stderr, "invalid distribution: %s\n", optarg);
+				return 1;
+			}
+
+			mc.ndists++;
+			break;
+
+		case 'p':
+			params_arg = optarg;
+
+			if (!nlibs_host_set_params(mc.params, optarg)) {
+				fprintf(stderr, "invalid parameters: %s\n", optarg);
+				return 1;
+			}
+
+			break;
+
+		case 'T':
+			duration = strtof(optarg, nullptr);
+			break;
+
+		case 's':
+			mc.seed = strtoull(optarg, nullptr, 0);
+			break;
+
+		case 'j':
+			threads = (unsigned)atoi(optarg);
+			break;
+
+		case 'o':
+			out_dir = optarg;
+			break;
+
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (mc.samples == 0 || mc.ndists == 0 || !(duration > 0.0f)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	/* only the parameters stored as given can be sampled, their value in -p is the nominal */
+	for (unsigned d = 0; d < mc.ndists; d++) {
+		const float *field = nlibs_host_param(mc.params, mc.dists[d].name);
+
+		if (field == nullptr || !(*field > 0.0f)) {
+			fprintf(stderr, "cannot sample %s\n", mc.dists[d].name);
+			return 1;
+		}
+
+		mc.dists[d].nominal = *field;
+	}
+
+	nlibs_sim_default_scenarios(mc.scenarios, duration);
+
+	const unsigned ncols = mc.ndists + NLIBS_SIM_METRICS;
+	mc.results = (float *)calloc(mc.samples, ncols * sizeof(float));
+	mc.done = (uint8_t *)calloc(mc.samples, 1);
+
+	if (threads == 0) {
+		threads = nlibs_pool_default_threads();
+	}
+
+	if (threads > MC_MAX_WORKERS) {
+		threads = MC_MAX_WORKERS;
+	}
+
+	mc.buffers = (struct mc_buffer_s *)calloc(threads, sizeof(struct mc_buffer_s));
+
+	if (mc.results == nullptr || mc.done == nullptr || mc.buffers == nullptr) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	if (out_dir != nullptr) {
+		/* the header pins everything a resumed run has to share with the first one */
+		char header[4096];
+		int n = snprintf(header, sizeof(header), "nlibs_montecarlo\nsamples %llu\nseed %llu\nduration %g\nparams %s",
+				 (unsigned long long)mc.samples, (unsigned long long)mc.seed, (double)duration, params_arg);
+
+		const char *names[MC_MAX_DISTS + NLIBS_SIM_METRICS];
+
+		for (unsigned d = 0; d < mc.ndists && n < (int)sizeof(header); d++) {
+			const struct mc_dist_s &dist = mc.dists[d];
+			static const char *types[] = { "normal", "uniform", "lognormal" };
+			n += snprintf(header + n, sizeof(header) - (size_t)n, "\ndist %s %s %g %g", dist.name, types[dist.type],
+				      (double)dist.a, (double)dist.b);
+			names[d] = dist.name;
+		}
+
+		for (unsigned k = 0; k < NLIBS_SIM_METRICS; k++) {
+			names[mc.ndists + k] = nlibs_sim_metric_names[k];
+		}
+
+		if (!mc.out.open(out_dir, header, names, ncols)) {
+			fprintf(stderr, "%s: cannot open, or holds a different run\n", out_dir);
+			return 1;
+		}
+
+		mc.out_enabled = true;
+
+		/* take back what a previous run already wrote */
+		uint64_t resumed = 0;
+
+		for (uint64_t r = 0; r < mc.out.rows(); r++) {
+			uint64_t index = mc.out.index()[r];
+
+			if (index < mc.samples && !mc.done[index]) {
+				for (unsigned c = 0; c < ncols; c++) {
+					mc.results[index * ncols + c] = mc.out.column(c)[r];
+				}
+
+				mc.done[index] = 1;
+				resumed++;
+			}
+		}
+
+		if (resumed > 0) {
+			fprintf(stderr, "resuming, %llu of %llu samples done\n", (unsigned long long)resumed,
+				(unsigned long long)mc.samples);
+		}
+
+		mc.completed = resumed;
+		mc.resumed = resumed;
+	}
+
+	pthread_mutex_init(&mc.out_lock, nullptr);
+	signal(SIGINT, mc_signal);
+	signal(SIGTERM, mc_signal);
+
+	mc.t_start = nlibs_host_time_ns();
+	mc.t_report = mc.t_start;
+
+	nlibs_pool_run(mc.samples, threads, mc_job, &mc, &g_stop);
+
+	for (unsigned i = 0; i < threads; i++) {
+		mc_flush(mc, mc.buffers[i]);
+	}
+
+	double wall = (double)(nlibs_host_time_ns() - mc.t_start) * 1e-9;
+	mc.out.close();
+
+	fprintf(stderr, "%.1f s on %u threads%s\n", wall, threads,
+		mc.out_error ? ", WRITE ERROR" : (g_stop ? ", interrupted" : ""));
+
+	mc_report(mc);
+
+	return mc.out_error ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_plant.cpp
+ * Quadrotor plant model for the host side NLIBS tools.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_plant.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <lib/geo/geo.h>
+
+/* vehicle resting on the ground, NED */
+#define GROUND_Z		0.0f
+
+NLIBSPlant::NLIBSPlant() :
+	_mass_inv(1.0f)
+{
+	_state.pos.zero();
+	_state.vel.zero();
+	_state.att.zero();
+	_state.rates.zero();
+	_motors.zero();
+	_inertia.zero();
+	_inertia_inv.zero();
+}
+
+void NLIBSPlant::set_model(const struct nlibs_params_s &model)
+{
+	_model = model;
+
+	_mass_inv = 1.0f / model.q_mass;
+	_inertia(0) = model.q_ix_moment;
+	_inertia(1) = model.q_iy_moment;
+	_inertia(2) = model.q_iz_moment;
+	_inertia_inv(0) = 1.0f / model.q_ix_moment;
+	_inertia_inv(1) = 1.0f / model.q_iy_moment;
+	_inertia_inv(2) = 1.0f / model.q_iz_moment;
+}
+
+void NLIBSPlant::reset(const math::Vector<3> &pos, float yaw)
+{
+	_state.pos = pos;
+	_state.vel.zero();
+	_state.att.zero();
+	_state.att(2) = yaw;
+	_state.rates.zero();
+	_motors.zero();
+}
+
+void NLIBSPlant::set_actuators(const math::Vector<3> &att_control, float thrust)
+{
+	/* inverse of the quarter sums output by NLIBSControlLaw::mix() */
+	_motors(0) = thrust - att_control(0) + att_control(1) + att_control(2);
+	_motors(1) = thrust + att_control(0) - att_control(1) + att_control(2);
+	_motors(2) = thrust + att_control(0) + att_control(1) - att_control(2);
+	_motors(3) = thrust - att_control(0) - att_control(1) - att_control(2);
+
+	for (int i = 0; i < 4; i++) {
+		_motors(i) = math::constrain(_motors(i), 0.0f, 1.0f);
+	}
+}
+
+void NLIBSPlant::set_motors(const math::Vector<4> &motors)
+{
+	for (int i = 0; i < 4; i++) {
+		_motors(i) = math::constrain(motors(i), 0.0f, 1.0f);
+	}
+}
+
+void NLIBSPlant::derivative(const struct nlibs_plant_state_s &s, struct nlibs_plant_state_s &d) const
+{
+	const float sphi = sinf(s.att(0));
+	const float cphi = cosf(s.att(0));
+	const float sthe = sinf(s.att(1));
+	const float cthe = cosf(s.att(1));
+	const float spsi = sinf(s.att(2));
+	const float cpsi = cosf(s.att(2));
+
+	/* body to NED rotation, as built by the control law */
+	math::Matrix<3, 3> Rt;
+	Rt(0, 0) = cthe * cpsi;
+	Rt(0, 1) = sthe * sphi * cpsi - spsi * cphi;
+	Rt(0, 2) = sthe * cphi * cpsi + spsi * sphi;
+	Rt(1, 0) = cthe * spsi;
+	Rt(1, 1) = sthe * sphi * spsi + cpsi * cphi;
+	Rt(1, 2) = sthe * cphi * spsi - cpsi * sphi;
+	Rt(2, 0) = -sthe;
+	Rt(2, 1) = cthe * sphi;
+	Rt(2, 2) = cthe * cphi;
+
+	/* rotor forces to thrust and moments, through the controller's allocation matrix */
+	const math::Vector<4> u = _model.derived.allocation.B * (_motors * _model.q_motor_cst);
+
+	/* translation: thrust and linear drag in body frame */
+	math::Vector<3> vel_body = Rt.transposed() * s.vel;
+	math::Vector<3> force_body;
+	force_body(0) = -_model.q_xlin_drag * vel_body(0);
+	force_body(1) = -_model.q_ylin_drag * vel_body(1);
+	force_body(2) = -_model.q_zlin_drag * vel_body(2) + u(0);
+
+	d.pos = s.vel;
+	d.vel = (Rt * force_body) * _mass_inv;
+	d.vel(2) += CONSTANTS_ONE_G;
+
+	/* rotation: rotor moments, rotational drag and gyroscopic coupling */
+	math::Vector<3> moment;
+	moment(0) = u(1) - _model.q_xrot_drag * s.rates(0);
+	moment(1) = u(2) - _model.q_yrot_drag * s.rates(1);
+	moment(2) = u(3) - _model.q_zrot_drag * s.rates(2);
+
+	math::Vector<3> h = s.rates.emult(_inertia);
+	moment(0) -= s.rates(1) * h(2) - s.rates(2) * h(1);
+	moment(1) -= s.rates(2) * h(0) - s.rates(0) * h(2);
+	moment(2) -= s.rates(0) * h(1) - s.rates(1) * h(0);
+
+	d.rates = moment.emult(_inertia_inv);
+
+	/* body rates to Euler angle rates */
+	const float t_theta = sthe / cthe;
+	d.att(0) = s.rates(0) + (sphi * s.rates(1) + cphi * s.rates(2)) * t_theta;
+	d.att(1) = cphi * s.rates(1) - sphi * s.rates(2);
+	d.att(2) = (sphi * s.rates(1) + cphi * s.rates(2)) / cthe;
+}
+
+void NLIBSPlant::step(float dt)
+{
+	struct nlibs_plant_state_s k1, k2, k3, k4, s;
+	const struct nlibs_plant_state_s &x = _state;
+
+	derivative(x, k1);
+
+	s.pos = x.pos + k1.pos * (0.5f * dt);
+	s.vel = x.vel + k1.vel * (0.5f * dt);
+	s.att = x.att + k1.att * (0.5f * dt);
+	s.rates = x.rates + k1.rates * (0.5f * dt);
+	derivative(s, k2);
+
+	s.pos = x.pos + k2.pos * (0.5f * dt);
+	s.vel = x.vel + k2.vel * (0.5f * dt);
+	s.att = x.att + k2.att * (0.5f * dt);
+	s.rates = x.rates + k2.rates * (0.5f * dt);
+	derivative(s, k3);
+
+	s.pos = x.pos + k3.pos * dt;
+	s.vel = x.vel + k3.vel * dt;
+	s.att = x.att + k3.att * dt;
+	s.rates = x.rates + k3.rates * dt;
+	derivative(s, k4);
+
+	const float k = dt / 6.0f;
+	_state.pos += (k1.pos + k2.pos * 2.0f + k3.pos * 2.0f + k4.pos) * k;
+	_state.vel += (k1.vel + k2.vel * 2.0f + k3.vel * 2.0f + k4.vel) * k;
+	_state.att += (k1.att + k2.att * 2.0f + k3.att * 2.0f + k4.att) * k;
+	_state.rates += (k1.rates + k2.rates * 2.0f + k3.rates * 2.0f + k4.rates) * k;
+
+	_state.att(0) = _wrap_pi(_state.att(0));
+	_state.att(2) = _wrap_pi(_state.att(2));
+
+	/* the ground only pushes up */
+	if (_state.pos(2) > GROUND_Z) {
+		_state.pos(2) = GROUND_Z;
+
+		if (_state.vel(2) > 0.0f) {
+			_state.vel.zero();
+			_state.rates.zero();
+		}
+	}
+}
+
+void NLIBSPlant::measure(struct nlibs_input_s &in) const
+{
+	in.phi = _state.att(0);
+	in.theta = _state.att(1);
+	in.psi = _state.att(2);
+	in.R.from_euler(in.phi, in.theta, in.psi);
+	in.rates = _state.rates;
+	in.pos = _state.pos;
+	in.vel = _state.vel;
+}
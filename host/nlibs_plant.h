@@ -0,0 +1,116 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_plant.h
+ * Quadrotor plant model for the host side NLIBS tools.
+ *
+ * Rigid body with four rotors in X configuration, built on the NLIBSC_Q*
+ * parameters: rotor i produces q_motor_cst * n_i of thrust along -z body
+ * for a normalized command n_i, the same model the control law inverts.
+ * Thrust and moments come from the allocation matrix of the controller.
+ * Linear drag acts on the body frame velocity and rotational drag on the
+ * body rates, gyroscopic coupling is included. The state is integrated
+ * with a fixed step fourth order Runge-Kutta, the motor commands being held
+ * over the step.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include "../nlibs_control_law.h"
+
+struct nlibs_plant_state_s {
+	math::Vector<3> pos;		/**< NED position */
+	math::Vector<3> vel;		/**< NED velocity */
+	math::Vector<3> att;		/**< roll, pitch, yaw */
+	math::Vector<3> rates;		/**< body angular rates */
+};
+
+class NLIBSPlant
+{
+public:
+	NLIBSPlant();
+
+	/**
+	 * Physical model, the q_* fields and the allocation matrix are used.
+	 */
+	void	set_model(const struct nlibs_params_s &model);
+
+	/**
+	 * Put the vehicle at rest at a position and yaw.
+	 */
+	void	reset(const math::Vector<3> &pos, float yaw);
+
+	/**
+	 * Normalized motor commands from actuator controls, through the
+	 * quadrotor X mixer the control law assumes, limited to [0, 1].
+	 */
+	void	set_actuators(const math::Vector<3> &att_control, float thrust);
+
+	/**
+	 * Normalized motor commands of every rotor, as published on
+	 * actuator_direct, limited to [0, 1].
+	 */
+	void	set_motors(const math::Vector<4> &motors);
+
+	/**
+	 * Advance the state by one fixed step.
+	 */
+	void	step(float dt);
+
+	const struct nlibs_plant_state_s &state() const { return _state; }
+
+	const math::Vector<4> &motors() const { return _motors; }
+
+	/**
+	 * Fill the control law input with the vehicle state.
+	 */
+	void	measure(struct nlibs_input_s &in) const;
+
+private:
+	struct nlibs_params_s _model;
+	struct nlibs_plant_state_s _state;
+	math::Vector<4> _motors;			/**< normalized motor commands */
+
+	/* quantities constant over the model */
+	float _mass_inv;
+	math::Vector<3> _inertia;
+	math::Vector<3> _inertia_inv;
+
+	void	derivative(const struct nlibs_plant_state_s &s, struct nlibs_plant_state_s &d) const;
+};
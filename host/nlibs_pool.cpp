@@ -0,0 +1,240 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_pool.cpp
+ * Work stealing thread pool for the host side NLIBS tools.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct pool_share_s {
+	pthread_mutex_t lock;
+	uint64_t begin;				/**< next job of the owner */
+	uint64_t end;				/**< one past the last job, thieves take from here */
+} __attribute__((aligned(64)));
+
+struct pool_s {
+	struct pool_share_s *shares;
+	unsigned threads;
+	nlibs_pool_job_t job;
+	void *arg;
+	volatile bool *stop;
+};
+
+struct pool_worker_s {
+	struct pool_s *pool;
+	unsigned id;
+};
+
+/**
+ * Take the next job of a share from the front.
+ */
+static bool pool_take(struct pool_share_s &s, uint64_t &index)
+{
+	bool ok = false;
+
+	pthread_mutex_lock(&s.lock);
+
+	if (s.begin < s.end) {
+		index = s.begin++;
+		ok = true;
+	}
+
+	pthread_mutex_unlock(&s.lock);
+
+	return ok;
+}
+
+/**
+ * Move the back half of the largest other share to ours.
+ */
+static bool pool_steal(struct pool_s &pool, unsigned id)
+{
+	for (;;) {
+		/* pick the victim without locking, the numbers are checked again under its lock */
+		unsigned victim = id;
+		uint64_t left_max = 0;
+
+		for (unsigned i = 0; i < pool.threads; i++) {
+			const struct pool_share_s &s = pool.shares[i];
+			uint64_t begin = __atomic_load_n(&s.begin, __ATOMIC_RELAXED);
+			uint64_t end = __atomic_load_n(&s.end, __ATOMIC_RELAXED);
+			uint64_t left = (end > begin) ? end - begin : 0;
+
+			if (i != id && left > left_max) {
+				left_max = left;
+				victim = i;
+			}
+		}
+
+		if (victim == id) {
+			return false;
+		}
+
+		struct pool_share_s &v = pool.shares[victim];
+		uint64_t begin = 0;
+		uint64_t end = 0;
+
+		pthread_mutex_lock(&v.lock);
+
+		if (v.begin < v.end) {
+			uint64_t left = v.end - v.begin;
+			begin = v.end - (left + 1) / 2;
+			end = v.end;
+			v.end = begin;
+		}
+
+		pthread_mutex_unlock(&v.lock);
+
+		if (begin < end) {
+			struct pool_share_s &s = pool.shares[id];
+
+			pthread_mutex_lock(&s.lock);
+			s.begin = begin;
+			s.end = end;
+			pthread_mutex_unlock(&s.lock);
+
+			return true;
+		}
+
+		/* the victim ran dry meanwhile, look again */
+	}
+}
+
+static void *pool_worker(void *arg)
+{
+	struct pool_worker_s *w = (struct pool_worker_s *)arg;
+	struct pool_s &pool = *w->pool;
+	uint64_t index;
+
+	for (;;) {
+		if (pool.stop != nullptr && *pool.stop) {
+			break;
+		}
+
+		if (pool_take(pool.shares[w->id], index)) {
+			pool.job(index, w->id, pool.arg);
+
+		} else if (!pool_steal(pool, w->id)) {
+			break;
+		}
+	}
+
+	return nullptr;
+}
+
+unsigned nlibs_pool_default_threads()
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0) ? (unsigned)n : 1;
+}
+
+void nlibs_pool_run(uint64_t count, unsigned threads, nlibs_pool_job_t job, void *arg, volatile bool *stop)
+{
+	if (threads == 0) {
+		threads = nlibs_pool_default_threads();
+	}
+
+	if ((uint64_t)threads > count) {
+		threads = (count > 0) ? (unsigned)count : 1;
+	}
+
+	struct pool_s pool;
+	pool.shares = (struct pool_share_s *)calloc(threads, sizeof(struct pool_share_s));
+	pool.threads = threads;
+	pool.job = job;
+	pool.arg = arg;
+	pool.stop = stop;
+
+	struct pool_worker_s *workers = (struct pool_worker_s *)calloc(threads, sizeof(struct pool_worker_s));
+	pthread_t *tids = (pthread_t *)calloc(threads, sizeof(pthread_t));
+
+	if (pool.shares == nullptr || workers == nullptr || tids == nullptr) {
+		free(pool.shares);
+		free(workers);
+		free(tids);
+
+		/* out of memory, run everything on the calling thread */
+		for (uint64_t i = 0; i < count && !(stop != nullptr && *stop); i++) {
+			job(i, 0, arg);
+		}
+
+		return;
+	}
+
+	/* even shares to start with */
+	for (unsigned i = 0; i < threads; i++) {
+		pthread_mutex_init(&pool.shares[i].lock, nullptr);
+		pool.shares[i].begin = count * i / threads;
+		pool.shares[i].end = count * (i + 1) / threads;
+		workers[i].pool = &pool;
+		workers[i].id = i;
+	}
+
+	/* the calling thread is worker 0 */
+	unsigned started = 1;
+
+	for (unsigned i = 1; i < threads; i++) {
+		if (pthread_create(&tids[i], nullptr, pool_worker, &workers[i]) != 0) {
+			break;
+		}
+
+		started++;
+	}
+
+	pool_worker(&workers[0]);
+
+	for (unsigned i = 1; i < started; i++) {
+		pthread_join(tids[i], nullptr);
+	}
+
+	/* shares of workers which failed to start were stolen by the others, nothing is left */
+	for (unsigned i = 0; i < threads; i++) {
+		pthread_mutex_destroy(&pool.shares[i].lock);
+	}
+
+	free(pool.shares);
+	free(workers);
+	free(tids);
+}
@@ -0,0 +1,476 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_replay.cpp
+ * Replay of sdlog2 flight logs through the NLIBS control law.
+ *
+ * The logged attitude, local position and setpoints are fed to the control
+ * law in log order, with the dt taken from the log timestamps. As in the
+ * module, the attitude stages run once per logged attitude and the position
+ * stages only when a local position or the mode changed in between. The actuator controls and rates setpoint the
+ * controller would have published are written as CSV, one line per step,
+ * with the virtual controls its rotor forces produce through the
+ * allocation matrix.
+ * Nothing waits on the clock, a log replays as fast as the CPU allows.
+ *
+ * The control mode follows the commander main state of the STAT message:
+ * manual and acro replay the attitude setpoint, altitude control adds the
+ * altitude chain and every other mode the full position chain, on the
+ * logged local position setpoint. The mode can be forced with -m.
+ *
+ * usage: nlibs_replay [-m pos|alt|att] [-p NAME=value,...] [-o output.csv] log.px4log...
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nlibs_host.h"
+#include "nlibs_log.h"
+
+/* commander main states and arming states, as logged in STAT */
+#define MAIN_STATE_MANUAL		0
+#define MAIN_STATE_ALTCTL		1
+#define MAIN_STATE_ACRO			6
+#define ARMING_STATE_ARMED		2
+#define ARMING_STATE_ARMED_ERROR	3
+
+enum replay_mode_e {
+	REPLAY_MODE_LOG = 0,		/**< follow the logged main state */
+	REPLAY_MODE_POS,
+	REPLAY_MODE_ALT,
+	REPLAY_MODE_ATT
+};
+
+enum replay_msg_e {
+	MSG_UNKNOWN = -2,
+	MSG_IGNORED = -1,
+	MSG_TIME = 0,
+	MSG_ATT,
+	MSG_LPOS,
+	MSG_LPSP,
+	MSG_ATSP,
+	MSG_STAT
+};
+
+/**
+ * Field indices of the messages we replay, resolved on first sight of each message type.
+ */
+struct replay_fields_s {
+	int time;
+	int att[6];
+	int lpos[6];
+	int lpsp[4];
+	int atsp[4];
+	int main_state;
+	int arming_state;
+};
+
+struct replay_stats_s {
+	uint64_t steps;
+	uint64_t log_us;
+	uint64_t wall_ns;
+};
+
+struct replay_s {
+	NLIBSControlLaw law;
+	struct nlibs_params_s params;
+	enum replay_mode_e mode;
+	FILE *out;
+
+	signed char msg[256];
+	struct replay_fields_s fields;
+
+	struct nlibs_input_s in;
+	uint64_t time;				/**< latest logged timestamp */
+	uint64_t time_step;			/**< timestamp of the previous control step */
+	uint64_t time_start;
+	int main_state;
+	bool armed;
+	bool have_att;
+	bool have_lpos;
+	bool have_lpsp;
+	bool position_stale;		/**< new local position or mode since the last position stages */
+};
+
+static void resolve(struct replay_s &r, const struct nlibs_log_format_s *fmt)
+{
+	static const char *att_labels[] = { "Roll", "Pitch", "Yaw", "RollRate", "PitchRate", "YawRate" };
+	static const char *lpos_labels[] = { "X", "Y", "Z", "VX", "VY", "VZ" };
+	static const char *lpsp_labels[] = { "X", "Y", "Z", "Yaw" };
+	static const char *atsp_labels[] = { "RollSP", "PitchSP", "YawSP", "ThrustSP" };
+
+	struct replay_fields_s &f = r.fields;
+	signed char &msg = r.msg[fmt->type];
+
+	msg = MSG_IGNORED;
+
+	if (strncmp(fmt->name, "TIME", 4) == 0) {
+		msg = MSG_TIME;
+		f.time = NLIBSLogReader::field(fmt, "StartTime");
+
+	} else if (strncmp(fmt->name, "ATT", 4) == 0) {
+		msg = MSG_ATT;
+
+		for (unsigned i = 0; i < 6; i++) {
+			f.att[i] = NLIBSLogReader::field(fmt, att_labels[i]);
+		}
+
+	} else if (strncmp(fmt->name, "LPOS", 4) == 0) {
+		msg = MSG_LPOS;
+
+		for (unsigned i = 0; i < 6; i++) {
+			f.lpos[i] = NLIBSLogReader::field(fmt, lpos_labels[i]);
+		}
+
+	} else if (strncmp(fmt->name, "LPSP", 4) == 0) {
+		msg = MSG_LPSP;
+
+		for (unsigned i = 0; i < 4; i++) {
+			f.lpsp[i] = NLIBSLogReader::field(fmt, lpsp_labels[i]);
+		}
+
+	} else if (strncmp(fmt->name, "ATSP", 4) == 0) {
+		msg = MSG_ATSP;
+
+		for (unsigned i = 0; i < 4; i++) {
+			f.atsp[i] = NLIBSLogReader::field(fmt, atsp_labels[i]);
+		}
+
+	} else if (strncmp(fmt->name, "STAT", 4) == 0) {
+		msg = MSG_STAT;
+		f.main_state = NLIBSLogReader::field(fmt, "MainState");
+		f.arming_state = NLIBSLogReader::field(fmt, "ArmS");
+	}
+}
+
+static void replay_step(struct replay_s &r, unsigned log_index)
+{
+	/* same guard as the module against too small (< 2ms) and too large (> 20ms) dt's */
+	float dt = (r.time_step != 0) ? (float)(r.time - r.time_step) * 0.000001f : 0.0f;
+	r.time_step = r.time;
+
+	if (dt < 0.002f) {
+		dt = 0.002f;
+
+	} else if (dt > 0.02f) {
+		dt = 0.02f;
+	}
+
+	struct nlibs_input_s &in = r.in;
+
+	if (!r.armed) {
+		/* reset setpoints and integrals to current state when disarmed */
+		r.law.reset();
+		r.have_lpsp = false;
+		return;
+	}
+
+	enum replay_mode_e mode = r.mode;
+
+	if (mode == REPLAY_MODE_LOG) {
+		if (r.main_state == MAIN_STATE_MANUAL || r.main_state == MAIN_STATE_ACRO) {
+			mode = REPLAY_MODE_ATT;
+
+		} else if (r.main_state == MAIN_STATE_ALTCTL) {
+			mode = REPLAY_MODE_ALT;
+
+		} else {
+			mode = REPLAY_MODE_POS;
+		}
+	}
+
+	bool position_enabled = (mode == REPLAY_MODE_POS);
+	bool altitude_enabled = (mode == REPLAY_MODE_POS || mode == REPLAY_MODE_ALT);
+
+	if (position_enabled != in.position_enabled || altitude_enabled != in.altitude_enabled) {
+		in.position_enabled = position_enabled;
+		in.altitude_enabled = altitude_enabled;
+		r.position_stale = true;
+	}
+
+	/* hold the current position until a setpoint was logged */
+	if (!r.have_lpsp) {
+		in.pos_sp = in.pos;
+	}
+
+	/* the position stages hold their references between two local positions */
+	if (r.position_stale) {
+		r.position_stale = false;
+		r.law.update_position(r.params, in);
+	}
+
+	struct nlibs_output_s out;
+	r.law.control_attitude(r.params, in, dt, out);
+
+	if (r.out != nullptr) {
+		math::Vector<4> u = r.params.derived.allocation.B * out.forces;
+
+		fprintf(r.out, "%u,%llu,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n", log_index,
+			(unsigned long long)r.time,
+			(double)out.att_control(0), (double)out.att_control(1), (double)out.att_control(2),
+			(double)out.thrust,
+			(double)out.rates_sp(0), (double)out.rates_sp(1), (double)out.rates_sp(2),
+			(double)u(0), (double)u(1), (double)u(2), (double)u(3));
+	}
+}
+
+static bool replay_log(struct replay_s &r, const char *path, unsigned log_index, struct replay_stats_s &stats)
+{
+	NLIBSLogReader log;
+
+	if (!log.open(path)) {
+		perror(path);
+		return false;
+	}
+
+	r.law.reset();
+	memset(r.msg, MSG_UNKNOWN, sizeof(r.msg));
+	memset(&r.fields, -1, sizeof(r.fields));
+	r.in.pos.zero();
+	r.in.vel.zero();
+	r.in.pos_sp.zero();
+	r.in.vel_ff.zero();
+	r.in.roll_sp = 0.0f;
+	r.in.pitch_sp = 0.0f;
+	r.in.yaw_sp = 0.0f;
+	r.in.thrust_sp = 0.0f;
+	r.time = 0;
+	r.time_step = 0;
+	r.time_start = 0;
+	r.main_state = -1;
+	r.armed = true;
+	r.have_att = false;
+	r.have_lpos = false;
+	r.have_lpsp = false;
+	r.in.position_enabled = false;
+	r.in.altitude_enabled = false;
+	r.position_stale = false;
+
+	const struct nlibs_log_format_s *fmt;
+	const uint8_t *payload;
+
+	uint64_t steps = 0;
+	uint64_t t0 = nlibs_host_time_ns();
+
+	while (log.next(fmt, payload)) {
+		if (r.msg[fmt->type] == MSG_UNKNOWN) {
+			resolve(r, fmt);
+		}
+
+		const struct replay_fields_s &f = r.fields;
+		struct nlibs_input_s &in = r.in;
+
+		switch (r.msg[fmt->type]) {
+		case MSG_TIME:
+			r.time = (uint64_t)NLIBSLogReader::value(fmt, payload, f.time);
+
+			if (r.time_start == 0) {
+				r.time_start = r.time;
+			}
+
+			break;
+
+		case MSG_ATT:
+			in.phi = (float)NLIBSLogReader::value(fmt, payload, f.att[0]);
+			in.theta = (float)NLIBSLogReader::value(fmt, payload, f.att[1]);
+			in.psi = (float)NLIBSLogReader::value(fmt, payload, f.att[2]);
+			/* ATT logs the Euler angles only */
+			in.R.from_euler(in.phi, in.theta, in.psi);
+			in.rates(0) = (float)NLIBSLogReader::value(fmt, payload, f.att[3]);
+			in.rates(1) = (float)NLIBSLogReader::value(fmt, payload, f.att[4]);
+			in.rates(2) = (float)NLIBSLogReader::value(fmt, payload, f.att[5]);
+			r.have_att = true;
+
+			/* the controller runs on every new attitude, once per logged timestamp */
+			if (r.have_lpos && r.time != 0 && r.time != r.time_step) {
+				replay_step(r, log_index);
+				steps++;
+			}
+
+			break;
+
+		case MSG_LPOS:
+			for (unsigned i = 0; i < 3; i++) {
+				in.pos(i) = (float)NLIBSLogReader::value(fmt, payload, f.lpos[i]);
+				in.vel(i) = (float)NLIBSLogReader::value(fmt, payload, f.lpos[i + 3]);
+			}
+
+			r.have_lpos = true;
+			r.position_stale = true;
+			break;
+
+		case MSG_LPSP:
+			for (unsigned i = 0; i < 3; i++) {
+				in.pos_sp(i) = (float)NLIBSLogReader::value(fmt, payload, f.lpsp[i]);
+			}
+
+			in.yaw_sp = (float)NLIBSLogReader::value(fmt, payload, f.lpsp[3]);
+			r.have_lpsp = true;
+			break;
+
+		case MSG_ATSP:
+			in.roll_sp = (float)NLIBSLogReader::value(fmt, payload, f.atsp[0]);
+			in.pitch_sp = (float)NLIBSLogReader::value(fmt, payload, f.atsp[1]);
+			in.thrust_sp = (float)NLIBSLogReader::value(fmt, payload, f.atsp[3]);
+
+			/* yaw follows the local position setpoint when there is one */
+			if (!r.have_lpsp) {
+				in.yaw_sp = (float)NLIBSLogReader::value(fmt, payload, f.atsp[2]);
+			}
+
+			break;
+
+		case MSG_STAT: {
+				r.main_state = (int)NLIBSLogReader::value(fmt, payload, f.main_state);
+
+				int arming_state = (int)NLIBSLogReader::value(fmt, payload, f.arming_state);
+				r.armed = (arming_state == ARMING_STATE_ARMED || arming_state == ARMING_STATE_ARMED_ERROR);
+				break;
+			}
+
+		default:
+			break;
+		}
+	}
+
+	stats.steps = steps;
+	stats.log_us = r.time - r.time_start;
+	stats.wall_ns = nlibs_host_time_ns() - t0;
+
+	return true;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-m pos|alt|att] [-p NAME=value,...] [-o output.csv] log.px4log...\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct replay_s r;
+	const char *out_path = nullptr;
+	int ch;
+
+	nlibs_host_default_params(r.params);
+	r.mode = REPLAY_MODE_LOG;
+
+	while ((ch = getopt(argc, argv, "m:p:o:h")) != -1) {
+		switch (ch) {
+		case 'm':
+			if (strcmp(optarg, "pos") == 0) {
+				r.mode = REPLAY_MODE_POS;
+
+			} else if (strcmp(optarg, "alt") == 0) {
+				r.mode = REPLAY_MODE_ALT;
+
+			} else if (strcmp(optarg, "att") == 0) {
+				r.mode = REPLAY_MODE_ATT;
+
+			} else {
+				usage(argv[0]);
+				return 1;
+			}
+
+			break;
+
+		case 'p':
+			if (!nlibs_host_set_params(r.params, optarg)) {
+				fprintf(stderr, "invalid parameters: %s\n", optarg);
+				return 1;
+			}
+
+			break;
+
+		case 'o':
+			out_path = optarg;
+			break;
+
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	r.out = stdout;
+
+	if (out_path != nullptr) {
+		r.out = fopen(out_path, "w");
+
+		if (r.out == nullptr) {
+			perror(out_path);
+			return 1;
+		}
+	}
+
+	/* one line per control step, keep the writes large */
+	static char out_buf[1 << 20];
+	setvbuf(r.out, out_buf, _IOFBF, sizeof(out_buf));
+
+	fprintf(r.out, "log,timestamp,roll,pitch,yaw,thrust,rollspeed_sp,pitchspeed_sp,yawspeed_sp,u_z,u_phi,u_theta,u_psy\n");
+
+	int ret = 0;
+
+	for (int i = optind; i < argc; i++) {
+		struct replay_stats_s stats;
+
+		if (!replay_log(r, argv[i], (unsigned)(i - optind), stats)) {
+			ret = 1;
+			continue;
+		}
+
+		double wall = (double)stats.wall_ns * 1e-9;
+		double flight = (double)stats.log_us * 1e-6;
+
+		fprintf(stderr, "%s: %llu steps, %.1f s of log in %.3f s (%.0fx real time)\n", argv[i],
+			(unsigned long long)stats.steps, flight, wall, (wall > 0.0) ? flight / wall : 0.0);
+	}
+
+	if (r.out != stdout) {
+		fclose(r.out);
+	}
+
+	return ret;
+}
@@ -0,0 +1,265 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_sim.cpp
+ * Closed loop simulation of the NLIBS control law on the plant model.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_sim.h"
+
+#include <math.h>
+
+#include <lib/geo/geo.h>
+
+/* a run is stopped past these */
+#define DIVERGED_POS_ERR	100.0f
+#define DIVERGED_TILT		1.4f
+
+const char *const nlibs_sim_metric_names[NLIBS_SIM_METRICS] = {
+	"settle_time", "overshoot", "effort", "pos_err_rms", "tilt_max", "diverged"
+};
+
+void nlibs_sim_default_config(struct nlibs_sim_config_s &config)
+{
+	config.duration = 10.0f;
+	config.control_dt = 0.004f;
+	config.substeps = 4;
+	config.position_divider = 1;
+
+	config.pos0.zero();
+	config.pos0(2) = -5.0f;
+	config.yaw0 = 0.0f;
+	config.pos_sp(0) = 1.0f;
+	config.pos_sp(1) = 1.0f;
+	config.pos_sp(2) = -6.0f;
+	config.yaw_sp = 0.0f;
+
+	config.position_enabled = true;
+	config.altitude_enabled = true;
+
+	config.settle_pos = 0.05f;
+	config.settle_yaw = 0.05f;
+}
+
+float nlibs_sim_unsettled_time(const struct nlibs_sim_config_s &config)
+{
+	return (float)(uint64_t)(config.duration / config.control_dt) * config.control_dt;
+}
+
+void nlibs_sim_run(const struct nlibs_sim_config_s &config, const struct nlibs_params_s &params,
+		   const struct nlibs_params_s &model, struct nlibs_sim_result_s &result, FILE *trace)
+{
+	NLIBSControlLaw law;
+	NLIBSPlant plant;
+
+	plant.set_model(model);
+	plant.reset(config.pos0, config.yaw0);
+
+	struct nlibs_input_s in;
+	in.pos_sp = config.pos_sp;
+	in.vel_ff.zero();
+	in.roll_sp = 0.0f;
+	in.pitch_sp = 0.0f;
+	in.yaw_sp = config.yaw_sp;
+	in.thrust_sp = 0.0f;
+	in.position_enabled = config.position_enabled;
+	in.altitude_enabled = config.altitude_enabled;
+
+	const uint64_t steps = (uint64_t)(config.duration / config.control_dt);
+	const float plant_dt = config.control_dt / (float)config.substeps;
+
+	result.steps = 0;
+	result.pos_err_rms = 0.0f;
+	result.pos_err_final = 0.0f;
+	result.yaw_err_final = 0.0f;
+	result.tilt_max = 0.0f;
+	result.settle_time = 0.0f;
+	result.overshoot = 0.0f;
+	result.effort = 0.0f;
+	result.diverged = false;
+
+	double err_sq_sum = 0.0;
+	double travel = 0.0;
+
+	/* direction of the step, overshoot is measured along it */
+	math::Vector<3> step = config.pos_sp - config.pos0;
+	float step_len = step.length();
+	math::Vector<3> step_dir = (step_len > 0.0f) ? step / step_len : step;
+
+	math::Vector<4> motors_prev;
+	uint64_t settled_since = 0;
+
+	if (trace != nullptr) {
+		fprintf(trace, "t,x,y,z,vx,vy,vz,roll,pitch,yaw,rollspeed,pitchspeed,yawspeed,m1,m2,m3,m4\n");
+	}
+
+	for (uint64_t k = 0; k < steps; k++) {
+		plant.measure(in);
+
+		struct nlibs_output_s out;
+
+		/* the position stages only see every position_divider-th local position */
+		if (k % config.position_divider == 0) {
+			law.update_position(params, in);
+		}
+
+		law.control_attitude(params, in, config.control_dt, out);
+
+		if (params.out_direct != 0) {
+			plant.set_motors(out.motors);
+
+		} else {
+			plant.set_actuators(out.att_control, out.thrust);
+		}
+
+		const math::Vector<4> &motors = plant.motors();
+
+		if (k > 0) {
+			for (int i = 0; i < 4; i++) {
+				travel += (double)fabsf(motors(i) - motors_prev(i));
+			}
+		}
+
+		motors_prev = motors;
+
+		for (unsigned i = 0; i < config.substeps; i++) {
+			plant.step(plant_dt);
+		}
+
+		const struct nlibs_plant_state_s &s = plant.state();
+
+		math::Vector<3> err = config.pos_sp - s.pos;
+		float err_len = err.length();
+		float tilt = acosf(math::constrain(cosf(s.att(0)) * cosf(s.att(1)), -1.0f, 1.0f));
+
+		err_sq_sum += (double)(err_len * err_len);
+
+		if (tilt > result.tilt_max) {
+			result.tilt_max = tilt;
+		}
+
+		result.steps = k + 1;
+		result.pos_err_final = err_len;
+		result.yaw_err_final = fabsf(_wrap_pi(config.yaw_sp - s.att(2)));
+
+		float past = -(err * step_dir);
+
+		if (past > result.overshoot) {
+			result.overshoot = past;
+		}
+
+		if (err_len > config.settle_pos || result.yaw_err_final > config.settle_yaw) {
+			settled_since = k + 1;
+		}
+
+		if (trace != nullptr) {
+			fprintf(trace, "%.4f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.4f,%.4f,%.4f,%.4f\n",
+				(double)(k + 1) * (double)config.control_dt,
+				(double)s.pos(0), (double)s.pos(1), (double)s.pos(2),
+				(double)s.vel(0), (double)s.vel(1), (double)s.vel(2),
+				(double)s.att(0), (double)s.att(1), (double)s.att(2),
+				(double)s.rates(0), (double)s.rates(1), (double)s.rates(2),
+				(double)motors(0), (double)motors(1), (double)motors(2), (double)motors(3));
+		}
+
+		if (!isfinite(err_len) || err_len > DIVERGED_POS_ERR || !(tilt < DIVERGED_TILT)) {
+			result.diverged = true;
+			break;
+		}
+	}
+
+	if (result.steps > 0) {
+		result.pos_err_rms = (float)sqrt(err_sq_sum / (double)result.steps);
+		result.effort = (float)(travel / ((double)result.steps * (double)config.control_dt));
+	}
+
+	/* a run cut short never settled */
+	result.settle_time = result.diverged ? nlibs_sim_unsettled_time(config) : (float)settled_since * config.control_dt;
+}
+
+void nlibs_sim_default_scenarios(struct nlibs_sim_config_s scenarios[NLIBS_SIM_SCENARIOS], float duration)
+{
+	nlibs_sim_default_config(scenarios[0]);
+	scenarios[0].duration = duration;
+
+	nlibs_sim_default_config(scenarios[1]);
+	scenarios[1].duration = duration;
+	scenarios[1].pos_sp = scenarios[1].pos0;
+	scenarios[1].yaw_sp = 1.0f;
+}
+
+void nlibs_sim_run_scenarios(const struct nlibs_sim_config_s *scenarios, unsigned count,
+			     const struct nlibs_params_s &params, const struct nlibs_params_s &model,
+			     struct nlibs_sim_result_s &result)
+{
+	result.steps = 0;
+	result.pos_err_rms = 0.0f;
+	result.pos_err_final = 0.0f;
+	result.yaw_err_final = 0.0f;
+	result.tilt_max = 0.0f;
+	result.settle_time = 0.0f;
+	result.overshoot = 0.0f;
+	result.effort = 0.0f;
+	result.diverged = false;
+
+	for (unsigned s = 0; s < count; s++) {
+		struct nlibs_sim_result_s res;
+		nlibs_sim_run(scenarios[s], params, model, res, nullptr);
+
+		result.steps += res.steps;
+		result.pos_err_rms += res.pos_err_rms / (float)count;
+		result.pos_err_final = fmaxf(result.pos_err_final, res.pos_err_final);
+		result.yaw_err_final = fmaxf(result.yaw_err_final, res.yaw_err_final);
+		result.tilt_max = fmaxf(result.tilt_max, res.tilt_max);
+		result.settle_time = fmaxf(result.settle_time, res.settle_time);
+		result.overshoot = fmaxf(result.overshoot, res.overshoot);
+		result.effort += res.effort / (float)count;
+		result.diverged = result.diverged || res.diverged;
+	}
+}
+
+void nlibs_sim_metrics(const struct nlibs_sim_result_s &result, float metrics[NLIBS_SIM_METRICS])
+{
+	metrics[NLIBS_SIM_SETTLE_TIME] = result.settle_time;
+	metrics[NLIBS_SIM_OVERSHOOT] = result.overshoot;
+	metrics[NLIBS_SIM_EFFORT] = result.effort;
+	metrics[NLIBS_SIM_POS_ERR_RMS] = result.pos_err_rms;
+	metrics[NLIBS_SIM_TILT_MAX] = result.tilt_max;
+	metrics[NLIBS_SIM_DIVERGED] = result.diverged ? 1.0f : 0.0f;
+}
@@ -0,0 +1,140 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_sim.h
+ * Closed loop simulation of the NLIBS control law on the plant model.
+ *
+ * The control law runs at a fixed period on the state of the plant, the
+ * actuator controls it outputs are held while the plant is stepped a fixed
+ * number of times per period, the way the controller drives the mixer.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nlibs_plant.h"
+
+#define NLIBS_SIM_SCENARIOS		2
+
+/* result columns written by the sweep and Monte-Carlo tools */
+enum nlibs_sim_metric_e {
+	NLIBS_SIM_SETTLE_TIME = 0,
+	NLIBS_SIM_OVERSHOOT,
+	NLIBS_SIM_EFFORT,
+	NLIBS_SIM_POS_ERR_RMS,
+	NLIBS_SIM_TILT_MAX,
+	NLIBS_SIM_DIVERGED,
+	NLIBS_SIM_METRICS
+};
+
+extern const char *const nlibs_sim_metric_names[NLIBS_SIM_METRICS];
+
+struct nlibs_sim_config_s {
+	float duration;					/**< simulated time (s) */
+	float control_dt;				/**< control law period (s) */
+	unsigned substeps;				/**< plant steps per control period */
+	unsigned position_divider;		/**< control periods per local position update */
+
+	math::Vector<3> pos0;			/**< initial NED position, at rest */
+	float yaw0;						/**< initial yaw */
+	math::Vector<3> pos_sp;			/**< NED position setpoint */
+	float yaw_sp;					/**< yaw setpoint */
+
+	bool position_enabled;
+	bool altitude_enabled;
+
+	float settle_pos;				/**< position error band of the settle time (m) */
+	float settle_yaw;				/**< yaw error band of the settle time (rad) */
+};
+
+struct nlibs_sim_result_s {
+	uint64_t steps;					/**< control steps run */
+	float pos_err_rms;				/**< RMS of the position error over the run */
+	float pos_err_final;			/**< position error at the end of the run */
+	float yaw_err_final;			/**< yaw error at the end of the run */
+	float tilt_max;					/**< maximum tilt angle over the run */
+	float settle_time;				/**< time after which the errors stay in the settle bands, duration when they never do */
+	float overshoot;				/**< largest position excursion past the setpoint along the step (m) */
+	float effort;					/**< motor command travel per second, summed over the motors */
+	bool diverged;					/**< state went non finite or out of bounds, run stopped */
+};
+
+/**
+ * 10 s at 250 Hz, 4 plant steps per period, 1 m step on every axis from a hover at 5 m,
+ * settled within 5 cm and 0.05 rad.
+ */
+void	nlibs_sim_default_config(struct nlibs_sim_config_s &config);
+
+/**
+ * Settle time a run reports when its errors are not in the settle bands at
+ * the end, the simulated time rounded down to whole control steps.
+ */
+float	nlibs_sim_unsettled_time(const struct nlibs_sim_config_s &config);
+
+/**
+ * Run one closed loop simulation.
+ *
+ * @param params	controller parameters
+ * @param model		plant model, the q_* fields are used
+ * @param trace		when not null, the state and controls are written as CSV every control step
+ */
+void	nlibs_sim_run(const struct nlibs_sim_config_s &config, const struct nlibs_params_s &params,
+		      const struct nlibs_params_s &model, struct nlibs_sim_result_s &result, FILE *trace);
+
+/**
+ * The scenarios the tuning tools fly: the default position step, then a
+ * 1 rad yaw step holding position.
+ */
+void	nlibs_sim_default_scenarios(struct nlibs_sim_config_s scenarios[NLIBS_SIM_SCENARIOS], float duration);
+
+/**
+ * Run a set of scenarios and combine their results: worst settle time,
+ * overshoot, final errors and tilt, mean RMS error and effort, diverged
+ * when any of them did.
+ */
+void	nlibs_sim_run_scenarios(const struct nlibs_sim_config_s *scenarios, unsigned count,
+				const struct nlibs_params_s &params, const struct nlibs_params_s &model,
+				struct nlibs_sim_result_s &result);
+
+/**
+ * Result as the NLIBS_SIM_METRICS columns.
+ */
+void	nlibs_sim_metrics(const struct nlibs_sim_result_s &result, float metrics[NLIBS_SIM_METRICS]);
@@ -0,0 +1,167 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_simulate.cpp
+ * Closed loop simulation of the NLIBS control law on the plant model.
+ *
+ * Runs one position step and reports the tracking metrics and how much
+ * faster than real time the simulation ran. -p sets controller parameters,
+ * -q the parameters of the simulated vehicle, both by NLIBSC_* name, so
+ * that a controller tuned for one model can be flown on another.
+ *
+ * -d runs the position stages on every d-th control step only, as the local
+ * position arrives at a fraction of the attitude rate on the vehicle.
+ *
+ * usage: nlibs_simulate [-T duration_s] [-r rate_hz] [-s substeps] [-d divider] [-x x,y,z]
+ *                       [-p NAME=value,...] [-q NAME=value,...] [-o trace.csv]
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "nlibs_host.h"
+#include "nlibs_sim.h"
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-T duration_s] [-r rate_hz] [-s substeps] [-d divider] [-x x,y,z]\n"
+		"\t[-p NAME=value,...] [-q NAME=value,...] [-o trace.csv]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct nlibs_sim_config_s config;
+	struct nlibs_params_s params;
+	struct nlibs_params_s model;
+	const char *trace_path = nullptr;
+	int ch;
+
+	nlibs_sim_default_config(config);
+	nlibs_host_default_params(params);
+	nlibs_host_default_params(model);
+
+	while ((ch = getopt(argc, argv, "T:r:s:d:x:p:q:o:h")) != -1) {
+		switch (ch) {
+		case 'T':
+			config.duration = strtof(optarg, nullptr);
+			break;
+
+		case 'r':
+			config.control_dt = 1.0f / strtof(optarg, nullptr);
+			break;
+
+		case 's':
+			config.substeps = (unsigned)atoi(optarg);
+			break;
+
+		case 'd':
+			config.position_divider = (unsigned)atoi(optarg);
+			break;
+
+		case 'x':
+			if (sscanf(optarg, "%f,%f,%f", &config.pos_sp(0), &config.pos_sp(1), &config.pos_sp(2)) != 3) {
+				usage(argv[0]);
+				return 1;
+			}
+
+			break;
+
+		case 'p':
+			if (!nlibs_host_set_params(params, optarg)) {
+				fprintf(stderr, "invalid parameters: %s\n", optarg);
+				return 1;
+			}
+
+			break;
+
+		case 'q':
+			if (!nlibs_host_set_params(model, optarg)) {
+				fprintf(stderr, "invalid parameters: %s\n", optarg);
+				return 1;
+			}
+
+			break;
+
+		case 'o':
+			trace_path = optarg;
+			break;
+
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!(config.duration > 0.0f) || !(config.control_dt > 0.0f) || config.substeps == 0 || config.position_divider == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	FILE *trace = nullptr;
+
+	if (trace_path != nullptr) {
+		trace = fopen(trace_path, "w");
+
+		if (trace == nullptr) {
+			perror(trace_path);
+			return 1;
+		}
+	}
+
+	struct nlibs_sim_result_s result;
+
+	uint64_t t0 = nlibs_host_time_ns();
+	nlibs_sim_run(config, params, model, result, trace);
+	double wall = (double)(nlibs_host_time_ns() - t0) * 1e-9;
+	double simulated = (double)result.steps * (double)config.control_dt;
+
+	if (trace != nullptr) {
+		fclose(trace);
+	}
+
+	printf("steps %llu, pos err rms %.4f m, final %.4f m, yaw err final %.4f rad, tilt max %.3f rad%s\n",
+	       (unsigned long long)result.steps, (double)result.pos_err_rms, (double)result.pos_err_final,
+	       (double)result.yaw_err_final, (double)result.tilt_max, result.diverged ? ", DIVERGED" : "");
+	printf("settle time %.3f s, overshoot %.4f m, effort %.3f /s\n", (double)result.settle_time,
+	       (double)result.overshoot, (double)result.effort);
+	printf("%.1f s simulated in %.3f s (%.0fx real time)\n", simulated, wall, (wall > 0.0) ? simulated / wall : 0.0);
+
+	return result.diverged ? 2 : 0;
+}
@@ -0,0 +1,550 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_sweep.cpp
+ * Parallel sweep of the NLIBS gains over closed loop simulations.
+ *
+ * Every combination of a grid of NLIBSC_* values flies a set of scenarios
+ * on the plant model, the combinations being spread over all cores by the
+ * work stealing pool. Each combination gives one row of a columnar result
+ * directory: its gains, the worst settle time and overshoot over the
+ * scenarios, the mean actuator effort, and whether a scenario diverged.
+ * Rows are streamed as they complete, a sweep interrupted by a signal or a
+ * crash is resumed by running the same command again.
+ *
+ * The rows are ranked by a weighted sum of settle time, overshoot and
+ * effort, each normalized by its median over the combinations which did
+ * not diverge. -r ranks an existing result directory without simulating.
+ *
+ * usage: nlibs_sweep -o dir -g NAME=min:max:count[:log] [-g ...] [-p NAME=value,...]
+ *                    [-q NAME=value,...] [-T duration_s] [-j threads] [-k top] [-w ws,wo,we]
+ *        nlibs_sweep -r dir [-k top] [-w ws,wo,we]
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nlibs_columns.h"
+#include "nlibs_host.h"
+#include "nlibs_pool.h"
+#include "nlibs_sim.h"
+
+#define SWEEP_MAX_AXES		32
+#define SWEEP_FLUSH_ROWS	64
+#define SWEEP_MAX_WORKERS	256
+
+struct sweep_axis_s {
+	char name[48];
+	float min;
+	float max;
+	unsigned count;
+	bool log;
+};
+
+struct sweep_buffer_s {
+	uint64_t index[SWEEP_FLUSH_ROWS];
+	float values[SWEEP_FLUSH_ROWS * (SWEEP_MAX_AXES + NLIBS_SIM_METRICS)];
+	unsigned rows;
+} __attribute__((aligned(64)));
+
+struct sweep_s {
+	struct sweep_axis_s axes[SWEEP_MAX_AXES];
+	unsigned naxes;
+	uint64_t total;
+
+	struct nlibs_params_s params;
+	struct nlibs_params_s model;
+	float duration;
+	struct nlibs_sim_config_s scenarios[NLIBS_SIM_SCENARIOS];
+
+	uint8_t *done;					/**< rows already in the result directory */
+	uint64_t completed;
+	uint64_t t_start;
+	uint64_t t_report;
+
+	NLIBSColumns out;
+	pthread_mutex_t out_lock;
+	bool out_error;
+
+	struct sweep_buffer_s *buffers;
+};
+
+static volatile bool g_stop = false;
+
+static void sweep_signal(int)
+{
+	g_stop = true;
+}
+
+static bool parse_axis(const char *arg, struct sweep_axis_s &axis)
+{
+	const char *eq = strchr(arg, '=');
+
+	if (eq == nullptr || eq == arg || (size_t)(eq - arg) >= sizeof(axis.name)) {
+		return false;
+	}
+
+	memcpy(axis.name, arg, (size_t)(eq - arg));
+	axis.name[eq - arg] = '\0';
+
+	char scale[8] = "";
+	int n = sscanf(eq + 1, "%f:%f:%u:%7s", &axis.min, &axis.max, &axis.count, scale);
+
+	if (n < 3 || axis.count == 0) {
+		return false;
+	}
+
+	axis.log = (strcmp(scale, "log") == 0);
+
+	if (n == 4 && !axis.log && strcmp(scale, "lin") != 0) {
+		return false;
+	}
+
+	return !axis.log || (axis.min > 0.0f && axis.max > 0.0f);
+}
+
+static float axis_value(const struct sweep_axis_s &axis, unsigned i)
+{
+	if (axis.count == 1) {
+		return axis.min;
+	}
+
+	float t = (float)i / (float)(axis.count - 1);
+
+	if (axis.log) {
+		return axis.min * powf(axis.max / axis.min, t);
+	}
+
+	return axis.min + (axis.max - axis.min) * t;
+}
+
+/**
+ * Gains of a combination, the first axis varies fastest.
+ */
+static void combination(const struct sweep_s &sweep, uint64_t index, float *gains)
+{
+	for (unsigned a = 0; a < sweep.naxes; a++) {
+		const struct sweep_axis_s &axis = sweep.axes[a];
+		gains[a] = axis_value(axis, (unsigned)(index % axis.count));
+		index /= axis.count;
+	}
+}
+
+static void sweep_flush(struct sweep_s &sweep, struct sweep_buffer_s &buf)
+{
+	if (buf.rows == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&sweep.out_lock);
+
+	if (!sweep.out.append(buf.index, buf.values, buf.rows)) {
+		sweep.out_error = true;
+		g_stop = true;
+	}
+
+	pthread_mutex_unlock(&sweep.out_lock);
+
+	buf.rows = 0;
+}
+
+static void sweep_job(uint64_t index, unsigned worker, void *arg)
+{
+	struct sweep_s &sweep = *(struct sweep_s *)arg;
+
+	if (sweep.done[index]) {
+		return;
+	}
+
+	struct sweep_buffer_s &buf = sweep.buffers[worker];
+	const unsigned ncols = sweep.naxes + NLIBS_SIM_METRICS;
+	float *row = &buf.values[buf.rows * ncols];
+
+	struct nlibs_params_s params = sweep.params;
+	combination(sweep, index, row);
+
+	for (unsigned a = 0; a < sweep.naxes; a++) {
+		nlibs_host_set_param(params, sweep.axes[a].name, row[a]);
+	}
+
+	struct nlibs_sim_result_s res;
+	nlibs_sim_run_scenarios(sweep.scenarios, NLIBS_SIM_SCENARIOS, params, sweep.model, res);
+	nlibs_sim_metrics(res, &row[sweep.naxes]);
+
+	buf.index[buf.rows++] = index;
+
+	if (buf.rows == SWEEP_FLUSH_ROWS) {
+		sweep_flush(sweep, buf);
+	}
+
+	uint64_t completed = __atomic_add_fetch(&sweep.completed, 1, __ATOMIC_RELAXED);
+
+	/* progress from one worker only */
+	if (worker == 0) {
+		uint64_t now = nlibs_host_time_ns();
+
+		if (now - sweep.t_report > 1000000000ULL) {
+			sweep.t_report = now;
+			double rate = (double)completed / ((double)(now - sweep.t_start) * 1e-9);
+			fprintf(stderr, "%llu / %llu combinations, %.0f /s\n", (unsigned long long)completed,
+				(unsigned long long)sweep.total, rate);
+		}
+	}
+}
+
+struct rank_s {
+	double score;
+	uint64_t row;
+};
+
+static int rank_compare(const void *a, const void *b)
+{
+	double sa = ((const struct rank_s *)a)->score;
+	double sb = ((const struct rank_s *)b)->score;
+
+	return (sa < sb) ? -1 : ((sa > sb) ? 1 : 0);
+}
+
+static int float_compare(const void *a, const void *b)
+{
+	float fa = *(const float *)a;
+	float fb = *(const float *)b;
+
+	return (fa < fb) ? -1 : ((fa > fb) ? 1 : 0);
+}
+
+/**
+ * Print the best rows of a result directory.
+ */
+static int rank(const char *dir, unsigned top, const float weights[3])
+{
+	NLIBSColumns res;
+
+	if (!res.load(dir)) {
+		fprintf(stderr, "%s: no sweep results\n", dir);
+		return 1;
+	}
+
+	int cols[NLIBS_SIM_METRICS];
+
+	for (unsigned k = 0; k < NLIBS_SIM_METRICS; k++) {
+		cols[k] = res.find(nlibs_sim_metric_names[k]);
+
+		if (cols[k] < 0) {
+			fprintf(stderr, "%s: no %s column\n", dir, nlibs_sim_metric_names[k]);
+			return 1;
+		}
+	}
+
+	const uint64_t rows = res.rows();
+	const float *diverged = res.column((unsigned)cols[NLIBS_SIM_DIVERGED]);
+
+	struct rank_s *ranks = (struct rank_s *)malloc((rows + 1) * sizeof(struct rank_s));
+	float *sorted = (float *)malloc((rows + 1) * sizeof(float));
+
+	if (ranks == nullptr || sorted == nullptr) {
+		free(ranks);
+		free(sorted);
+		return 1;
+	}
+
+	uint64_t valid = 0;
+
+	for (uint64_t r = 0; r < rows; r++) {
+		if (diverged[r] < 0.5f) {
+			ranks[valid].row = r;
+			ranks[valid].score = 0.0;
+			valid++;
+		}
+	}
+
+	/* each metric counts relative to its median over the combinations which did not diverge */
+	for (unsigned k = 0; k < 3 && valid > 0; k++) {
+		const float *v = res.column((unsigned)cols[k]);
+
+		for (uint64_t i = 0; i < valid; i++) {
+			sorted[i] = v[ranks[i].row];
+		}
+
+		qsort(sorted, valid, sizeof(float), float_compare);
+		double median = (double)sorted[valid / 2];
+
+		if (!(median > 0.0)) {
+			median = 1.0;
+		}
+
+		for (uint64_t i = 0; i < valid; i++) {
+			ranks[i].score += (double)weights[k] * (double)v[ranks[i].row] / median;
+		}
+	}
+
+	qsort(ranks, valid, sizeof(struct rank_s), rank_compare);
+
+	printf("%llu combinations, %llu diverged\n", (unsigned long long)rows, (unsigned long long)(rows - valid));
+	printf("rank score");
+
+	for (unsigned c = 0; c < res.columns(); c++) {
+		if ((int)c != cols[NLIBS_SIM_DIVERGED]) {
+			printf(" %s", res.name(c));
+		}
+	}
+
+	printf("\n");
+
+	for (uint64_t i = 0; i < valid && i < top; i++) {
+		printf("%llu %.4f", (unsigned long long)(i + 1), ranks[i].score);
+
+		for (unsigned c = 0; c < res.columns(); c++) {
+			if ((int)c != cols[NLIBS_SIM_DIVERGED]) {
+				printf(" %g", (double)res.column(c)[ranks[i].row]);
+			}
+		}
+
+		printf("\n");
+	}
+
+	free(ranks);
+	free(sorted);
+
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s -o dir -g NAME=min:max:count[:log] [-g ...] [-p NAME=value,...]\n"
+		"\t[-q NAME=value,...] [-T duration_s] [-j threads] [-k top] [-w ws,wo,we]\n"
+		"       %s -r dir [-k top] [-w ws,wo,we]\n", name, name);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct sweep_s sweep;
+	const char *out_dir = nullptr;
+	const char *rank_dir = nullptr;
+	const char *params_arg = "";
+	const char *model_arg = "";
+	unsigned threads = 0;
+	unsigned top = 10;
+	float weights[3] = { 1.0f, 1.0f, 1.0f };
+	int ch;
+
+	nlibs_host_default_params(sweep.params);
+	nlibs_host_default_params(sweep.model);
+	sweep.duration = 10.0f;
+
+	while ((ch = getopt(argc, argv, "o:r:g:p:q:T:j:k:w:h")) != -1) {
+		switch (ch) {
+		case 'o':
+			out_dir = optarg;
+			break;
+
+		case 'r':
+			rank_dir = optarg;
+			break;
+
+		case 'g':
+			if (sweep.naxes == SWEEP_MAX_AXES || !parse_axis(optarg, sweep.axes[sweep.naxes])) {
+				fprintf(stderr, "invalid grid: %s\n", optarg);
+				return 1;
+			}
+
+			sweep.naxes++;
+			break;
+
+		case 'p':
+			params_arg = optarg;
+
+			if (!nlibs_host_set_params(sweep.params, optarg)) {
+				fprintf(stderr, "invalid parameters: %s\n", optarg);
+				return 1;
+			}
+
+			break;
+
+		case 'q':
+			model_arg = optarg;
+
+			if (!nlibs_host_set_params(sweep.model, optarg)) {
+				fprintf(stderr, "invalid parameters: %s\n", optarg);
+				return 1;
+			}
+
+			break;
+
+		case 'T':
+			sweep.duration = strtof(optarg, nullptr);
+			break;
+
+		case 'j':
+			threads = (unsigned)atoi(optarg);
+			break;
+
+		case 'k':
+			top = (unsigned)atoi(optarg);
+			break;
+
+		case 'w':
+			if (sscanf(optarg, "%f,%f,%f", &weights[0], &weights[1], &weights[2]) != 3) {
+				usage(argv[0]);
+				return 1;
+			}
+
+			break;
+
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (rank_dir != nullptr) {
+		return rank(rank_dir, top, weights);
+	}
+
+	if (out_dir == nullptr || sweep.naxes == 0 || !(sweep.duration > 0.0f)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	struct nlibs_params_s check = sweep.params;
+	sweep.total = 1;
+	nlibs_sim_default_scenarios(sweep.scenarios, sweep.duration);
+
+	for (unsigned a = 0; a < sweep.naxes; a++) {
+		if (!nlibs_host_set_param(check, sweep.axes[a].name, 0.0f)) {
+			fprintf(stderr, "unknown parameter: %s\n", sweep.axes[a].name);
+			return 1;
+		}
+
+		sweep.total *= sweep.axes[a].count;
+	}
+
+	/* the header pins everything a resumed sweep has to share with the first run */
+	char header[4096];
+	int n = snprintf(header, sizeof(header), "nlibs_sweep\nduration %g\nparams %s\nmodel %s",
+			 (double)sweep.duration, params_arg, model_arg);
+
+	for (unsigned a = 0; a < sweep.naxes && n < (int)sizeof(header); a++) {
+		const struct sweep_axis_s &axis = sweep.axes[a];
+		n += snprintf(header + n, sizeof(header) - (size_t)n, "\ngrid %s %g %g %u %s", axis.name,
+			      (double)axis.min, (double)axis.max, axis.count, axis.log ? "log" : "lin");
+	}
+
+	const char *names[SWEEP_MAX_AXES + NLIBS_SIM_METRICS];
+
+	for (unsigned a = 0; a < sweep.naxes; a++) {
+		names[a] = sweep.axes[a].name;
+	}
+
+	for (unsigned k = 0; k < NLIBS_SIM_METRICS; k++) {
+		names[sweep.naxes + k] = nlibs_sim_metric_names[k];
+	}
+
+	if (!sweep.out.open(out_dir, header, names, sweep.naxes + NLIBS_SIM_METRICS)) {
+		fprintf(stderr, "%s: cannot open, or holds a different sweep\n", out_dir);
+		return 1;
+	}
+
+	sweep.done = (uint8_t *)calloc(sweep.total, 1);
+
+	if (threads == 0) {
+		threads = nlibs_pool_default_threads();
+	}
+
+	if (threads > SWEEP_MAX_WORKERS) {
+		threads = SWEEP_MAX_WORKERS;
+	}
+
+	sweep.buffers = (struct sweep_buffer_s *)calloc(threads, sizeof(struct sweep_buffer_s));
+
+	if (sweep.done == nullptr || sweep.buffers == nullptr) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	/* skip what a previous run already wrote */
+	uint64_t resumed = 0;
+
+	for (uint64_t r = 0; r < sweep.out.rows(); r++) {
+		uint64_t index = sweep.out.index()[r];
+
+		if (index < sweep.total && !sweep.done[index]) {
+			sweep.done[index] = 1;
+			resumed++;
+		}
+	}
+
+	if (resumed > 0) {
+		fprintf(stderr, "resuming, %llu of %llu combinations done\n", (unsigned long long)resumed,
+			(unsigned long long)sweep.total);
+	}
+
+	pthread_mutex_init(&sweep.out_lock, nullptr);
+	signal(SIGINT, sweep_signal);
+	signal(SIGTERM, sweep_signal);
+
+	sweep.completed = resumed;
+	sweep.t_start = nlibs_host_time_ns();
+	sweep.t_report = sweep.t_start;
+
+	nlibs_pool_run(sweep.total, threads, sweep_job, &sweep, &g_stop);
+
+	for (unsigned i = 0; i < threads; i++) {
+		sweep_flush(sweep, sweep.buffers[i]);
+	}
+
+	double wall = (double)(nlibs_host_time_ns() - sweep.t_start) * 1e-9;
+	uint64_t rows = sweep.out.rows();
+	sweep.out.close();
+
+	fprintf(stderr, "%llu of %llu combinations in %s, %.1f s on %u threads%s\n", (unsigned long long)rows,
+		(unsigned long long)sweep.total, out_dir, wall, threads,
+		sweep.out_error ? ", WRITE ERROR" : (g_stop ? ", interrupted" : ""));
+
+	if (sweep.out_error) {
+		return 1;
+	}
+
+	return rank(out_dir, top, weights);
+}
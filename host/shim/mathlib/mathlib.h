@@ -0,0 +1,460 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mathlib.h
+ * Host shim of the PX4 math library, the parts the NLIBS code uses.
+ *
+ * Same interface and element order as src/lib/mathlib, written for clarity
+ * rather than speed. Results match the target to rounding, not bit for bit.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <math.h>
+
+namespace math
+{
+
+template <unsigned int N>
+class Vector
+{
+public:
+	float data[N];
+
+	Vector()
+	{
+		zero();
+	}
+
+	float &operator()(const unsigned int i)
+	{
+		return data[i];
+	}
+
+	float operator()(const unsigned int i) const
+	{
+		return data[i];
+	}
+
+	void zero()
+	{
+		for (unsigned int i = 0; i < N; i++) {
+			data[i] = 0.0f;
+		}
+	}
+
+	const Vector<N> operator+(const Vector<N> &v) const
+	{
+		Vector<N> res;
+
+		for (unsigned int i = 0; i < N; i++) {
+			res.data[i] = data[i] + v.data[i];
+		}
+
+		return res;
+	}
+
+	const Vector<N> operator-(const Vector<N> &v) const
+	{
+		Vector<N> res;
+
+		for (unsigned int i = 0; i < N; i++) {
+			res.data[i] = data[i] - v.data[i];
+		}
+
+		return res;
+	}
+
+	const Vector<N> operator-() const
+	{
+		Vector<N> res;
+
+		for (unsigned int i = 0; i < N; i++) {
+			res.data[i] = -data[i];
+		}
+
+		return res;
+	}
+
+	const Vector<N> operator*(const float num) const
+	{
+		Vector<N> res;
+
+		for (unsigned int i = 0; i < N; i++) {
+			res.data[i] = data[i] * num;
+		}
+
+		return res;
+	}
+
+	const Vector<N> operator/(const float num) const
+	{
+		Vector<N> res;
+
+		for (unsigned int i = 0; i < N; i++) {
+			res.data[i] = data[i] / num;
+		}
+
+		return res;
+	}
+
+	/**
+	 * dot product
+	 */
+	float operator*(const Vector<N> &v) const
+	{
+		float res = 0.0f;
+
+		for (unsigned int i = 0; i < N; i++) {
+			res += data[i] * v.data[i];
+		}
+
+		return res;
+	}
+
+	const Vector<N> &operator+=(const Vector<N> &v)
+	{
+		for (unsigned int i = 0; i < N; i++) {
+			data[i] += v.data[i];
+		}
+
+		return *this;
+	}
+
+	const Vector<N> &operator-=(const Vector<N> &v)
+	{
+		for (unsigned int i = 0; i < N; i++) {
+			data[i] -= v.data[i];
+		}
+
+		return *this;
+	}
+
+	const Vector<N> emult(const Vector<N> &v) const
+	{
+		Vector<N> res;
+
+		for (unsigned int i = 0; i < N; i++) {
+			res.data[i] = data[i] * v.data[i];
+		}
+
+		return res;
+	}
+
+	float length() const
+	{
+		return sqrtf(*this * *this);
+	}
+};
+
+template <unsigned int M, unsigned int N>
+class Matrix
+{
+public:
+	float data[M][N];
+
+	Matrix()
+	{
+		zero();
+	}
+
+	Matrix(const float d[M][N])
+	{
+		set(d);
+	}
+
+	void set(const float d[M][N])
+	{
+		for (unsigned int i = 0; i < M; i++) {
+			for (unsigned int j = 0; j < N; j++) {
+				data[i][j] = d[i][j];
+			}
+		}
+	}
+
+	float &operator()(const unsigned int row, const unsigned int col)
+	{
+		return data[row][col];
+	}
+
+	float operator()(const unsigned int row, const unsigned int col) const
+	{
+		return data[row][col];
+	}
+
+	void zero()
+	{
+		for (unsigned int i = 0; i < M; i++) {
+			for (unsigned int j = 0; j < N; j++) {
+				data[i][j] = 0.0f;
+			}
+		}
+	}
+
+	void identity()
+	{
+		zero();
+
+		for (unsigned int i = 0; i < M && i < N; i++) {
+			data[i][i] = 1.0f;
+		}
+	}
+
+	const Vector<M> operator*(const Vector<N> &v) const
+	{
+		Vector<M> res;
+
+		for (unsigned int i = 0; i < M; i++) {
+			for (unsigned int j = 0; j < N; j++) {
+				res.data[i] += data[i][j] * v.data[j];
+			}
+		}
+
+		return res;
+	}
+
+	template <unsigned int P>
+	const Matrix<M, P> operator*(const Matrix<N, P> &m) const
+	{
+		Matrix<M, P> res;
+
+		for (unsigned int i = 0; i < M; i++) {
+			for (unsigned int j = 0; j < P; j++) {
+				for (unsigned int k = 0; k < N; k++) {
+					res.data[i][j] += data[i][k] * m.data[k][j];
+				}
+			}
+		}
+
+		return res;
+	}
+
+	const Matrix<M, N> operator*(const float num) const
+	{
+		Matrix<M, N> res;
+
+		for (unsigned int i = 0; i < M; i++) {
+			for (unsigned int j = 0; j < N; j++) {
+				res.data[i][j] = data[i][j] * num;
+			}
+		}
+
+		return res;
+	}
+
+	const Matrix<M, N> operator/(const float num) const
+	{
+		return *this * (1.0f / num);
+	}
+
+	const Matrix<M, N> operator+(const Matrix<M, N> &m) const
+	{
+		Matrix<M, N> res;
+
+		for (unsigned int i = 0; i < M; i++) {
+			for (unsigned int j = 0; j < N; j++) {
+				res.data[i][j] = data[i][j] + m.data[i][j];
+			}
+		}
+
+		return res;
+	}
+
+	const Matrix<M, N> operator-(const Matrix<M, N> &m) const
+	{
+		Matrix<M, N> res;
+
+		for (unsigned int i = 0; i < M; i++) {
+			for (unsigned int j = 0; j < N; j++) {
+				res.data[i][j] = data[i][j] - m.data[i][j];
+			}
+		}
+
+		return res;
+	}
+
+	const Matrix<N, M> transposed() const
+	{
+		Matrix<N, M> res;
+
+		for (unsigned int i = 0; i < M; i++) {
+			for (unsigned int j = 0; j < N; j++) {
+				res.data[j][i] = data[i][j];
+			}
+		}
+
+		return res;
+	}
+
+	/**
+	 * Gauss-Jordan inverse with partial pivoting, square matrices only.
+	 */
+	const Matrix<M, N> inversed() const
+	{
+		Matrix<M, N> a = *this;
+		Matrix<M, N> res;
+		res.identity();
+
+		for (unsigned int c = 0; c < N; c++) {
+			unsigned int p = c;
+
+			for (unsigned int i = c + 1; i < M; i++) {
+				if (fabsf(a.data[i][c]) > fabsf(a.data[p][c])) {
+					p = i;
+				}
+			}
+
+			for (unsigned int j = 0; j < N; j++) {
+				float t = a.data[c][j];
+				a.data[c][j] = a.data[p][j];
+				a.data[p][j] = t;
+				t = res.data[c][j];
+				res.data[c][j] = res.data[p][j];
+				res.data[p][j] = t;
+			}
+
+			float d = a.data[c][c];
+
+			for (unsigned int j = 0; j < N; j++) {
+				a.data[c][j] /= d;
+				res.data[c][j] /= d;
+			}
+
+			for (unsigned int i = 0; i < M; i++) {
+				if (i != c) {
+					float f = a.data[i][c];
+
+					for (unsigned int j = 0; j < N; j++) {
+						a.data[i][j] -= f * a.data[c][j];
+						res.data[i][j] -= f * res.data[c][j];
+					}
+				}
+			}
+		}
+
+		return res;
+	}
+
+	/**
+	 * Rotation matrix from 321 euler angles.
+	 */
+	void from_euler(float roll, float pitch, float yaw)
+	{
+		float cp = cosf(pitch);
+		float sp = sinf(pitch);
+		float sr = sinf(roll);
+		float cr = cosf(roll);
+		float sy = sinf(yaw);
+		float cy = cosf(yaw);
+
+		data[0][0] = cp * cy;
+		data[0][1] = (sr * sp * cy) - (cr * sy);
+		data[0][2] = (cr * sp * cy) + (sr * sy);
+		data[1][0] = cp * sy;
+		data[1][1] = (sr * sp * sy) + (cr * cy);
+		data[1][2] = (cr * sp * sy) - (sr * cy);
+		data[2][0] = -sp;
+		data[2][1] = sr * cp;
+		data[2][2] = cr * cp;
+	}
+};
+
+class Quaternion : public Vector<4>
+{
+public:
+	Quaternion()
+	{
+	}
+
+	Quaternion(const float *q)
+	{
+		for (unsigned int i = 0; i < 4; i++) {
+			data[i] = q[i];
+		}
+	}
+
+	const Matrix<3, 3> to_dcm() const
+	{
+		Matrix<3, 3> dcm;
+		float aSq = data[0] * data[0];
+		float bSq = data[1] * data[1];
+		float cSq = data[2] * data[2];
+		float dSq = data[3] * data[3];
+		dcm.data[0][0] = aSq + bSq - cSq - dSq;
+		dcm.data[0][1] = 2.0f * (data[1] * data[2] - data[0] * data[3]);
+		dcm.data[0][2] = 2.0f * (data[0] * data[2] + data[1] * data[3]);
+		dcm.data[1][0] = 2.0f * (data[1] * data[2] + data[0] * data[3]);
+		dcm.data[1][1] = aSq - bSq + cSq - dSq;
+		dcm.data[1][2] = 2.0f * (data[2] * data[3] - data[0] * data[1]);
+		dcm.data[2][0] = 2.0f * (data[1] * data[3] - data[0] * data[2]);
+		dcm.data[2][1] = 2.0f * (data[0] * data[1] + data[2] * data[3]);
+		dcm.data[2][2] = aSq - bSq - cSq + dSq;
+		return dcm;
+	}
+};
+
+template <typename T>
+T constrain(T val, T min_val, T max_val)
+{
+	return (val < min_val) ? min_val : ((val > max_val) ? max_val : val);
+}
+
+template <typename T>
+T min(T val1, T val2)
+{
+	return (val1 < val2) ? val1 : val2;
+}
+
+template <typename T>
+T max(T val1, T val2)
+{
+	return (val1 > val2) ? val1 : val2;
+}
+
+static inline float radians(float degrees)
+{
+	return (degrees / 180.0f) * 3.14159265f;
+}
+
+static inline float degrees(float radians)
+{
+	return (radians * 180.0f) / 3.14159265f;
+}
+
+}
@@ -0,0 +1,184 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file wqueue.cpp
+ * Host implementation of the work queue shim.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/config.h>
+#include <nuttx/wqueue.h>
+
+#define WORK_QUEUES		2
+
+/**
+ * One queue, served by its own thread, items sorted by due time.
+ */
+struct work_queue_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;		/**< signalled when the head of the queue changes */
+	pthread_once_t once;
+	struct work_s *head;
+};
+
+static struct work_queue_s work_queues[WORK_QUEUES] = {
+	{ PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_ONCE_INIT, nullptr },
+	{ PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_ONCE_INIT, nullptr }
+};
+
+/* called with the queue lock held */
+static void work_remove(struct work_queue_s *wq, struct work_s *work)
+{
+	for (struct work_s **p = &wq->head; *p != nullptr; p = &(*p)->next) {
+		if (*p == work) {
+			*p = work->next;
+			work->next = nullptr;
+			work->queued = false;
+			return;
+		}
+	}
+}
+
+static void *work_thread(void *arg)
+{
+	struct work_queue_s *wq = (struct work_queue_s *)arg;
+
+	pthread_mutex_lock(&wq->lock);
+
+	for (;;) {
+		if (wq->head == nullptr) {
+			pthread_cond_wait(&wq->cond, &wq->lock);
+			continue;
+		}
+
+		hrt_abstime now = hrt_absolute_time();
+
+		if (wq->head->due > now) {
+			/* hrt and CLOCK_MONOTONIC share their origin */
+			struct timespec ts;
+			ts.tv_sec = wq->head->due / 1000000;
+			ts.tv_nsec = (wq->head->due % 1000000) * 1000;
+			pthread_cond_timedwait(&wq->cond, &wq->lock, &ts);
+			continue;
+		}
+
+		struct work_s *work = wq->head;
+		worker_t worker = work->worker;
+		void *worker_arg = work->arg;
+		work_remove(wq, work);
+		work->worker = nullptr;
+
+		pthread_mutex_unlock(&wq->lock);
+		worker(worker_arg);
+		pthread_mutex_lock(&wq->lock);
+	}
+
+	return nullptr;
+}
+
+static void work_start_hp()
+{
+	pthread_t thread;
+	pthread_create(&thread, nullptr, work_thread, &work_queues[HPWORK]);
+	pthread_detach(thread);
+}
+
+static void work_start_lp()
+{
+	pthread_t thread;
+	pthread_create(&thread, nullptr, work_thread, &work_queues[LPWORK]);
+	pthread_detach(thread);
+}
+
+int work_queue(int qid, struct work_s *work, worker_t worker, void *arg, uint32_t delay)
+{
+	if (qid < 0 || qid >= WORK_QUEUES) {
+		return -EINVAL;
+	}
+
+	struct work_queue_s *wq = &work_queues[qid];
+	pthread_once(&wq->once, qid == HPWORK ? work_start_hp : work_start_lp);
+
+	pthread_mutex_lock(&wq->lock);
+
+	if (work->queued) {
+		work_remove(wq, work);
+	}
+
+	work->worker = worker;
+	work->arg = arg;
+	work->due = hrt_absolute_time() + (hrt_abstime)delay * USEC_PER_TICK;
+
+	struct work_s **p = &wq->head;
+
+	while (*p != nullptr && (*p)->due <= work->due) {
+		p = &(*p)->next;
+	}
+
+	work->next = *p;
+	*p = work;
+	work->queued = true;
+
+	pthread_cond_signal(&wq->cond);
+	pthread_mutex_unlock(&wq->lock);
+	return OK;
+}
+
+int work_cancel(int qid, struct work_s *work)
+{
+	if (qid < 0 || qid >= WORK_QUEUES) {
+		return -EINVAL;
+	}
+
+	struct work_queue_s *wq = &work_queues[qid];
+
+	pthread_mutex_lock(&wq->lock);
+
+	if (work->queued) {
+		work_remove(wq, work);
+		work->worker = nullptr;
+	}
+
+	pthread_mutex_unlock(&wq->lock);
+	return OK;
+}
@@ -0,0 +1,84 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file wqueue.h
+ * Host shim of the NuttX work queues.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <drivers/drv_hrt.h>
+
+#define HPWORK		0		/**< high priority work queue */
+#define LPWORK		1		/**< low priority work queue */
+
+typedef void (*worker_t)(void *arg);
+
+/**
+ * Work item, owned by the caller and zeroed before its first use.
+ */
+struct work_s {
+	struct work_s *next;		/**< next queued item */
+	worker_t worker;			/**< callback, NULL once started */
+	void *arg;					/**< callback argument */
+	hrt_abstime due;			/**< time the item runs at */
+	bool queued;				/**< item is in a queue */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Queue an item to run once after a delay, on the worker thread of the queue.
+ * A queued item is moved to its new time.
+ *
+ * @param delay		delay in system ticks, see USEC2TICK()
+ */
+int	work_queue(int qid, struct work_s *work, worker_t worker, void *arg, uint32_t delay);
+
+/**
+ * Remove a queued item. An item already running is not waited for.
+ */
+int	work_cancel(int qid, struct work_s *work);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,146 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file param.cpp
+ * Host implementation of the parameter store shim.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drivers/drv_hrt.h>
+#include <systemlib/param/param.h>
+#include <uORB/uORB.h>
+#include <uORB/topics/parameter_update.h>
+
+/* bounds of the __param section, weak so that tools without parameters link */
+extern "C" const struct param_info_s __start___param[] __attribute__((weak));
+extern "C" const struct param_info_s __stop___param[] __attribute__((weak));
+
+static pthread_mutex_t param_lock = PTHREAD_MUTEX_INITIALIZER;
+static union param_value_u *param_values = nullptr;		/**< current values, defaults until set */
+static orb_advert_t param_update_pub = -1;
+
+static unsigned param_count()
+{
+	return __start___param == nullptr ? 0 : (unsigned)(__stop___param - __start___param);
+}
+
+/* called with param_lock held */
+static bool param_init()
+{
+	if (param_values == nullptr) {
+		unsigned count = param_count();
+		param_values = (union param_value_u *)calloc(count > 0 ? count : 1, sizeof(*param_values));
+
+		if (param_values == nullptr) {
+			return false;
+		}
+
+		for (unsigned i = 0; i < count; i++) {
+			param_values[i] = __start___param[i].val;
+		}
+	}
+
+	return true;
+}
+
+param_t param_find(const char *name)
+{
+	for (unsigned i = 0; i < param_count(); i++) {
+		if (strcmp(__start___param[i].name, name) == 0) {
+			return i;
+		}
+	}
+
+	return PARAM_INVALID;
+}
+
+int param_get(param_t param, void *val)
+{
+	if (param >= param_count()) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&param_lock);
+
+	if (!param_init()) {
+		pthread_mutex_unlock(&param_lock);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	memcpy(val, &param_values[param], sizeof(param_values[param]));
+	pthread_mutex_unlock(&param_lock);
+	return 0;
+}
+
+int param_set(param_t param, const void *val)
+{
+	if (param >= param_count()) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&param_lock);
+
+	if (!param_init()) {
+		pthread_mutex_unlock(&param_lock);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	memcpy(&param_values[param], val, sizeof(param_values[param]));
+
+	struct parameter_update_s update;
+	update.timestamp = hrt_absolute_time();
+
+	if (param_update_pub > 0) {
+		orb_publish(ORB_ID(parameter_update), param_update_pub, &update);
+
+	} else {
+		param_update_pub = orb_advertise(ORB_ID(parameter_update), &update);
+	}
+
+	pthread_mutex_unlock(&param_lock);
+	return 0;
+}
@@ -0,0 +1,104 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file param.h
+ * Host shim of the PX4 parameter store.
+ *
+ * PARAM_DEFINE_* places every definition in one linker section, as on the
+ * target, so that mc_nlibs_params.c builds unchanged.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uintptr_t param_t;
+
+#define PARAM_INVALID	((uintptr_t)0xffffffff)
+
+typedef enum param_type_e {
+	PARAM_TYPE_INT32,
+	PARAM_TYPE_FLOAT
+} param_type_t;
+
+union param_value_u {
+	int32_t i;
+	float f;
+};
+
+/**
+ * Parameter definition, placed in the __param section by PARAM_DEFINE_*.
+ */
+struct param_info_s {
+	const char *name;
+	param_type_t type;
+	union param_value_u val;		/**< default value */
+};
+
+#define PARAM_DEFINE_INT32(_name, _default) \
+	static const __attribute__((used, section("__param"))) struct param_info_s __param__##_name = \
+	{ #_name, PARAM_TYPE_INT32, { .i = _default } }
+
+#define PARAM_DEFINE_FLOAT(_name, _default) \
+	static const __attribute__((used, section("__param"))) struct param_info_s __param__##_name = \
+	{ #_name, PARAM_TYPE_FLOAT, { .f = _default } }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @return		handle of a parameter, PARAM_INVALID if it is not defined.
+ */
+param_t	param_find(const char *name);
+
+/**
+ * Copy the current value, 4 bytes.
+ */
+int		param_get(param_t param, void *val);
+
+/**
+ * Change the value and publish parameter_update, as on the target.
+ */
+int		param_set(param_t param, const void *val);
+
+#ifdef __cplusplus
+}
+#endif
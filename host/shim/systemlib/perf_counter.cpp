@@ -0,0 +1,183 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file perf_counter.cpp
+ * Host implementation of the performance counter shim.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <drivers/drv_hrt.h>
+#include <systemlib/perf_counter.h>
+
+struct perf_ctr_header {
+	enum perf_counter_type type;
+	const char *name;
+	uint64_t event_count;
+	hrt_abstime time_start;		/**< start of the running event, or last interval event */
+	uint64_t time_total;
+	uint64_t time_least;
+	uint64_t time_most;
+};
+
+perf_counter_t perf_alloc(enum perf_counter_type type, const char *name)
+{
+	perf_counter_t handle = (perf_counter_t)calloc(1, sizeof(struct perf_ctr_header));
+
+	if (handle != nullptr) {
+		handle->type = type;
+		handle->name = name;
+		handle->time_least = UINT64_MAX;
+	}
+
+	return handle;
+}
+
+void perf_free(perf_counter_t handle)
+{
+	free(handle);
+}
+
+void perf_count(perf_counter_t handle)
+{
+	if (handle == nullptr) {
+		return;
+	}
+
+	if (handle->type == PC_INTERVAL) {
+		hrt_abstime now = hrt_absolute_time();
+
+		if (handle->event_count > 0) {
+			uint64_t interval = now - handle->time_start;
+			handle->time_total += interval;
+
+			if (interval < handle->time_least) {
+				handle->time_least = interval;
+			}
+
+			if (interval > handle->time_most) {
+				handle->time_most = interval;
+			}
+		}
+
+		handle->time_start = now;
+	}
+
+	handle->event_count++;
+}
+
+void perf_begin(perf_counter_t handle)
+{
+	if (handle != nullptr && handle->type == PC_ELAPSED) {
+		handle->time_start = hrt_absolute_time();
+	}
+}
+
+void perf_end(perf_counter_t handle)
+{
+	if (handle == nullptr || handle->type != PC_ELAPSED || handle->time_start == 0) {
+		return;
+	}
+
+	uint64_t elapsed = hrt_absolute_time() - handle->time_start;
+	handle->event_count++;
+	handle->time_total += elapsed;
+
+	if (elapsed < handle->time_least) {
+		handle->time_least = elapsed;
+	}
+
+	if (elapsed > handle->time_most) {
+		handle->time_most = elapsed;
+	}
+
+	handle->time_start = 0;
+}
+
+void perf_cancel(perf_counter_t handle)
+{
+	if (handle != nullptr && handle->type == PC_ELAPSED) {
+		handle->time_start = 0;
+	}
+}
+
+void perf_reset(perf_counter_t handle)
+{
+	if (handle != nullptr) {
+		handle->event_count = 0;
+		handle->time_start = 0;
+		handle->time_total = 0;
+		handle->time_least = UINT64_MAX;
+		handle->time_most = 0;
+	}
+}
+
+void perf_print_counter(perf_counter_t handle)
+{
+	if (handle == nullptr) {
+		return;
+	}
+
+	switch (handle->type) {
+	case PC_COUNT:
+		printf("%s: %" PRIu64 " events\n", handle->name, handle->event_count);
+		break;
+
+	case PC_ELAPSED:
+		printf("%s: %" PRIu64 " events, %" PRIu64 "us elapsed, %" PRIu64 "us avg, min %" PRIu64 "us max %" PRIu64 "us\n",
+		       handle->name, handle->event_count, handle->time_total,
+		       handle->event_count == 0 ? 0 : handle->time_total / handle->event_count,
+		       handle->event_count == 0 ? 0 : handle->time_least, handle->time_most);
+		break;
+
+	case PC_INTERVAL:
+		printf("%s: %" PRIu64 " events, %" PRIu64 "us avg, min %" PRIu64 "us max %" PRIu64 "us\n",
+		       handle->name, handle->event_count,
+		       handle->event_count < 2 ? 0 : handle->time_total / (handle->event_count - 1),
+		       handle->event_count < 2 ? 0 : handle->time_least, handle->time_most);
+		break;
+	}
+}
+
+uint64_t perf_event_count(perf_counter_t handle)
+{
+	return handle == nullptr ? 0 : handle->event_count;
+}
@@ -0,0 +1,124 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file systemlib.cpp
+ * Host implementation of the task and circuit breaker shims.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <systemlib/circuit_breaker.h>
+#include <systemlib/systemlib.h>
+
+#define TASK_MAX_ARGS	16
+
+struct task_start_s {
+	main_t entry;
+	int argc;
+	char *argv[TASK_MAX_ARGS + 2];		/**< task name first, then the arguments, then nullptr */
+};
+
+static void *task_trampoline(void *arg)
+{
+	struct task_start_s *start = (struct task_start_s *)arg;
+	start->entry(start->argc, start->argv);
+
+	for (int i = 0; i < start->argc; i++) {
+		free(start->argv[i]);
+	}
+
+	free(start);
+	return nullptr;
+}
+
+int task_spawn_cmd(const char *name, int scheduler, int priority, int stack_size, main_t entry, char *const argv[])
+{
+	(void)scheduler;
+	(void)priority;
+	(void)stack_size;
+
+	static int task_id = 0;
+
+	struct task_start_s *start = (struct task_start_s *)calloc(1, sizeof(struct task_start_s));
+
+	if (start == nullptr) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	start->entry = entry;
+	start->argv[start->argc++] = strdup(name);
+
+	for (int i = 0; argv != nullptr && argv[i] != nullptr && i < TASK_MAX_ARGS; i++) {
+		start->argv[start->argc++] = strdup(argv[i]);
+	}
+
+	pthread_t thread;
+	int ret = pthread_create(&thread, nullptr, task_trampoline, start);
+
+	if (ret != 0) {
+		for (int i = 0; i < start->argc; i++) {
+			free(start->argv[i]);
+		}
+
+		free(start);
+		errno = ret;
+		return -1;
+	}
+
+	pthread_detach(thread);
+	return __sync_add_and_fetch(&task_id, 1);
+}
+
+int task_delete(int pid)
+{
+	(void)pid;
+	errno = ENOSYS;
+	return -1;
+}
+
+bool circuit_breaker_enabled(const char *breaker, int32_t magic)
+{
+	(void)breaker;
+	(void)magic;
+	return false;
+}
@@ -0,0 +1,110 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file objects_common.cpp
+ * Host definitions of the stock uORB topics the NLIBS module uses.
+ *
+ * Mirrors src/modules/uORB/objects_common.cpp of the firmware.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <uORB/uORB.h>
+
+#include <uORB/topics/vehicle_attitude.h>
+ORB_DEFINE(vehicle_attitude, struct vehicle_attitude_s);
+
+#include <uORB/topics/vehicle_attitude_setpoint.h>
+ORB_DEFINE(vehicle_attitude_setpoint, struct vehicle_attitude_setpoint_s);
+
+#include <uORB/topics/vehicle_rates_setpoint.h>
+ORB_DEFINE(vehicle_rates_setpoint, struct vehicle_rates_setpoint_s);
+
+#include <uORB/topics/fw_virtual_rates_setpoint.h>
+ORB_DEFINE(fw_virtual_rates_setpoint, struct fw_virtual_rates_setpoint_s);
+
+#include <uORB/topics/mc_virtual_rates_setpoint.h>
+ORB_DEFINE(mc_virtual_rates_setpoint, struct mc_virtual_rates_setpoint_s);
+
+#include <uORB/topics/manual_control_setpoint.h>
+ORB_DEFINE(manual_control_setpoint, struct manual_control_setpoint_s);
+
+#include <uORB/topics/vehicle_control_mode.h>
+ORB_DEFINE(vehicle_control_mode, struct vehicle_control_mode_s);
+
+#include <uORB/topics/actuator_armed.h>
+ORB_DEFINE(actuator_armed, struct actuator_armed_s);
+
+#include <uORB/topics/actuator_controls.h>
+ORB_DEFINE(actuator_controls, struct actuator_controls_s);
+ORB_DEFINE(actuator_controls_0, struct actuator_controls_s);
+ORB_DEFINE(actuator_controls_1, struct actuator_controls_s);
+ORB_DEFINE(actuator_controls_2, struct actuator_controls_s);
+ORB_DEFINE(actuator_controls_3, struct actuator_controls_s);
+
+#include <uORB/topics/actuator_controls_virtual_fw.h>
+ORB_DEFINE(actuator_controls_virtual_fw, struct actuator_controls_s);
+
+#include <uORB/topics/actuator_controls_virtual_mc.h>
+ORB_DEFINE(actuator_controls_virtual_mc, struct actuator_controls_s);
+
+#include <uORB/topics/actuator_direct.h>
+ORB_DEFINE(actuator_direct, struct actuator_direct_s);
+
+#include <uORB/topics/vehicle_status.h>
+ORB_DEFINE(vehicle_status, struct vehicle_status_s);
+
+#include <uORB/topics/parameter_update.h>
+ORB_DEFINE(parameter_update, struct parameter_update_s);
+
+#include <uORB/topics/vehicle_local_position.h>
+ORB_DEFINE(vehicle_local_position, struct vehicle_local_position_s);
+
+#include <uORB/topics/position_setpoint_triplet.h>
+ORB_DEFINE(position_setpoint_triplet, struct position_setpoint_triplet_s);
+
+#include <uORB/topics/vehicle_local_position_setpoint.h>
+ORB_DEFINE(vehicle_local_position_setpoint, struct vehicle_local_position_setpoint_s);
+
+#include <uORB/topics/vehicle_global_velocity_setpoint.h>
+ORB_DEFINE(vehicle_global_velocity_setpoint, struct vehicle_global_velocity_setpoint_s);
+
+#include <uORB/topics/multirotor_motor_limits.h>
+ORB_DEFINE(multirotor_motor_limits, struct multirotor_motor_limits_s);
+
+#include <uORB/topics/mc_att_ctrl_status.h>
+ORB_DEFINE(mc_att_ctrl_status, struct mc_att_ctrl_status_s);
@@ -0,0 +1,290 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file uORB.cpp
+ * Host implementation of the uORB shim.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <uORB/uORB.h>
+
+#define ORB_MAX_TOPICS			64
+#define ORB_MAX_SUBSCRIBERS		256
+
+struct orb_topic {
+	const struct orb_metadata *meta;
+	void *data;					/**< last published value */
+	unsigned generation;		/**< publications so far, 0 until advertised */
+};
+
+struct orb_subscriber {
+	int fd;						/**< eventfd */
+	struct orb_topic *topic;	/**< nullptr when the slot is free */
+	unsigned generation;		/**< generation of the last copy */
+};
+
+static pthread_mutex_t orb_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct orb_topic orb_topics[ORB_MAX_TOPICS];
+static struct orb_subscriber orb_subscribers[ORB_MAX_SUBSCRIBERS];
+
+/* called with orb_lock held */
+static struct orb_topic *orb_topic_get(const struct orb_metadata *meta)
+{
+	for (unsigned i = 0; i < ORB_MAX_TOPICS; i++) {
+		if (orb_topics[i].meta == meta) {
+			return &orb_topics[i];
+		}
+
+		if (orb_topics[i].meta == nullptr) {
+			orb_topics[i].data = calloc(1, meta->o_size);
+
+			if (orb_topics[i].data == nullptr) {
+				return nullptr;
+			}
+
+			orb_topics[i].meta = meta;
+			return &orb_topics[i];
+		}
+	}
+
+	return nullptr;
+}
+
+/* called with orb_lock held */
+static struct orb_subscriber *orb_subscriber_get(int handle)
+{
+	for (unsigned i = 0; i < ORB_MAX_SUBSCRIBERS; i++) {
+		if (orb_subscribers[i].topic != nullptr && orb_subscribers[i].fd == handle) {
+			return &orb_subscribers[i];
+		}
+	}
+
+	return nullptr;
+}
+
+/* called with orb_lock held */
+static struct orb_subscriber *orb_subscriber_alloc()
+{
+	for (unsigned i = 0; i < ORB_MAX_SUBSCRIBERS; i++) {
+		if (orb_subscribers[i].topic == nullptr) {
+			return &orb_subscribers[i];
+		}
+	}
+
+	return nullptr;
+}
+
+static void orb_signal(int fd)
+{
+	uint64_t one = 1;
+
+	if (write(fd, &one, sizeof(one)) < 0) {
+		/* the counter can not overflow at our rates, nothing to recover */
+	}
+}
+
+static void orb_drain(int fd)
+{
+	uint64_t count;
+
+	if (read(fd, &count, sizeof(count)) < 0) {
+		/* EAGAIN, nothing was pending */
+	}
+}
+
+orb_advert_t orb_advertise(const struct orb_metadata *meta, const void *data)
+{
+	pthread_mutex_lock(&orb_lock);
+	struct orb_topic *topic = orb_topic_get(meta);
+	pthread_mutex_unlock(&orb_lock);
+
+	if (topic == nullptr) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	orb_advert_t handle = (topic - orb_topics) + 1;
+
+	if (orb_publish(meta, handle, data) != 0) {
+		return -1;
+	}
+
+	return handle;
+}
+
+int orb_publish(const struct orb_metadata *meta, orb_advert_t handle, const void *data)
+{
+	if (handle <= 0 || handle > ORB_MAX_TOPICS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&orb_lock);
+	struct orb_topic *topic = &orb_topics[handle - 1];
+
+	if (topic->meta != meta) {
+		pthread_mutex_unlock(&orb_lock);
+		errno = EINVAL;
+		return -1;
+	}
+
+	memcpy(topic->data, data, meta->o_size);
+	topic->generation++;
+
+	for (unsigned i = 0; i < ORB_MAX_SUBSCRIBERS; i++) {
+		if (orb_subscribers[i].fd >= 0 && orb_subscribers[i].topic == topic) {
+			orb_signal(orb_subscribers[i].fd);
+		}
+	}
+
+	pthread_mutex_unlock(&orb_lock);
+	return 0;
+}
+
+int orb_subscribe(const struct orb_metadata *meta)
+{
+	pthread_mutex_lock(&orb_lock);
+	struct orb_topic *topic = orb_topic_get(meta);
+	struct orb_subscriber *sub = orb_subscriber_alloc();
+
+	if (topic == nullptr || sub == nullptr) {
+		pthread_mutex_unlock(&orb_lock);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (fd < 0) {
+		pthread_mutex_unlock(&orb_lock);
+		return -1;
+	}
+
+	sub->fd = fd;
+	sub->topic = topic;
+	sub->generation = 0;
+
+	/* a topic published before the subscription reads as updated */
+	if (topic->generation > 0) {
+		orb_signal(fd);
+	}
+
+	pthread_mutex_unlock(&orb_lock);
+	return fd;
+}
+
+int orb_unsubscribe(int handle)
+{
+	pthread_mutex_lock(&orb_lock);
+	struct orb_subscriber *sub = orb_subscriber_get(handle);
+
+	if (sub == nullptr) {
+		pthread_mutex_unlock(&orb_lock);
+		errno = EBADF;
+		return -1;
+	}
+
+	close(sub->fd);
+	sub->fd = -1;
+	sub->topic = nullptr;
+	pthread_mutex_unlock(&orb_lock);
+	return 0;
+}
+
+int orb_copy(const struct orb_metadata *meta, int handle, void *buffer)
+{
+	pthread_mutex_lock(&orb_lock);
+	struct orb_subscriber *sub = orb_subscriber_get(handle);
+
+	if (sub == nullptr || sub->topic->meta != meta) {
+		pthread_mutex_unlock(&orb_lock);
+		errno = EBADF;
+		return -1;
+	}
+
+	if (sub->topic->generation == 0) {
+		pthread_mutex_unlock(&orb_lock);
+		errno = EIO;
+		return -1;
+	}
+
+	memcpy(buffer, sub->topic->data, meta->o_size);
+	sub->generation = sub->topic->generation;
+	orb_drain(sub->fd);
+	pthread_mutex_unlock(&orb_lock);
+	return 0;
+}
+
+int orb_check(int handle, bool *updated)
+{
+	pthread_mutex_lock(&orb_lock);
+	struct orb_subscriber *sub = orb_subscriber_get(handle);
+
+	if (sub == nullptr) {
+		pthread_mutex_unlock(&orb_lock);
+		errno = EBADF;
+		return -1;
+	}
+
+	*updated = (sub->generation != sub->topic->generation);
+	pthread_mutex_unlock(&orb_lock);
+	return 0;
+}
+
+int orb_set_interval(int handle, unsigned interval)
+{
+	(void)interval;
+
+	pthread_mutex_lock(&orb_lock);
+	struct orb_subscriber *sub = orb_subscriber_get(handle);
+	pthread_mutex_unlock(&orb_lock);
+
+	if (sub == nullptr) {
+		errno = EBADF;
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file uORB.h
+ * Host shim of the uORB object request broker.
+ *
+ * Each subscription is an eventfd, so that the module polls it as on the
+ * target. Topics live in process memory, keyed by their metadata.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <platforms/px4_defines.h>
+
+/**
+ * Object metadata, one per topic.
+ */
+struct orb_metadata {
+	const char *o_name;		/**< unique object name */
+	const size_t o_size;	/**< object size */
+};
+
+typedef const struct orb_metadata *orb_id_t;
+
+#define ORB_ID(_name)		&__orb_##_name
+
+#ifdef __cplusplus
+# define ORB_DECLARE(_name)	extern "C" const struct orb_metadata __orb_##_name __EXPORT
+#else
+# define ORB_DECLARE(_name)	extern const struct orb_metadata __orb_##_name __EXPORT
+#endif
+
+/* the trailing declaration swallows the semicolon written after the macro */
+#define ORB_DEFINE(_name, _struct) \
+	const struct orb_metadata __orb_##_name = { \
+		#_name, \
+		sizeof(_struct) \
+	}; struct hack
+
+typedef intptr_t orb_advert_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Advertise a topic and publish its first value.
+ *
+ * @return		handle > 0, or -1 with errno set.
+ */
+orb_advert_t	orb_advertise(const struct orb_metadata *meta, const void *data);
+
+/**
+ * Publish a new value. Every subscriber sees the topic as updated and
+ * poll() on its handle returns POLLIN.
+ */
+int				orb_publish(const struct orb_metadata *meta, orb_advert_t handle, const void *data);
+
+/**
+ * @return		pollable handle, or -1 with errno set.
+ */
+int				orb_subscribe(const struct orb_metadata *meta);
+int				orb_unsubscribe(int handle);
+
+/**
+ * Copy the last value and clear the updated flag of the subscription.
+ */
+int				orb_copy(const struct orb_metadata *meta, int handle, void *buffer);
+int				orb_check(int handle, bool *updated);
+
+/**
+ * Rate limiting is not implemented on the host, the call is accepted.
+ */
+int				orb_set_interval(int handle, unsigned interval);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,133 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_test.cpp
+ * Minimal check helpers shared by the host tests.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_test.h"
+
+#include <math.h>
+
+unsigned nlibs_test_checks = 0;
+unsigned nlibs_test_failures = 0;
+
+static uint64_t nlibs_test_state = 0x9e3779b97f4a7c15ULL;
+
+bool nlibs_test_check(bool cond, const char *expr, const char *file, int line)
+{
+	nlibs_test_checks++;
+
+	if (!cond) {
+		nlibs_test_failures++;
+		printf("%s:%d: check failed: %s\n", file, line, expr);
+	}
+
+	return cond;
+}
+
+bool nlibs_test_near(float a, float b, float tol, const char *expr, const char *file, int line)
+{
+	float scale = fmaxf(1.0f, fmaxf(fabsf(a), fabsf(b)));
+	bool near = fabsf(a - b) <= tol * scale;
+
+	nlibs_test_checks++;
+
+	if (!near) {
+		nlibs_test_failures++;
+		printf("%s:%d: check failed: %s (%.9g vs %.9g, tolerance %g)\n", file, line, expr,
+		       (double)a, (double)b, (double)tol);
+	}
+
+	return near;
+}
+
+float nlibs_test_uniform(float lo, float hi)
+{
+	/* splitmix64 */
+	uint64_t z = (nlibs_test_state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z ^= z >> 31;
+
+	return lo + (hi - lo) * (float)((double)(z >> 40) / (double)(1ULL << 24));
+}
+
+void nlibs_test_input(struct nlibs_input_s &in)
+{
+	in.phi = nlibs_test_uniform(-0.6f, 0.6f);
+	in.theta = nlibs_test_uniform(-0.6f, 0.6f);
+	in.psi = nlibs_test_uniform(-3.2f, 3.2f);
+	in.R.from_euler(in.phi, in.theta, in.psi);
+
+	for (unsigned i = 0; i < 3; i++) {
+		in.rates(i) = nlibs_test_uniform(-1.0f, 1.0f);
+		in.pos(i) = nlibs_test_uniform(-10.0f, 10.0f);
+		in.vel(i) = nlibs_test_uniform(-2.0f, 2.0f);
+		in.pos_sp(i) = nlibs_test_uniform(-10.0f, 10.0f);
+		in.vel_ff(i) = nlibs_test_uniform(-1.0f, 1.0f);
+	}
+
+	in.roll_sp = nlibs_test_uniform(-1.0f, 1.0f);
+	in.pitch_sp = nlibs_test_uniform(-1.0f, 1.0f);
+	in.yaw_sp = nlibs_test_uniform(-3.0f, 3.0f);
+	in.thrust_sp = nlibs_test_uniform(0.0f, 1.0f);
+}
+
+void nlibs_test_gains(struct nlibs_params_s &params)
+{
+	for (unsigned i = 0; i < 2; i++) {
+		params.A1_gain(i) *= nlibs_test_uniform(0.5f, 1.5f);
+		params.A2_gain(i) *= nlibs_test_uniform(0.5f, 1.5f);
+		params.A3_gain(i) *= nlibs_test_uniform(0.5f, 1.5f);
+		params.A4_gain(i) *= nlibs_test_uniform(0.5f, 1.5f);
+		params.A5_gain(i) *= nlibs_test_uniform(0.5f, 1.5f);
+		params.A6_gain(i) *= nlibs_test_uniform(0.5f, 1.5f);
+	}
+
+	for (unsigned i = 0; i < 4; i++) {
+		params.A7_gain(i) *= nlibs_test_uniform(0.5f, 2.5f);
+	}
+}
+
+int nlibs_test_report(const char *name)
+{
+	printf("%s: %u checks, %u failed\n", name, nlibs_test_checks, nlibs_test_failures);
+	return nlibs_test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_test.h
+ * Minimal check helpers shared by the host tests.
+ *
+ * A test is a program: each failed check prints its location, the exit
+ * status is the number of failed checks, capped at 1.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../../nlibs_control_law.h"
+
+extern unsigned nlibs_test_checks;
+extern unsigned nlibs_test_failures;
+
+/**
+ * Count a check, report it when it fails.
+ *
+ * @return cond
+ */
+bool	nlibs_test_check(bool cond, const char *expr, const char *file, int line);
+
+/**
+ * Count a check that two values are within tol of each other, relative to
+ * the larger magnitude above 1, report both when they are not.
+ *
+ * @return true when within tolerance
+ */
+bool	nlibs_test_near(float a, float b, float tol, const char *expr, const char *file, int line);
+
+/**
+ * Uniform draw in [lo, hi) from a fixed seed sequence, the same on every run.
+ */
+float	nlibs_test_uniform(float lo, float hi);
+
+/**
+ * Random but consistent controller input: attitude within +-0.6 rad of
+ * level, R built from it, rates, positions and setpoints within their
+ * usual ranges. The mode flags are left to the caller.
+ */
+void	nlibs_test_input(struct nlibs_input_s &in);
+
+/**
+ * Random A1..A7 diagonals around the defaults of params.
+ */
+void	nlibs_test_gains(struct nlibs_params_s &params);
+
+/**
+ * Print the totals of the test.
+ *
+ * @return exit status, 0 when every check passed
+ */
+int		nlibs_test_report(const char *name);
+
+#define NLIBS_CHECK(cond)			nlibs_test_check((cond), #cond, __FILE__, __LINE__)
+#define NLIBS_CHECK_NEAR(a, b, tol)	nlibs_test_near((a), (b), (tol), #a " ~ " #b, __FILE__, __LINE__)
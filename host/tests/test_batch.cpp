@@ -0,0 +1,129 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file test_batch.cpp
+ * Every lane of NLIBSBatch must give the same bits as a
+ * NLIBSControlLaw::control() controller, the one that flies, fed with the
+ * same input and gains, over many steps so that the carried state is
+ * covered too, 90 deg of pitch included.
+ *
+ * The count is not a multiple of the lanes, so the padding is covered.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_test.h"
+
+#include <string.h>
+
+#include "../nlibs_batch.h"
+#include "../nlibs_host.h"
+
+#define TEST_COUNT	37
+#define TEST_STEPS	2000
+#define TEST_DT		0.004f
+
+static bool same_bits(const float *a, const float *b, unsigned n)
+{
+	return memcmp(a, b, n * sizeof(float)) == 0;
+}
+
+static void check_exact(const struct nlibs_output_s &out, const struct nlibs_output_s &ref)
+{
+	NLIBS_CHECK(same_bits(out.att_control.data, ref.att_control.data, 3));
+	NLIBS_CHECK(same_bits(&out.thrust, &ref.thrust, 1));
+	NLIBS_CHECK(same_bits(out.rates_sp.data, ref.rates_sp.data, 3));
+	NLIBS_CHECK(same_bits(out.vel_sp.data, ref.vel_sp.data, 3));
+	NLIBS_CHECK(same_bits(out.forces.data, ref.forces.data, 4));
+	NLIBS_CHECK(same_bits(out.motors.data, ref.motors.data, 4));
+}
+
+int main()
+{
+	struct nlibs_params_s params;
+	nlibs_host_default_params(params);
+
+	static struct nlibs_params_s gains[TEST_COUNT];
+	static NLIBSControlLaw reference[TEST_COUNT];
+
+	NLIBSBatch batch(TEST_COUNT);
+
+	if (!NLIBS_CHECK(batch.count() == TEST_COUNT)) {
+		return nlibs_test_report("test_batch");
+	}
+
+	for (unsigned i = 0; i < TEST_COUNT; i++) {
+		gains[i] = params;
+		nlibs_test_gains(gains[i]);
+		nlibs_params_derive(gains[i]);
+		batch.set_gains(i, gains[i]);
+	}
+
+	for (unsigned step = 0; step < TEST_STEPS; step++) {
+		/* switch the modes now and then, the state carries over */
+		bool position_enabled = (step / 300) % 2 == 0;
+		bool altitude_enabled = (step / 700) % 2 == 0;
+
+		struct nlibs_input_s in[TEST_COUNT];
+		struct nlibs_output_s ref[TEST_COUNT];
+
+		for (unsigned i = 0; i < TEST_COUNT; i++) {
+			nlibs_test_input(in[i]);
+			in[i].position_enabled = position_enabled;
+			in[i].altitude_enabled = altitude_enabled;
+
+			if (step == 5 && i == 0) {
+				in[i].theta = 1.5707964f;
+				in[i].R.from_euler(in[i].phi, in[i].theta, in[i].psi);
+			}
+
+			batch.set_input(i, in[i]);
+			reference[i].control(gains[i], in[i], TEST_DT, ref[i]);
+		}
+
+		batch.control(params, position_enabled, altitude_enabled, TEST_DT);
+
+		for (unsigned i = 0; i < TEST_COUNT; i++) {
+			struct nlibs_output_s out;
+			batch.get_output(i, out);
+
+			check_exact(out, ref[i]);
+		}
+	}
+
+	return nlibs_test_report("test_batch");
+}
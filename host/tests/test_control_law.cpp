@@ -0,0 +1,122 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file test_control_law.cpp
+ * control() runs the generated kernel, control_reference() the hand written
+ * stages. Both start every step from the same state and must agree within
+ * NLIBS_KERNEL_TOLERANCE, in every mode and with random gains.
+ *
+ * nlibs_params_derive() must refuse the models the law would divide by zero in.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_test.h"
+
+#include "../nlibs_host.h"
+
+#define TEST_STEPS	10000
+#define TEST_DT		0.004f
+
+static void check_output(const struct nlibs_output_s &out, const struct nlibs_output_s &ref)
+{
+	for (unsigned i = 0; i < 3; i++) {
+		NLIBS_CHECK_NEAR(out.att_control(i), ref.att_control(i), NLIBS_KERNEL_TOLERANCE);
+		NLIBS_CHECK_NEAR(out.rates_sp(i), ref.rates_sp(i), NLIBS_KERNEL_TOLERANCE);
+		NLIBS_CHECK_NEAR(out.vel_sp(i), ref.vel_sp(i), NLIBS_KERNEL_TOLERANCE);
+	}
+
+	NLIBS_CHECK_NEAR(out.thrust, ref.thrust, NLIBS_KERNEL_TOLERANCE);
+
+	for (unsigned i = 0; i < 4; i++) {
+		NLIBS_CHECK_NEAR(out.forces(i), ref.forces(i), NLIBS_KERNEL_TOLERANCE);
+		NLIBS_CHECK_NEAR(out.motors(i), ref.motors(i), NLIBS_KERNEL_TOLERANCE);
+	}
+}
+
+static void test_derive(const struct nlibs_params_s &defaults)
+{
+	struct nlibs_params_s params = defaults;
+	NLIBS_CHECK(nlibs_params_derive(params));
+
+	params = defaults;
+	params.q_mass = 0.0f;
+	NLIBS_CHECK(!nlibs_params_derive(params));
+
+	params = defaults;
+	params.q_motor_cst = -1.0f;
+	NLIBS_CHECK(!nlibs_params_derive(params));
+
+	params = defaults;
+	params.q_arm_length = 0.0f;
+	NLIBS_CHECK(!nlibs_params_derive(params));
+}
+
+int main()
+{
+	struct nlibs_params_s defaults;
+	nlibs_host_default_params(defaults);
+
+	test_derive(defaults);
+
+	NLIBSControlLaw kernel;
+	NLIBSControlLaw reference;
+
+	for (unsigned step = 0; step < TEST_STEPS; step++) {
+		struct nlibs_params_s params = defaults;
+		nlibs_test_gains(params);
+		NLIBS_CHECK(nlibs_params_derive(params));
+
+		struct nlibs_input_s in;
+		nlibs_test_input(in);
+		in.position_enabled = (step & 1) != 0;
+		in.altitude_enabled = (step & 2) != 0;
+
+		/* the reference carries the state, the kernel restarts from it */
+		struct nlibs_law_state_s state;
+		reference.save(state);
+		kernel.restore(state);
+
+		struct nlibs_output_s out, ref;
+		kernel.control(params, in, TEST_DT, out);
+		reference.control_reference(params, in, TEST_DT, ref);
+
+		check_output(out, ref);
+	}
+
+	return nlibs_test_report("test_control_law");
+}
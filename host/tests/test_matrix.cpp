@@ -0,0 +1,112 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file test_matrix.cpp
+ * The DiagonalMatrix product must equal the dense math::Matrix product
+ * with the same diagonal, the control law relies on it for A1..A7.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_test.h"
+
+#include <nlibs_matrix.h>
+
+#define TEST_DRAWS	1000
+
+template <unsigned int N>
+static void test_product()
+{
+	for (unsigned int draw = 0; draw < TEST_DRAWS; draw++) {
+		nlibs::DiagonalMatrix<N> diag;
+		math::Matrix<N, N> dense;
+		math::Vector<N> v;
+
+		dense.zero();
+
+		for (unsigned int i = 0; i < N; i++) {
+			diag(i) = nlibs_test_uniform(-100.0f, 100.0f);
+			dense(i, i) = diag(i);
+			v(i) = nlibs_test_uniform(-10.0f, 10.0f);
+		}
+
+		math::Vector<N> res_diag = diag * v;
+		math::Vector<N> res_dense = dense * v;
+
+		for (unsigned int i = 0; i < N; i++) {
+			NLIBS_CHECK(res_diag(i) == res_dense(i));
+		}
+	}
+}
+
+template <unsigned int N>
+static void test_init()
+{
+	nlibs::DiagonalMatrix<N> diag;
+	math::Vector<N> v;
+
+	for (unsigned int i = 0; i < N; i++) {
+		v(i) = nlibs_test_uniform(-10.0f, 10.0f);
+	}
+
+	/* default constructed is zero */
+	math::Vector<N> res = diag * v;
+
+	for (unsigned int i = 0; i < N; i++) {
+		NLIBS_CHECK(res(i) == 0.0f);
+	}
+
+	diag.identity();
+	res = diag * v;
+
+	for (unsigned int i = 0; i < N; i++) {
+		NLIBS_CHECK(res(i) == v(i));
+	}
+}
+
+int main()
+{
+	test_init<2>();
+	test_init<3>();
+	test_init<4>();
+
+	test_product<2>();
+	test_product<3>();
+	test_product<4>();
+
+	return nlibs_test_report("test_matrix");
+}
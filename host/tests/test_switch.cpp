@@ -0,0 +1,185 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file test_switch.cpp
+ * Hand the outputs between NLIBS and a stand-in for the stock controllers
+ * in both directions while the vehicle flies the default position step.
+ *
+ * The stand-in is the same law with softer attitude gains. It runs on every
+ * sample, as the stock controllers do, while NLIBS tracks it in standby the
+ * way the module does. The controls may not jump by more than SWITCH_STEP_MAX
+ * on a switch, and tracking must keep the switch to NLIBS well below the jump
+ * of a law that was not tracking.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include <math.h>
+
+#include "nlibs_test.h"
+
+#include "../nlibs_host.h"
+#include "../nlibs_sim.h"
+
+#define TEST_DURATION	6.0f
+#define SWITCH_STEP_MAX	0.05f		/**< largest control change on a switch */
+
+/* owner of the outputs over the run: stock, NLIBS mid step, stock, NLIBS */
+static bool nlibs_owns(float t)
+{
+	return (t >= 1.0f && t < 2.5f) || t >= 4.0f;
+}
+
+/* largest change of the normalized controls from one sample to the next */
+static float control_step(const struct nlibs_output_s &a, const struct nlibs_output_s &b)
+{
+	float step = fabsf(a.thrust - b.thrust);
+
+	for (unsigned i = 0; i < 3; i++) {
+		step = fmaxf(step, fabsf(a.att_control(i) - b.att_control(i)));
+	}
+
+	return step;
+}
+
+/**
+ * Fly the switches.
+ *
+ * @param tracking	NLIBS tracks the stand-in in standby, else it only runs its position stages
+ * @param switch_max	largest control change on a switch, set
+ * @param switches	switches flown, set
+ * @return		position error at the end
+ */
+static float fly(const struct nlibs_params_s &params, const struct nlibs_params_s &stock_params,
+		 bool tracking, float &switch_max, unsigned &switches)
+{
+	struct nlibs_sim_config_s config;
+	nlibs_sim_default_config(config);
+
+	NLIBSPlant plant;
+	plant.set_model(params);
+	plant.reset(config.pos0, config.yaw0);
+
+	NLIBSControlLaw nlibs;
+	NLIBSControlLaw stock;
+
+	struct nlibs_input_s in;
+	in.pos_sp = config.pos_sp;
+	in.vel_ff.zero();
+	in.roll_sp = 0.0f;
+	in.pitch_sp = 0.0f;
+	in.yaw_sp = config.yaw_sp;
+	in.thrust_sp = 0.0f;
+	in.position_enabled = true;
+	in.altitude_enabled = true;
+
+	const uint64_t steps = (uint64_t)(TEST_DURATION / config.control_dt);
+	const float plant_dt = config.control_dt / (float)config.substeps;
+
+	struct nlibs_output_s applied, prev;
+	bool owner_prev = false;
+	switch_max = 0.0f;
+	switches = 0;
+
+	for (uint64_t k = 0; k < steps; k++) {
+		bool owner = nlibs_owns(k * config.control_dt);
+
+		plant.measure(in);
+
+		/* the stock controllers never stop */
+		struct nlibs_output_s stock_out;
+		stock.control(stock_params, in, config.control_dt, stock_out);
+
+		nlibs.update_position(params, in);
+
+		if (owner) {
+			nlibs.control_attitude(params, in, config.control_dt, applied);
+
+		} else {
+			if (tracking) {
+				nlibs.track(params, in, config.control_dt, stock_out.att_control, stock_out.thrust);
+			}
+
+			applied = stock_out;
+		}
+
+		if (k > 0 && owner != owner_prev) {
+			switch_max = fmaxf(switch_max, control_step(applied, prev));
+			switches++;
+		}
+
+		prev = applied;
+		owner_prev = owner;
+
+		plant.set_actuators(applied.att_control, applied.thrust);
+
+		for (unsigned i = 0; i < config.substeps; i++) {
+			plant.step(plant_dt);
+		}
+	}
+
+	return (config.pos_sp - plant.state().pos).length();
+}
+
+int main()
+{
+	struct nlibs_params_s params;
+	nlibs_host_default_params(params);
+	NLIBS_CHECK(nlibs_params_derive(params));
+
+	/* a differently tuned controller, with its own integrals */
+	struct nlibs_params_s stock_params = params;
+	for (unsigned i = 0; i < 2; i++) {
+		stock_params.A3_gain(i) *= 0.6f;
+		stock_params.A4_gain(i) *= 0.6f;
+	}
+
+	NLIBS_CHECK(nlibs_params_derive(stock_params));
+
+	float switch_max, untracked_switch_max;
+	unsigned switches, untracked_switches;
+	float err = fly(params, stock_params, true, switch_max, switches);
+	fly(params, stock_params, false, untracked_switch_max, untracked_switches);
+
+	NLIBS_CHECK(switches == 3);
+	NLIBS_CHECK(switch_max < SWITCH_STEP_MAX);
+	NLIBS_CHECK(switch_max < 0.25f * untracked_switch_max);
+	NLIBS_CHECK(err < 0.1f);
+
+	return nlibs_test_report("test_switch");
+}
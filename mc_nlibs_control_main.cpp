@@ -51,6 +51,8 @@
 
 #include <px4.h>
 #include <nuttx/config.h>
+#include <nuttx/wqueue.h>
+#include <nuttx/clock.h>
 #include <functional>
 #include <stdio.h>
 #include <cstdio>
@@ -61,6 +63,10 @@
 #include <errno.h>
 #include <math.h>
 #include <poll.h>
+#include <semaphore.h>
+#include <time.h>
+#include <arch/irq.h>
+#include <crc32.h>
 #include <drivers/drv_hrt.h>
 #include <arch/board/board.h>
 
@@ -68,6 +74,7 @@
 #include <uORB/topics/vehicle_attitude_setpoint.h>
 #include <uORB/topics/manual_control_setpoint.h>
 #include <uORB/topics/actuator_controls.h>
+#include <uORB/topics/actuator_direct.h>
 #include <uORB/topics/actuator_controls_virtual_fw.h>
 #include <uORB/topics/actuator_controls_virtual_mc.h>
 #include <uORB/topics/vehicle_rates_setpoint.h>
@@ -95,20 +102,46 @@
 #include <mavlink/mavlink_log.h>
 #include <platforms/px4_defines.h>
 
+#include "nlibs_control_law.h"
+#include "nlibs_latency.h"
+#include "nlibs_switch.h"
+#include "nlibs_single_precision.h"
+
 #define TILT_COS_MAX			0.7f
-#define SIGMA					0.000001f
 #define MIN_DIST				0.01f
 
 #define YAW_DEADZONE			0.05f
-#define MIN_TAKEOFF_THRUST   	0.2f
-#define RATES_I_LIMIT			0.3f
+
+#define LATENCY_PUB_INTERVAL	1000000		/**< latency histogram publication period, us */
+#define PARAMS_WORK_INTERVAL	100000		/**< parameter refresh period on the low priority work queue, us */
+#define STOP_TIMEOUT			100000		/**< margin over the longest wait before the control task or parameter item sees a stop, us */
+#define CHECKPOINT_MAX_AGE		1000000		/**< oldest checkpoint a start resumes from, us */
+#define CHECKPOINT_VERSION		2
+
+#define CHECKPOINT_RESET_POS	(1 << 0)
+#define CHECKPOINT_RESET_ALT	(1 << 1)
+#define CHECKPOINT_RESET_ATT	(1 << 2)
+#define CHECKPOINT_RESET_YAW	(1 << 3)
 
  /**
  * Multicopter NLIBS control app start / stop handling function
  *
  * @ingroup apps
  */
-extern "C" __EXPORT int mn_nlibs_control_main(int argc, char *argv[]);
+extern "C" __EXPORT int mc_nlibs_control_main(int argc, char *argv[]);
+
+/**
+ * Controller state saved on stop and restored on the next start, so that a
+ * restart in the air does not rebuild the integral terms from zero.
+ */
+struct nlibs_checkpoint_s {
+	uint32_t version;				/**< CHECKPOINT_VERSION of the layout */
+	uint64_t timestamp;				/**< time of the save */
+	struct nlibs_law_state_s law;	/**< integrals and held references of the law */
+	float pos_sp[3];				/**< NED position setpoint */
+	uint8_t reset;					/**< pending setpoint resets, CHECKPOINT_RESET_* */
+	uint32_t crc;					/**< crc32 of all fields above */
+};
 
 class MulticopterNLIBSControl
 {
@@ -119,22 +152,60 @@ public:
 	MulticopterNLIBSControl();
 
 	/**
-	 * Destructor, also kills task.
+	 * Destructor, also stops the control task.
 	 */
 	~MulticopterNLIBSControl();
 
 	/**
-	 * Start task.
+	 * Start the control task and queue the parameter work item.
 	 *
 	 * @return		OK on success.
 	 */
 	int		start();
 
+	/**
+	 * Stop the control task and the parameter work item and wait until they
+	 * have released the object.
+	 *
+	 * @return		OK on success, -ETIMEDOUT if one of them did not acknowledge:
+	 *			it may still use the object, which must then not be freed.
+	 */
+	int		stop();
+
+	/**
+	 * Stop, reload the parameters and start again, keeping the controller state.
+	 *
+	 * @return		OK on success.
+	 */
+	int		restart();
+
+	/**
+	 * Hand the outputs to NLIBS or to the stock controllers on the next control
+	 * cycle, and record the choice in NLIBSC_ACTIVE.
+	 *
+	 * @param active	true for NLIBS, false for the stock controllers
+	 */
+	void	set_active(bool active);
+
+	/**
+	 * @return		true if the last start() resumed from the checkpoint.
+	 */
+	bool	resumed() const;
+
+	/**
+	 * Print the loop perf counters and the startup timing.
+	 */
+	void	print_status();
+
 private:
 	const float alt_ctl_dz = 0.2f;
 
-	bool	_task_should_exit;		/**< if true, task should exit */
+	bool	_task_should_exit;		/**< if true, the control task exits and the parameter item stops rescheduling */
+	bool	_control_running;		/**< control task started and not yet joined */
+	bool	_params_running;		/**< parameter work item queued and not yet joined */
 	int		_control_task;			/**< task handle for task */
+	sem_t	_control_exit_sem;		/**< posted by the control task once it stopped */
+	sem_t	_params_exit_sem;		/**< posted by the parameter work item once it stopped */
 	int		_mavlink_fd;			/**< mavlink fd */
 
 	int		_att_sub;				/**< vehicle attitude subscription */
@@ -147,6 +218,8 @@ private:
 	int		_pos_sp_triplet_sub;	/**< position setpoint triplet */
 	int		_local_pos_sp_sub;		/**< offboard local position setpoint */
 	int		_global_vel_sp_sub;		/**< offboard global velocity setpoint */
+	int		_actuators_stock_sub;	/**< actuator controls of the stock controllers, on the virtual topic */
+	int		_rates_sp_stock_sub;	/**< rates setpoint of the stock controllers, on the virtual topic */
 
 	orb_advert_t	_att_sp_pub;			/**< attitude setpoint publication */
 	orb_advert_t	_local_pos_sp_pub;		/**< vehicle local position setpoint publication */
@@ -154,8 +227,23 @@ private:
 	orb_advert_t	_controller_status_pub;	/**< controller status publication */
 	orb_advert_t	_v_rates_sp_pub;		/**< rate setpoint publication */
 	orb_advert_t	_actuators_0_pub;		/**< attitude actuator controls publication */
+	orb_advert_t	_actuator_direct_pub;	/**< rotor commands publication, bypassing the mixer */
+	orb_advert_t	_latency_pub;			/**< loop latency histogram publication */
+	orb_advert_t	_switch_pub;			/**< output ownership publication */
 
 	bool	_actuators_0_circuit_breaker_enabled;	/**< circuit breaker to suppress output */
+	volatile bool	_active_request;		/**< requested owner of the outputs, true for NLIBS */
+	int32_t	_active_param;					/**< last NLIBSC_ACTIVE read, a change of it sets the request */
+	bool	_active;						/**< NLIBS owns the outputs, switched on a cycle boundary */
+	bool	_resumed;						/**< the last start() resumed from the checkpoint */
+
+	perf_counter_t	_loop_perf;				/**< loop interval, jitter of the attitude wakeups */
+	perf_counter_t	_poll_perf;				/**< time blocked waiting for attitude */
+	perf_counter_t	_copy_perf;				/**< time spent copying topics and parameters */
+	perf_counter_t	_control_perf;			/**< time spent in control_att_and_pos */
+	perf_counter_t	_publish_perf;			/**< time spent publishing outputs */
+	perf_counter_t	_deadline_perf;			/**< cycles finished after the next attitude sample */
+	perf_counter_t	_position_perf;			/**< position stage updates */
 
 	struct vehicle_attitude_s					_att;				/**< vehicle attitude */
 	struct vehicle_attitude_setpoint_s			_att_sp;			/**< vehicle attitude setpoint */
@@ -164,6 +252,10 @@ private:
 	struct vehicle_control_mode_s				_control_mode;		/**< vehicle control mode */
 	struct actuator_armed_s						_arming;			/**< actuator arming status */
 	struct actuator_controls_s					_actuators;			/**< actuator controls */
+	struct actuator_controls_s					_actuators_stock;	/**< actuator controls of the stock controllers */
+	struct mc_virtual_rates_setpoint_s			_rates_sp_stock;	/**< rates setpoint of the stock controllers */
+	struct nlibs_switch_s						_switch;			/**< output ownership */
+	struct actuator_direct_s					_actuator_direct;	/**< rotor commands */
 	struct vehicle_status_s						_vehicle_status;	/**< vehicle status */
 	struct multirotor_motor_limits_s			_motor_limits;		/**< motor limits */
 	struct mc_att_ctrl_status_s 				_controller_status; /**< controller status */
@@ -171,6 +263,11 @@ private:
 	struct position_setpoint_triplet_s			_pos_sp_triplet;	/**< vehicle global position setpoint triplet */
 	struct vehicle_local_position_setpoint_s	_local_pos_sp;		/**< vehicle local position setpoint */
 	struct vehicle_global_velocity_setpoint_s	_global_vel_sp;		/**< vehicle global velocity setpoint */
+	struct nlibs_latency_s						_latency;			/**< loop latency histogram */
+
+	hrt_abstime	_latency_period_start;	/**< start of the current histogram period */
+	hrt_abstime	_loop_period_prev;		/**< loop period of the previous cycle, us */
+	hrt_abstime	_cycle_prev;			/**< start of the previous control cycle */
 
 	struct {
 		param_t q_mass;
@@ -221,49 +318,27 @@ private:
 		param_t pitch_rate_max;
 		param_t yaw_rate_max;
 
+		param_t poll_timeout;
+		param_t out_direct;
+		param_t active;
+
 	} _params_handles;		/**< handles for interesting parameters */
 
+	struct nlibs_params_s	_params_buf[2];		/**< parameter snapshots, one is rebuilt while the other is read */
+	const struct nlibs_params_s *volatile _params_next;	/**< latest complete snapshot */
+	const struct nlibs_params_s *volatile _params;		/**< snapshot used by the current control cycle */
+	bool	_params_pending;					/**< parameter change not yet built into a snapshot */
+	bool	_params_valid;						/**< a snapshot with an invertible allocation was published */
+	struct work_s	_params_work;				/**< low priority work item refreshing the parameters */
+
 	struct {
-		float q_mass;
-		float q_ix_moment;
-		float q_iy_moment;
-		float q_iz_moment;
-		float q_arm_length;
-		float q_drag_coeff;
-		float q_xlin_drag;
-		float q_ylin_drag;
-		float q_zlin_drag;
-		float q_xrot_drag;
-		float q_yrot_drag;
-		float q_zrot_drag;
-		float q_rotor_radius;
-		float q_rotor_twist_angle;
-		float q_rotor_root_angle;
-		float q_motor_cst;
-
-		float thr_min;
-		float thr_max;
-		float tilt_max_air;
-		float land_speed;
-		float tilt_max_land;
-		float man_roll_max;
-		float man_pitch_max;
-		float man_yaw_max;
-		float roll_rate_max;
-		float pitch_rate_max;
-		float yaw_rate_max;
-
-		math::Vector<3> nlibs_rate_max;
-
-		math::Matrix<2, 2> A1_gain;
-		math::Matrix<2, 2> A2_gain;
-		math::Matrix<2, 2> A3_gain;
-		math::Matrix<2, 2> A4_gain;
-		math::Matrix<2, 2> A5_gain;
-		math::Matrix<2, 2> A6_gain;
-		math::Matrix<4, 4> A7_gain;
-
-	} _params;
+		hrt_abstime start;			/**< time of the last start() */
+		hrt_abstime param_find;		/**< parameter handle lookup, us */
+		hrt_abstime param_load;		/**< first parameter snapshot, us */
+		hrt_abstime subscribe;		/**< topic subscriptions and first copy, us */
+		hrt_abstime first_publish;	/**< start() to the first actuator publication, us */
+		hrt_abstime stop;			/**< last stop() until the task and the work item acknowledged, us */
+	} _timing;		/**< startup and stop timing report */
 
 	struct map_projection_reference_s _ref_pos;
 	float _ref_alt;
@@ -274,18 +349,19 @@ private:
 	bool _reset_att_sp;
 	bool _reset_yaw_s;
 	bool _mode_auto;
+	bool _position_stale;		/**< new local position or mode since the last position stages */
 
 	math::Vector<3> _pos;
 	math::Vector<3> _pos_sp;
 	math::Vector<3> _vel;
 	math::Vector<3> _vel_sp;
-	math::Vector<3> _vel_prev;			/**< velocity on previous step */
 	math::Vector<3> _vel_ff;
 	math::Vector<3> _sp_move_rate;
-	math::Vector<3>	_ang_rates_prev;		/**< angular rates on previous step */
 	math::Vector<3>	_ang_rates_sp;			/**< angular rates setpoint */
-	math::Vector<3>	_rates_int;			/**< angular rates integral error */
 	math::Vector<3>	_att_control;		/**< attitude control vector */
+	math::Vector<4>	_motors;			/**< normalized rotor commands */
+
+	NLIBSControlLaw	_law;				/**< nonlinear integral backstepping control law */
 
 	math::Matrix<3, 3>  _I;				/**< identity matrix */
 
@@ -296,13 +372,100 @@ private:
 	 */
 	int	parameters_update(bool force);
 
+	/**
+	 * Shim for calling params_work from the work queue.
+	 */
+	static void	params_work_trampoline(void *arg);
+
+	/**
+	 * Refresh the parameter snapshot and reschedule, runs on the low priority work queue.
+	 */
+	void		params_work();
+
+	/**
+	 * Check for changes in subscribed topics and copy the ones that changed.
+	 */
+	void	poll_subscriptions();
+
+	/**
+	 * Update position and yaw setpoints from the current mode.
+	 */
+	void	update_setpoints(float dt);
+
+	/**
+	 * Add one cycle to the latency histogram and publish it once per period.
+	 *
+	 * @param period	time since the previous attitude wakeup, us
+	 * @param latency	attitude sample to actuator publish, us
+	 */
+	void	latency_update(hrt_abstime now, hrt_abstime period, hrt_abstime latency);
+
 	/**
 	 * Nonlinear Integral Backstepping controller.
 	 */
 	void control_att_and_pos(float dt);
 
+	/**
+	 * Shim for calling task_main from task_create.
+	 */
+	static int	task_main_trampoline(int argc, char *argv[]);
+
+	/**
+	 * Main attitude and position control task, one control cycle per
+	 * vehicle attitude sample.
+	 */
+	void		task_main();
+
+	/**
+	 * Subscribe to the topics, from the control task that will read them.
+	 */
+	void		control_init();
+
+	/**
+	 * Release the subscriptions and descriptors of the control task.
+	 */
+	void		control_exit();
+
+	/**
+	 * Save the controller state to the checkpoint, the control task and the
+	 * parameter work item are stopped.
+	 */
+	void		checkpoint_save();
+
+	/**
+	 * Resume from the checkpoint when it is intact and recent.
+	 *
+	 * @return		true if the state was restored.
+	 */
+	bool		checkpoint_restore();
+
+	/**
+	 * Wait for the control task or the parameter work item to post its exit semaphore.
+	 *
+	 * @param timeout	longest wait, us
+	 * @return		OK once posted, -ETIMEDOUT after timeout.
+	 */
+	int			join(sem_t *sem, hrt_abstime timeout);
+
+	/**
+	 * One attitude and position control cycle, the attitude sample is waiting.
+	 */
+	void		control_cycle();
+
+	/**
+	 * Copy the stock controls, waiting on their virtual topic, and pass them
+	 * on to the outputs while the stock controllers own them.
+	 */
+	void		forward_stock();
+
+	/**
+	 * Publish the last stock controls on the outputs.
+	 */
+	void		publish_stock();
+
 };
 
+
 namespace nlibs_control
 {
 
@@ -313,11 +476,16 @@ namespace nlibs_control
 static const int ERROR = -1;
 
 MulticopterNLIBSControl	*g_control;
+
+/* outlives the instance, a stop followed by a start resumes from it */
+static struct nlibs_checkpoint_s g_checkpoint;
 }
 
 MulticopterNLIBSControl::MulticopterNLIBSControl() :
 
 	_task_should_exit(false),
+	_control_running(false),
+	_params_running(false),
 	_control_task(-1),
 	_mavlink_fd(-1),
 
@@ -332,6 +500,8 @@ MulticopterNLIBSControl::MulticopterNLIBSControl() :
 	_pos_sp_triplet_sub(-1),
 	_local_pos_sp_sub(-1),
 	_global_vel_sp_sub(-1),
+	_actuators_stock_sub(-1),
+	_rates_sp_stock_sub(-1),
 
 	/* publications */
 	_att_sp_pub(-1),
@@ -340,8 +510,45 @@ MulticopterNLIBSControl::MulticopterNLIBSControl() :
 	_controller_status_pub(-1),
 	_v_rates_sp_pub(-1),
 	_actuators_0_pub(-1),
-
-	_actuators_0_circuit_breaker_enabled(false)
+	_actuator_direct_pub(-1),
+	_latency_pub(-1),
+	_switch_pub(-1),
+
+	_actuators_0_circuit_breaker_enabled(false),
+	_active_request(false),
+	_active_param(-1),
+	_active(false),
+	_resumed(false),
+
+	/* performance counters */
+	_loop_perf(perf_alloc(PC_INTERVAL, "mc_nlibs_control_interval")),
+	_poll_perf(perf_alloc(PC_ELAPSED, "mc_nlibs_control_poll")),
+	_copy_perf(perf_alloc(PC_ELAPSED, "mc_nlibs_control_copy")),
+	_control_perf(perf_alloc(PC_ELAPSED, "mc_nlibs_control_control")),
+	_publish_perf(perf_alloc(PC_ELAPSED, "mc_nlibs_control_publish")),
+	_deadline_perf(perf_alloc(PC_COUNT, "mc_nlibs_control_deadline_miss")),
+	_position_perf(perf_alloc(PC_COUNT, "mc_nlibs_control_position")),
+
+	_latency_period_start(0),
+	_loop_period_prev(0),
+	_cycle_prev(0),
+
+	_params_next(&_params_buf[0]),
+	_params(&_params_buf[0]),
+	_params_pending(false),
+	_params_valid(false),
+
+	_ref_alt(0.0f),
+	_ref_timestamp(0),
+
+	_reset_pos_sp(true),
+	_reset_alt_sp(true),
+	_reset_att_sp(true),
+	_reset_yaw_s(true),
+	_mode_auto(false),
+	_position_stale(true),
+
+	_thrust_sp(0.0f)
 
 {
 	memset(&_att, 0, sizeof(_att));
@@ -351,6 +558,10 @@ MulticopterNLIBSControl::MulticopterNLIBSControl() :
 	memset(&_control_mode, 0, sizeof(_control_mode));
 	memset(&_arming, 0, sizeof(_arming));
 	memset(&_actuators, 0, sizeof(_actuators));
+	memset(&_actuators_stock, 0, sizeof(_actuators_stock));
+	memset(&_rates_sp_stock, 0, sizeof(_rates_sp_stock));
+	memset(&_switch, 0, sizeof(_switch));
+	memset(&_actuator_direct, 0, sizeof(_actuator_direct));
 	memset(&_vehicle_status, 0, sizeof(_vehicle_status));
 	memset(&_motor_limits, 0, sizeof(_motor_limits));
 	memset(&_controller_status, 0, sizeof(_controller_status));
@@ -358,29 +569,37 @@ MulticopterNLIBSControl::MulticopterNLIBSControl() :
 	memset(&_pos_sp_triplet, 0, sizeof(_pos_sp_triplet));
 	memset(&_local_pos_sp, 0, sizeof(_local_pos_sp));
 	memset(&_global_vel_sp, 0, sizeof(_global_vel_sp));
+	memset(&_latency, 0, sizeof(_latency));
+	memset(&_params_work, 0, sizeof(_params_work));
+	memset(&_timing, 0, sizeof(_timing));
+
+	sem_init(&_control_exit_sem, 0, 0);
+	sem_init(&_params_exit_sem, 0, 0);
 	memset(&_ref_pos, 0, sizeof(_ref_pos));
 
-	_params.nlibs_rate_max.zero();
+	for (unsigned i = 0; i < 2; i++) {
+		_params_buf[i].nlibs_rate_max.zero();
 
-	_params.A1_gain.zero();
-	_params.A2_gain.zero();
-	_params.A3_gain.zero();
-	_params.A4_gain.zero();
-	_params.A5_gain.zero();
-	_params.A6_gain.zero();
-	_params.A7_gain.zero();
+		_params_buf[i].A1_gain.zero();
+		_params_buf[i].A2_gain.zero();
+		_params_buf[i].A3_gain.zero();
+		_params_buf[i].A4_gain.zero();
+		_params_buf[i].A5_gain.zero();
+		_params_buf[i].A6_gain.zero();
+		_params_buf[i].A7_gain.zero();
+	}
 
 	_pos.zero();
 	_pos_sp.zero();
 	_vel.zero();
 	_vel_sp.zero();
-	_vel_prev.zero();
 	_vel_ff.zero();
 	_sp_move_rate.zero();
-	_ang_rates_prev.zero();
 	_ang_rates_sp.zero();
-	_rates_int.zero();
 	_att_control.zero();
+	_motors.zero();
+
+	hrt_abstime t0 = hrt_absolute_time();
 
 	_params_handles.q_mass				= param_find("NLIBSC_QMASS");
 	_params_handles.q_ix_moment			= param_find("NLIBSC_QIX_MOMENT");
@@ -430,32 +649,38 @@ MulticopterNLIBSControl::MulticopterNLIBSControl() :
 	_params_handles.pitch_rate_max		= param_find("NLIBSC_PITCH_RATE_MAX");
 	_params_handles.yaw_rate_max		= param_find("NLIBSC_YAW_RATE_MAX");
 
+	_params_handles.poll_timeout		= param_find("NLIBSC_POLL_TMO");
+	_params_handles.out_direct			= param_find("NLIBSC_OUT_DIRECT");
+	_params_handles.active				= param_find("NLIBSC_ACTIVE");
+
+	_timing.param_find = hrt_elapsed_time(&t0);
+
 	/* fetch initial parameter values */
+	t0 = hrt_absolute_time();
 	parameters_update(true);
+	_params = _params_next;
+	_active = _active_request;
+	_timing.param_load = hrt_elapsed_time(&t0);
 }
 
 MulticopterNLIBSControl::~MulticopterNLIBSControl()
 {
-	if (_control_task != -1)
-		/* task wakes up every 100ms or so at the longest */
-		_task_should_exit = true;
-
-		/* wait for a second for the task to quit at our request */
-		unsigned i = 0;
-
-		do {
-			/* wait 20ms */
-			usleep(20000);
-
-			/* if we have given up, kill it */
-			if (++i > 50) {
-				task_delete(_control_task);
-				break;
-			}
-		} while (_control_task != -1);
-	}
-
-	pos_control::g_control = nullptr;
+	/* callers only delete after a successful stop(), this one returns at once then */
+	stop();
+	ASSERT(!_control_running && !_params_running);
+
+	sem_destroy(&_control_exit_sem);
+	sem_destroy(&_params_exit_sem);
+
+	perf_free(_loop_perf);
+	perf_free(_poll_perf);
+	perf_free(_copy_perf);
+	perf_free(_control_perf);
+	perf_free(_publish_perf);
+	perf_free(_deadline_perf);
+	perf_free(_position_perf);
+
+	nlibs_control::g_control = nullptr;
 }
 
 int MulticopterNLIBSControl::parameters_update(bool force)
@@ -464,208 +689,529 @@ int MulticopterNLIBSControl::parameters_update(bool force)
 	float v;
 	struct parameter_update_s param_upd;
 
-	orb_check(_params_sub, &updated);
+	/* the subscription belongs to the work queue, it does not exist before its first run */
+	updated = false;
+
+	if (_params_sub >= 0) {
+		orb_check(_params_sub, &updated);
+	}
 
 	if (updated) {
 		orb_copy(ORB_ID(parameter_update), _params_sub, &param_upd);
 	}
 
 	if (updated || force) {
+		_params_pending = true;
 
-		/* Quadrotor parameters */
-		param_get(_params_handles.q_mass, &_params.q_mass);
-		param_get(_params_handles.q_ix_moment, &_params.q_ix_moment);
-		param_get(_params_handles.q_iy_moment, &_params.q_iy_moment);
-		param_get(_params_handles.q_iz_moment, &_params.q_iz_moment);
-		param_get(_params_handles.q_arm_length, &_params.q_arm_length);
-		param_get(_params_handles.q_drag_coeff, &_params.q_drag_coeff);
-		param_get(_params_handles.q_xlin_drag, &_params.q_xlin_drag);
-		param_get(_params_handles.q_ylin_drag, &_params.q_ylin_drag);
-		param_get(_params_handles.q_zlin_drag, &_params.q_zlin_drag);
-		param_get(_params_handles.q_xrot_drag, &_params.q_xrot_drag);
-		param_get(_params_handles.q_yrot_drag, &_params.q_yrot_drag);
-		param_get(_params_handles.q_zrot_drag, &_params.q_zrot_drag);
-		param_get(_params_handles.q_rotor_radius, &_params.q_rotor_radius);
-		param_get(_params_handles.q_rotor_twist_angle, &_params.q_rotor_twist_angle);
-		param_get(_params_handles.q_rotor_root_angle, &_params.q_rotor_root_angle);
-		param_get(_params_handles.q_motor_cst, &_params.q_motor_cst);
-
-		/* Constraints parameters */
-		param_get(_params_handles.thr_min, &_params.thr_min);
-		param_get(_params_handles.thr_max, &_params.thr_max);
-		param_get(_params_handles.tilt_max_air, &_params.tilt_max_air);
-		param_get(_params_handles.land_speed, &_params.land_speed);
-		param_get(_params_handles.tilt_max_land, &_params.tilt_max_land);
-		param_get(_params_handles.man_roll_max, &_params.man_roll_max);
-		param_get(_params_handles.man_pitch_max, &_params.man_pitch_max);
-		param_get(_params_handles.man_yaw_max, &_params.man_yaw_max);
-		param_get(_params_handles.roll_rate_max, &_params.roll_rate_max);
-		param_get(_params_handles.pitch_rate_max, &_params.pitch_rate_max);
-		param_get(_params_handles.yaw_rate_max, &_params.yaw_rate_max);
-
-		_params.nlibs_rate_max(0) = math::radians(_params.roll_rate_max);
-		_params.nlibs_rate_max(1) = math::radians(_params.pitch_rate_max);
-		_params.nlibs_rate_max(2) = math::radians(_params.yaw_rate_max);
-
-		_params.man_roll_max = math::radians(_params.man_roll_max);
-		_params.man_pitch_max = math::radians(_params.man_pitch_max);
-		_params.man_yaw_max = math::radians(_params.man_yaw_max);
-
-		/* A1 gains */
-		param_get(_params_handles.x_gain, &v);
-		_params.A1_gain(0,0) = v;
-		param_get(_params_handles.y_gain, &v);
-		_params.A1_gain(1,1) = v;
-
-		/* A2 gains */
-		param_get(_params_handles.x_vel_gain, &v);
-		_params.A2_gain(0,0) = v;
-		param_get(_params_handles.y_vel_gain, &v);
-		_params.A2_gain(1,1) = v;
-
-		/* A3 gains */
-		param_get(_params_handles.phi_gain, &v);
-		_params.A3_gain(0,0) = v;
-		param_get(_params_handles.theta_gain, &v);
-		_params.A3_gain(1,1) = v;
-
-		/* A4 gains */
-		param_get(_param_handles.phi_vel_gain, &v);
-		_params.A4_gain(0,0) = v;
-		param_get(_params_handles.theta_vel_gain, &v);
-		_params.A4_gain(1,1) = v;
-
-		/* A5 gains */
-		param_get(_params_handles.psi_gain, &v);
-		_params.A5_gain(0,0) = v;
-		param_get(_params_handles.z_gain, &v);
-		_params.A5_gain(1,1) = v;
-
-		/* A6 gains */
-		param_get(_params_handles.psi_vel_gain, &v);
-		_params.A6_gain(0,0) = v;
-		param_get(_params_handles.z_vel_gain, &v);
-		_params.A6_gain(1,1) = v;
-
-		/* A7 gains */
-		param_get(_params_handles.f1_gain, &v);
-		_params.A7_gain(0,0) = v;
-		param_get(_params_handles.f2_gain, &v);
-		_params.A7_gain(1,1) = v;
-		param_get(_params_handles.f3_gain, &v);
-		_params.A7_gain(2,2) = v;
-		param_get(_params_handles.f4_gain, &v);
-		_params.A7_gain(3,3) = v;
-
+		/* neither depends on the model, they apply even when the snapshot below is refused */
 		_actuators_0_circuit_breaker_enabled = circuit_breaker_enabled("CBRK_RATE_CTRL", CBRK_RATE_CTRL_KEY);
+
+		/* only a change of the parameter requests a switch, switch commands set the request directly */
+		int32_t active;
+		param_get(_params_handles.active, &active);
+
+		if (active != _active_param) {
+			_active_param = active;
+			_active_request = (active != 0);
+		}
 	}
 
+	/* the controller still reads the buffer that would be rebuilt, retry on the next call */
+	if (!_params_pending || _params != _params_next) {
+		return OK;
+	}
+
+	/* build the new snapshot in the buffer the controller is not reading */
+	struct nlibs_params_s &p = (_params_next == &_params_buf[0]) ? _params_buf[1] : _params_buf[0];
+
+	/* Quadrotor parameters */
+	param_get(_params_handles.q_mass, &p.q_mass);
+	param_get(_params_handles.q_ix_moment, &p.q_ix_moment);
+	param_get(_params_handles.q_iy_moment, &p.q_iy_moment);
+	param_get(_params_handles.q_iz_moment, &p.q_iz_moment);
+	param_get(_params_handles.q_arm_length, &p.q_arm_length);
+	param_get(_params_handles.q_drag_coeff, &p.q_drag_coeff);
+	param_get(_params_handles.q_xlin_drag, &p.q_xlin_drag);
+	param_get(_params_handles.q_ylin_drag, &p.q_ylin_drag);
+	param_get(_params_handles.q_zlin_drag, &p.q_zlin_drag);
+	param_get(_params_handles.q_xrot_drag, &p.q_xrot_drag);
+	param_get(_params_handles.q_yrot_drag, &p.q_yrot_drag);
+	param_get(_params_handles.q_zrot_drag, &p.q_zrot_drag);
+	param_get(_params_handles.q_rotor_radius, &p.q_rotor_radius);
+	param_get(_params_handles.q_rotor_twist_angle, &p.q_rotor_twist_angle);
+	param_get(_params_handles.q_rotor_root_angle, &p.q_rotor_root_angle);
+	param_get(_params_handles.q_motor_cst, &p.q_motor_cst);
+
+	/* Constraints parameters */
+	param_get(_params_handles.thr_min, &p.thr_min);
+	param_get(_params_handles.thr_max, &p.thr_max);
+	param_get(_params_handles.tilt_max_air, &p.tilt_max_air);
+	param_get(_params_handles.land_speed, &p.land_speed);
+	param_get(_params_handles.tilt_max_land, &p.tilt_max_land);
+	param_get(_params_handles.man_roll_max, &p.man_roll_max);
+	param_get(_params_handles.man_pitch_max, &p.man_pitch_max);
+	param_get(_params_handles.man_yaw_max, &p.man_yaw_max);
+	param_get(_params_handles.roll_rate_max, &p.roll_rate_max);
+	param_get(_params_handles.pitch_rate_max, &p.pitch_rate_max);
+	param_get(_params_handles.yaw_rate_max, &p.yaw_rate_max);
+	param_get(_params_handles.xy_vel_max, &p.xy_vel_max);
+	param_get(_params_handles.xy_ff, &p.xy_ff);
+
+	p.nlibs_rate_max(0) = math::radians(p.roll_rate_max);
+	p.nlibs_rate_max(1) = math::radians(p.pitch_rate_max);
+	p.nlibs_rate_max(2) = math::radians(p.yaw_rate_max);
+
+	p.man_roll_max = math::radians(p.man_roll_max);
+	p.man_pitch_max = math::radians(p.man_pitch_max);
+	p.man_yaw_max = math::radians(p.man_yaw_max);
+	p.tilt_max_air = math::radians(p.tilt_max_air);
+	p.tilt_max_land = math::radians(p.tilt_max_land);
+
+	/* Loop parameters */
+	param_get(_params_handles.poll_timeout, &p.poll_timeout);
+	param_get(_params_handles.out_direct, &p.out_direct);
+
+	/* A1 gains */
+	param_get(_params_handles.x_gain, &v);
+	p.A1_gain(0) = v;
+	param_get(_params_handles.y_gain, &v);
+	p.A1_gain(1) = v;
+
+	/* A2 gains */
+	param_get(_params_handles.x_vel_gain, &v);
+	p.A2_gain(0) = v;
+	param_get(_params_handles.y_vel_gain, &v);
+	p.A2_gain(1) = v;
+
+	/* A3 gains */
+	param_get(_params_handles.phi_gain, &v);
+	p.A3_gain(0) = v;
+	param_get(_params_handles.theta_gain, &v);
+	p.A3_gain(1) = v;
+
+	/* A4 gains */
+	param_get(_params_handles.phi_vel_gain, &v);
+	p.A4_gain(0) = v;
+	param_get(_params_handles.theta_vel_gain, &v);
+	p.A4_gain(1) = v;
+
+	/* A5 gains */
+	param_get(_params_handles.psi_gain, &v);
+	p.A5_gain(0) = v;
+	param_get(_params_handles.z_gain, &v);
+	p.A5_gain(1) = v;
+
+	/* A6 gains */
+	param_get(_params_handles.psi_vel_gain, &v);
+	p.A6_gain(0) = v;
+	param_get(_params_handles.z_vel_gain, &v);
+	p.A6_gain(1) = v;
+
+	/* A7 gains */
+	param_get(_params_handles.f1_gain, &v);
+	p.A7_gain(0) = v;
+	param_get(_params_handles.f2_gain, &v);
+	p.A7_gain(1) = v;
+	param_get(_params_handles.f3_gain, &v);
+	p.A7_gain(2) = v;
+	param_get(_params_handles.f4_gain, &v);
+	p.A7_gain(3) = v;
+
+	/* constants of the control step, computed here rather than on every step */
+	if (!nlibs_params_derive(p)) {
+		/* the control cycle keeps flying on the previous snapshot, wait for the next change */
+		warnx("singular model, check NLIBSC_QMASS, NLIBSC_QMOTOR_CST, NLIBSC_QARM_LENGTH and NLIBSC_QDRAG_COEFF%s",
+		      _params_valid ? ", keeping the previous parameters" : "");
+		_params_pending = false;
+		return -EINVAL;
+	}
+
+	/* all fields are written, publish the snapshot with a single pointer store */
+	__sync_synchronize();
+	_params_next = &p;
+	_params_pending = false;
+	_params_valid = true;
+
 	return OK;
 }
 
+void MulticopterNLIBSControl::params_work_trampoline(void *arg)
+{
+	MulticopterNLIBSControl *dev = reinterpret_cast<MulticopterNLIBSControl *>(arg);
+
+	dev->params_work();
+}
+
+void MulticopterNLIBSControl::params_work()
+{
+	/* only the run queued by stop() sees the flag on entry */
+	if (_task_should_exit) {
+		/* the work queue thread outlives the module, nothing is closed for us */
+		if (_params_sub >= 0) {
+			orb_unsubscribe(_params_sub);
+			_params_sub = -1;
+		}
+
+		sem_post(&_params_exit_sem);
+		return;
+	}
+
+	/* file descriptors are per task, subscribe from the work queue itself */
+	if (_params_sub < 0) {
+		_params_sub = orb_subscribe(ORB_ID(parameter_update));
+	}
+
+	parameters_update(false);
+
+	/* stop() may requeue the item between the check and work_queue, keep them together */
+	irqstate_t flags = irqsave();
+
+	if (!_task_should_exit) {
+		work_queue(LPWORK, &_params_work, (worker_t)&MulticopterNLIBSControl::params_work_trampoline, this,
+			   USEC2TICK(PARAMS_WORK_INTERVAL));
+	}
+
+	irqrestore(flags);
+}
+
+void MulticopterNLIBSControl::poll_subscriptions()
+{
+	bool updated;
+
+	orb_check(_att_sp_sub, &updated);
+
+	if (updated) {
+		orb_copy(ORB_ID(vehicle_attitude_setpoint), _att_sp_sub, &_att_sp);
+	}
+
+	orb_check(_control_mode_sub, &updated);
+
+	if (updated) {
+		orb_copy(ORB_ID(vehicle_control_mode), _control_mode_sub, &_control_mode);
+		_position_stale = true;
+	}
+
+	orb_check(_manual_sub, &updated);
+
+	if (updated) {
+		orb_copy(ORB_ID(manual_control_setpoint), _manual_sub, &_manual);
+	}
+
+	orb_check(_arming_sub, &updated);
+
+	if (updated) {
+		orb_copy(ORB_ID(actuator_armed), _arming_sub, &_arming);
+	}
+
+	orb_check(_local_pos_sub, &updated);
+
+	if (updated) {
+		orb_copy(ORB_ID(vehicle_local_position), _local_pos_sub, &_local_pos);
+		_position_stale = true;
+	}
+
+	orb_check(_pos_sp_triplet_sub, &updated);
+
+	if (updated) {
+		orb_copy(ORB_ID(position_setpoint_triplet), _pos_sp_triplet_sub, &_pos_sp_triplet);
+	}
+
+	orb_check(_local_pos_sp_sub, &updated);
+
+	if (updated) {
+		orb_copy(ORB_ID(vehicle_local_position_setpoint), _local_pos_sp_sub, &_local_pos_sp);
+	}
+
+	orb_check(_global_vel_sp_sub, &updated);
+
+	if (updated) {
+		orb_copy(ORB_ID(vehicle_global_velocity_setpoint), _global_vel_sp_sub, &_global_vel_sp);
+	}
+}
+
+void MulticopterNLIBSControl::update_setpoints(float dt)
+{
+	if (_reset_pos_sp) {
+		_reset_pos_sp = false;
+		_pos_sp(0) = _pos(0);
+		_pos_sp(1) = _pos(1);
+	}
+
+	if (_reset_alt_sp) {
+		_reset_alt_sp = false;
+		_pos_sp(2) = _pos(2);
+	}
+
+	if (_reset_yaw_s) {
+		_reset_yaw_s = false;
+		_att_sp.yaw_body = _att.yaw;
+	}
+
+	_mode_auto = _control_mode.flag_control_auto_enabled || _control_mode.flag_control_offboard_enabled;
+
+	_sp_move_rate.zero();
+
+	if (_mode_auto) {
+		/* follow the local position setpoint */
+		if (_local_pos_sp.timestamp != 0) {
+			_pos_sp(0) = _local_pos_sp.x;
+			_pos_sp(1) = _local_pos_sp.y;
+			_pos_sp(2) = _local_pos_sp.z;
+			_att_sp.yaw_body = _local_pos_sp.yaw;
+		}
+
+	} else if (_control_mode.flag_control_manual_enabled) {
+		/* move position setpoint with the sticks, rotated by the current yaw */
+		if (_control_mode.flag_control_position_enabled) {
+			float sp_x = _manual.x * _params->xy_vel_max;
+			float sp_y = _manual.y * _params->xy_vel_max;
+			float s_psi = sinf(_att.yaw);
+			float c_psi = cosf(_att.yaw);
+			_sp_move_rate(0) = sp_x * c_psi - sp_y * s_psi;
+			_sp_move_rate(1) = sp_x * s_psi + sp_y * c_psi;
+		}
+
+		if (_control_mode.flag_control_altitude_enabled) {
+			float z_move = _manual.z - 0.5f;
+
+			if (fabsf(z_move) > alt_ctl_dz * 0.5f) {
+				_sp_move_rate(2) = -z_move * 2.0f * _params->land_speed;
+			}
+		}
+
+		_pos_sp += _sp_move_rate * dt;
+
+		if (fabsf(_manual.r) > YAW_DEADZONE) {
+			_att_sp.yaw_body = _wrap_pi(_att_sp.yaw_body + _manual.r * _params->man_yaw_max * dt);
+		}
+	}
+
+	_vel_ff = _sp_move_rate * _params->xy_ff;
+}
+
+/**
+ * Histogram bucket of a duration: 0 below 2 us, then one bucket per power of two.
+ */
+static unsigned latency_bucket(hrt_abstime us)
+{
+	unsigned k = 0;
+
+	while (us > 1 && k < NLIBS_LATENCY_BUCKETS - 1) {
+		us >>= 1;
+		k++;
+	}
+
+	return k;
+}
+
 /**
- * TODO Poll subscriptions
+ * Duration in a 32 bit histogram field, saturated.
  */
+static uint32_t latency_saturate(hrt_abstime us)
+{
+	return (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+}
+
+void MulticopterNLIBSControl::latency_update(hrt_abstime now, hrt_abstime period, hrt_abstime latency)
+{
+	hrt_abstime jitter = (period > _loop_period_prev) ? period - _loop_period_prev : _loop_period_prev - period;
+
+	/* no period yet on the first cycle */
+	if (_loop_period_prev == 0 || period == 0) {
+		jitter = 0;
+	}
+
+	_loop_period_prev = period;
+
+	_latency.count++;
+	_latency.latency[latency_bucket(latency)]++;
+	_latency.jitter[latency_bucket(jitter)]++;
+
+	if (latency > _latency.latency_max) {
+		_latency.latency_max = latency_saturate(latency);
+	}
+
+	if (jitter > _latency.jitter_max) {
+		_latency.jitter_max = latency_saturate(jitter);
+	}
+
+	if (_latency_period_start == 0) {
+		_latency_period_start = now;
+	}
+
+	if (now - _latency_period_start >= LATENCY_PUB_INTERVAL) {
+		_latency.timestamp = now;
+
+		if (_latency_pub > 0) {
+			orb_publish(ORB_ID(nlibs_latency), _latency_pub, &_latency);
+
+		} else {
+			_latency_pub = orb_advertise(ORB_ID(nlibs_latency), &_latency);
+		}
+
+		/* start a new period */
+		memset(&_latency, 0, sizeof(_latency));
+		_latency_period_start = now;
+	}
+}
 
 void MulticopterNLIBSControl::control_att_and_pos(float dt)
 {
-	/* Forces */
-    float u_z =
-
-
-    		-(F1+F2+F3+F4);
-    u_Phi = cos(pi/4)*d*((F3+F2)-(F1+F4));
-    u_Theta = cos(pi/4)*d*((F1+F3)-(F2+F4));
-    u_Psy = c*(F1-F3+F2-F4);
-
-
-
-	/* Rotation matrix */
-	math::Matrix<3, 3>  Rt;
-	math::Matrix<3, 3>  Rr;
-
-	float phi = _att(0);
-	float theta = _att(1);
-	float psi = _att(2);
-
-	Rt(0,0) = cos(theta)*cos(psi);
-	Rt(0,1) = sin(theta)*sin(phi)*cos(psi) - sin(psi)*cos(phi);
-	Rt(0,2) = sin(theta)*cos(phi)*cos(psi) + sin(psi)*sin(phi);
-	Rt(1,0) = cos(theta)*sin(psi);
-	Rt(1,1) = sin(theta)*sin(phi)*sin(psi) + cos(psi)*cos(phi);
-	Rt(1,2) = sin(theta)*cos(phi)*sin(psi) - cos(psi)*sin(phi);
-	Rt(2,0) = -sin(theta);
-	Rt(2,1) = cos(theta)*sin(phi);
-	Rt(2,2) = cos(theta)*cos(phi);
-
-	Rr(0,0) = 1;
-	Rr(0,1) = 0;
-	Rr(0,2) = -sin(theta);
-	Rr(1,0) = 0;
-	Rr(1,1) = cos(phi);
-	Rr(1,2) = cos(theta)*cos(phi);
-	Rr(2,0) = 0;
-	Rr(2,1) = -sin(phi);
-	Rr(2,2) = cos(phi)*cos(theta);
-
-	/* Partial derivative of rotation matrix */
-	math::Matrix<3, 3>  dRrdPhi;
-	math::Matrix<3, 3>  dRrdTheta;
-
-	dRrdPhi(0,0) = 0;
-	dRrdPhi(0,1) = 0;
-	dRrdPhi(0,2) = 0;
-	dRrdPhi(1,0) = 0;
-	dRrdPhi(1,1) = -sin(phi);
-	dRrdPhi(1,2) = cos(theta)*cos(phi);
-	dRrdPhi(2,0) = 0;
-	dRrdPhi(2,1) = -cos(phi);
-	dRrdPhi(2,2) = -cos(theta)*sin(phi);
-
-	dRrdTheta(0,0) = 0;
-	dRrdTheta(0,1) = 0;
-	dRrdTheta(0,2) = -cos(theta);
-	dRrdTheta(1,0) = 0;
-	dRrdTheta(1,1) = 0;
-	dRrdTheta(1,2) = -sin(theta)*sin(phi);
-	dRrdTheta(2,0) = 0;
-	dRrdTheta(2,1) = 0;
-	dRrdTheta(2,2) = -sin(theta)*cos(phi);
-
-	/* Computing gains */
+	/* current state */
+	_pos(0) = _local_pos.x;
+	_pos(1) = _local_pos.y;
+	_pos(2) = _local_pos.z;
+
+	_vel(0) = _local_pos.vx;
+	_vel(1) = _local_pos.vy;
+	_vel(2) = _local_pos.vz;
+
+	if (!_active && _local_pos_sp.timestamp != 0) {
+		/* standby: hold the setpoint the stock position controller flies to */
+		_pos_sp(0) = _local_pos_sp.x;
+		_pos_sp(1) = _local_pos_sp.y;
+		_pos_sp(2) = _local_pos_sp.z;
+		_reset_pos_sp = false;
+		_reset_alt_sp = false;
+	}
 
+	update_setpoints(dt);
 
-	/*
-	g0 = ((u_z)/m)*[sin(Psi), cos(Psi);
-	    -cos(Psi), sin(Psi)];
+	struct nlibs_input_s in;
 
-	g1 = [1/Ix, sin(Phi)*tan(Theta)/Iy;
-	    0     cos(Phi)/Iy];
+	/* the law reads the attitude off the estimated rotation, the Euler angles only give the errors */
+	if (_att.R_valid) {
+		in.R.set(_att.R);
 
-	g2 = [cos(Phi)*sec(Theta)/Iz    0;
-	    0                         cos(Phi)*cos(Theta)/m];
+	} else if (_att.q_valid) {
+		math::Quaternion q(_att.q);
+		in.R = q.to_dcm();
 
-	Varphi0 = [sin(Phi);
-	    cos(Phi)*sin(Theta)];
+	} else {
+		in.R.from_euler(_att.roll, _att.pitch, _att.yaw);
+	}
 
-	Varphi1 = [u_Phi;
-	    u_Theta];
+	in.phi = _att.roll;
+	in.theta = _att.pitch;
+	in.psi = _att.yaw;
+	in.rates(0) = _att.rollspeed;
+	in.rates(1) = _att.pitchspeed;
+	in.rates(2) = _att.yawspeed;
+	in.pos = _pos;
+	in.vel = _vel;
+
+	in.pos_sp = _pos_sp;
+	in.vel_ff = _vel_ff;
+	in.yaw_sp = _att_sp.yaw_body;
+
+	if (_control_mode.flag_control_manual_enabled) {
+		in.roll_sp = _manual.y * _params->man_roll_max;
+		in.pitch_sp = -_manual.x * _params->man_pitch_max;
+		in.thrust_sp = _manual.z;
+
+	} else {
+		in.roll_sp = _att_sp.roll_body;
+		in.pitch_sp = _att_sp.pitch_body;
+		in.thrust_sp = _att_sp.thrust;
+	}
 
-	Varphi2 = [u_Psy;
-	    u_z];
+	in.position_enabled = _control_mode.flag_control_position_enabled;
+	in.altitude_enabled = _control_mode.flag_control_altitude_enabled;
 
-*/
+	/*
+	 * the position stages only change with the local position, which arrives
+	 * at a fraction of the attitude rate: run them on new data and hold their
+	 * virtual controls in between, the attitude stages run every cycle
+	 */
+	if (_position_stale) {
+		_position_stale = false;
+		_law.update_position(*_params, in);
+		perf_count(_position_perf);
+	}
 
+	if (_active) {
+		struct nlibs_output_s out;
 
+		_law.control_attitude(*_params, in, dt, out);
 
+		_att_control = out.att_control;
+		_thrust_sp = out.thrust;
+		_motors = out.motors;
+		_ang_rates_sp = out.rates_sp;
+		_vel_sp = out.vel_sp;
 
+	} else {
+		/* standby: follow the stock controllers, the integrals match their output on a switch */
+		math::Vector<3> att_control;
+		att_control(0) = _actuators_stock.control[0];
+		att_control(1) = _actuators_stock.control[1];
+		att_control(2) = _actuators_stock.control[2];
 
-}
+		_law.track(*_params, in, dt, att_control, _actuators_stock.control[3]);
 
+		_att_control = att_control;
+		_thrust_sp = _actuators_stock.control[3];
+	}
+}
 
+int MulticopterNLIBSControl::task_main_trampoline(int, char *[])
+{
+	nlibs_control::g_control->task_main();
+	return 0;
+}
 
 void MulticopterNLIBSControl::task_main()
 {
+	/* file descriptors are per task, subscribe from the control task itself */
+	control_init();
+
+	/* wakeup source: vehicle attitude, and the stock controls passed through in standby */
+	struct pollfd fds[2];
+
+	fds[0].fd = _att_sub;
+	fds[0].events = POLLIN;
+	fds[1].fd = _actuators_stock_sub;
+	fds[1].events = POLLIN;
+
+	while (!_task_should_exit) {
+
+		/* wait for the next attitude sample, the timeout only bounds the exit check */
+		perf_begin(_poll_perf);
+		int pret = poll(&fds[0], (sizeof(fds) / sizeof(fds[0])), _params->poll_timeout);
+		perf_end(_poll_perf);
+
+		/* timed out - periodic check for _task_should_exit */
+		if (pret == 0) {
+			continue;
+		}
+
+		/* this is undesirable but not much we can do */
+		if (pret < 0) {
+			warn("poll error %d, %d", pret, errno);
+			/* sleep a bit before next try, no longer than a stop may wait */
+			usleep(_params->poll_timeout * 1000);
+			continue;
+		}
+
+		if (fds[1].revents & POLLIN) {
+			forward_stock();
+		}
+
+		if (fds[0].revents & POLLIN) {
+			control_cycle();
+		}
+	}
+
+	control_exit();
+
+	_control_task = -1;
+	sem_post(&_control_exit_sem);
+}
+
+void MulticopterNLIBSControl::control_init()
+{
+	hrt_abstime t0 = hrt_absolute_time();
+
 	_mavlink_fd = open(MAVLINK_LOG_DEVICE, 0);
 
 	/*
@@ -674,52 +1220,535 @@ void MulticopterNLIBSControl::task_main()
 	_att_sub = orb_subscribe(ORB_ID(vehicle_attitude));
 	_att_sp_sub = orb_subscribe(ORB_ID(vehicle_attitude_setpoint));
 	_control_mode_sub = orb_subscribe(ORB_ID(vehicle_control_mode));
-	_params_sub = orb_subscribe(ORB_ID(parameter_update));
 	_manual_sub = orb_subscribe(ORB_ID(manual_control_setpoint));
 	_arming_sub = orb_subscribe(ORB_ID(actuator_armed));
 	_local_pos_sub = orb_subscribe(ORB_ID(vehicle_local_position));
 	_pos_sp_triplet_sub = orb_subscribe(ORB_ID(position_setpoint_triplet));
 	_local_pos_sp_sub = orb_subscribe(ORB_ID(vehicle_local_position_setpoint));
 	_global_vel_sp_sub = orb_subscribe(ORB_ID(vehicle_global_velocity_setpoint));
+	/* the stock controllers publish on the virtual topics, as behind the VTOL attitude controller */
+	_actuators_stock_sub = orb_subscribe(ORB_ID(actuator_controls_virtual_mc));
+	_rates_sp_stock_sub = orb_subscribe(ORB_ID(mc_virtual_rates_setpoint));
 
+	/* get an initial update for all sensor and status data */
+	poll_subscriptions();
 
+	_cycle_prev = 0;
 
+	_timing.subscribe = hrt_elapsed_time(&t0);
+}
 
-	int		_att_sub;				/**< vehicle attitude subscription */
-	int		_att_sp_sub;			/**< vehicle attitude setpoint */
-	int		_control_mode_sub;		/**< vehicle control mode subscription */
-	int		_params_sub;			/**< notification of parameter updates */
-	int		_manual_sub;			/**< notification of manual control updates */
-	int		_arming_sub;			/**< arming status of outputs */
-	int		_local_pos_sub;			/**< vehicle local position */
-	int		_pos_sp_triplet_sub;	/**< position setpoint triplet */
-	int		_local_pos_sp_sub;		/**< offboard local position setpoint */
-	int		_global_vel_sp_sub;		/**< offboard global velocity setpoint */
+void MulticopterNLIBSControl::control_exit()
+{
+	/* release everything before the task exits, nothing is closed for us on the host */
+	orb_unsubscribe(_att_sub);
+	orb_unsubscribe(_att_sp_sub);
+	orb_unsubscribe(_control_mode_sub);
+	orb_unsubscribe(_manual_sub);
+	orb_unsubscribe(_arming_sub);
+	orb_unsubscribe(_local_pos_sub);
+	orb_unsubscribe(_pos_sp_triplet_sub);
+	orb_unsubscribe(_local_pos_sp_sub);
+	orb_unsubscribe(_global_vel_sp_sub);
+	orb_unsubscribe(_actuators_stock_sub);
+	orb_unsubscribe(_rates_sp_stock_sub);
+	_att_sub = -1;
+
+	if (_mavlink_fd >= 0) {
+		close(_mavlink_fd);
+		_mavlink_fd = -1;
+	}
+}
 
-	orb_advert_t	_att_sp_pub;			/**< attitude setpoint publication */
-	orb_advert_t	_local_pos_sp_pub;		/**< vehicle local position setpoint publication */
-	orb_advert_t	_global_vel_sp_pub;		/**< vehicle global velocity setpoint publication */
-	orb_advert_t	_controller_status_pub;	/**< controller status publication */
-	orb_advert_t	_v_rates_sp_pub;		/**< rate setpoint publication */
-	orb_advert_t	_actuators_0_pub;		/**< attitude actuator controls publication */
+void MulticopterNLIBSControl::control_cycle()
+{
+	perf_count(_loop_perf);
+	perf_begin(_copy_perf);
+
+	/* copy attitude topic first, it is what woke us up */
+	orb_copy(ORB_ID(vehicle_attitude), _att_sub, &_att);
 
+	hrt_abstime t = hrt_absolute_time();
+	hrt_abstime period = _cycle_prev != 0 ? t - _cycle_prev : 0;
+	float dt = period * 0.000001f;
+	_cycle_prev = t;
+
+	/* guard against too small (< 2ms) and too large (> 20ms) dt's */
+	if (dt < 0.002f) {
+		dt = 0.002f;
+
+	} else if (dt > 0.02f) {
+		dt = 0.02f;
+	}
 
+	/* only copy the other topics when they actually changed */
+	poll_subscriptions();
+
+	/* pick up the latest snapshot from the parameter work item, it stays fixed for the whole cycle */
+	_params = _params_next;
+
+	perf_end(_copy_perf);
+
+	/* the outputs change owner between two cycles, never within one */
+	if (_active != _active_request || !(_switch_pub > 0)) {
+		_active = _active_request;
+		_switch.timestamp = hrt_absolute_time();
+		_switch.nlibs_active = _active;
+
+		if (_switch_pub > 0) {
+			orb_publish(ORB_ID(nlibs_switch), _switch_pub, &_switch);
+
+		} else {
+			_switch_pub = orb_advertise(ORB_ID(nlibs_switch), &_switch);
+		}
+
+		/* the stock controls of this sample came in before the switch, do not drop them */
+		if (!_active) {
+			publish_stock();
+		}
+	}
+
+	if (!_arming.armed) {
+		/* reset setpoints and integrals to current state when disarmed */
+		_reset_pos_sp = true;
+		_reset_alt_sp = true;
+		_reset_att_sp = true;
+		_reset_yaw_s = true;
+		_law.reset();
+	}
+
+	if (_control_mode.flag_control_attitude_enabled) {
+		perf_begin(_control_perf);
+		control_att_and_pos(dt);
+		perf_end(_control_perf);
+	}
+
+	/* in standby forward_stock() passes the stock controls on, NLIBS only follows them */
+	if (_control_mode.flag_control_attitude_enabled && _active) {
+		perf_begin(_publish_perf);
+
+		/* publish actuator controls */
+		_actuators.control[0] = (isfinite(_att_control(0))) ? _att_control(0) : 0.0f;
+		_actuators.control[1] = (isfinite(_att_control(1))) ? _att_control(1) : 0.0f;
+		_actuators.control[2] = (isfinite(_att_control(2))) ? _att_control(2) : 0.0f;
+		_actuators.control[3] = (isfinite(_thrust_sp)) ? _thrust_sp : 0.0f;
+		_actuators.timestamp = hrt_absolute_time();
+
+		_rates_sp.roll = _ang_rates_sp(0);
+		_rates_sp.pitch = _ang_rates_sp(1);
+		_rates_sp.yaw = _ang_rates_sp(2);
+		_rates_sp.thrust = _thrust_sp;
+		_rates_sp.timestamp = _actuators.timestamp;
+
+		if (_v_rates_sp_pub > 0) {
+			orb_publish(ORB_ID(vehicle_rates_setpoint), _v_rates_sp_pub, &_rates_sp);
+
+		} else {
+			_v_rates_sp_pub = orb_advertise(ORB_ID(vehicle_rates_setpoint), &_rates_sp);
+		}
+
+		if (_actuators_0_circuit_breaker_enabled) {
+			/* outputs suppressed */
+
+		} else if (_params->out_direct != 0) {
+			/* rotor commands straight to the output driver, in the [-1, 1] range of mixer outputs */
+			for (unsigned i = 0; i < 4; i++) {
+				float m = isfinite(_motors(i)) ? _motors(i) : 0.0f;
+				_actuator_direct.values[i] = math::constrain(m * 2.0f - 1.0f, -1.0f, 1.0f);
+			}
+
+			_actuator_direct.nvalues = 4;
+			_actuator_direct.timestamp = _actuators.timestamp;
+
+			if (_actuator_direct_pub > 0) {
+				orb_publish(ORB_ID(actuator_direct), _actuator_direct_pub, &_actuator_direct);
+
+			} else {
+				_actuator_direct_pub = orb_advertise(ORB_ID(actuator_direct), &_actuator_direct);
+			}
+
+		} else {
+			if (_actuators_0_pub > 0) {
+				orb_publish(ORB_ID(actuator_controls_0), _actuators_0_pub, &_actuators);
+
+			} else {
+				_actuators_0_pub = orb_advertise(ORB_ID(actuator_controls_0), &_actuators);
+			}
+		}
+
+		perf_end(_publish_perf);
+
+		if (_timing.first_publish == 0) {
+			_timing.first_publish = hrt_elapsed_time(&_timing.start);
+		}
+
+		/* an attitude sample without timestamp gives no latency */
+		if (_att.timestamp != 0 && _att.timestamp <= _actuators.timestamp) {
+			latency_update(_actuators.timestamp, period, _actuators.timestamp - _att.timestamp);
+		}
+	}
+
+	/* a new attitude sample is already waiting: this cycle was too slow */
+	bool missed;
+	orb_check(_att_sub, &missed);
+
+	if (missed) {
+		perf_count(_deadline_perf);
+	}
 }
 
+void MulticopterNLIBSControl::forward_stock()
+{
+	orb_copy(ORB_ID(actuator_controls_virtual_mc), _actuators_stock_sub, &_actuators_stock);
+
+	bool updated;
+	orb_check(_rates_sp_stock_sub, &updated);
 
+	if (updated) {
+		orb_copy(ORB_ID(mc_virtual_rates_setpoint), _rates_sp_stock_sub, &_rates_sp_stock);
+	}
 
+	/* NLIBS owns the outputs, the control cycle only tracks the stock controls */
+	if (!_active) {
+		publish_stock();
+	}
+}
 
-
+void MulticopterNLIBSControl::publish_stock()
+{
+	if (_rates_sp_stock.timestamp != 0) {
+		_rates_sp.roll = _rates_sp_stock.roll;
+		_rates_sp.pitch = _rates_sp_stock.pitch;
+		_rates_sp.yaw = _rates_sp_stock.yaw;
+		_rates_sp.thrust = _rates_sp_stock.thrust;
+		_rates_sp.timestamp = _rates_sp_stock.timestamp;
+
+		if (_v_rates_sp_pub > 0) {
+			orb_publish(ORB_ID(vehicle_rates_setpoint), _v_rates_sp_pub, &_rates_sp);
+
+		} else {
+			_v_rates_sp_pub = orb_advertise(ORB_ID(vehicle_rates_setpoint), &_rates_sp);
+		}
+	}
 
+	if (_actuators_stock.timestamp != 0 && !_actuators_0_circuit_breaker_enabled) {
+		if (_actuators_0_pub > 0) {
+			orb_publish(ORB_ID(actuator_controls_0), _actuators_0_pub, &_actuators_stock);
 
+		} else {
+			_actuators_0_pub = orb_advertise(ORB_ID(actuator_controls_0), &_actuators_stock);
+		}
+	}
+}
 
+void MulticopterNLIBSControl::print_status()
+{
+	perf_print_counter(_loop_perf);
+	perf_print_counter(_poll_perf);
+	perf_print_counter(_copy_perf);
+	perf_print_counter(_control_perf);
+	perf_print_counter(_publish_perf);
+	perf_print_counter(_deadline_perf);
+	perf_print_counter(_position_perf);
+
+	warnx("param_find %llu us, param load %llu us, subscribe %llu us",
+	      (unsigned long long)_timing.param_find, (unsigned long long)_timing.param_load,
+	      (unsigned long long)_timing.subscribe);
+
+	if (_timing.first_publish != 0) {
+		warnx("first publish %llu us after start", (unsigned long long)_timing.first_publish);
+
+	} else {
+		warnx("no publish since start");
+	}
 
+	warnx("last stop %llu us", (unsigned long long)_timing.stop);
+	warnx("started %s", _resumed ? "from the checkpoint" : "from zero");
+	warnx("outputs owned by %s", _active ? "nlibs" : "stock controllers");
+}
 
+int MulticopterNLIBSControl::start()
+{
+	ASSERT(!_control_running && !_params_running);
 
+	/* never fly on a singular model */
+	if (!_params_valid) {
+		warnx("no valid parameters, not started");
+		return -EINVAL;
+	}
 
+	_resumed = checkpoint_restore();
 
+	if (_resumed) {
+		warnx("resumed from checkpoint");
+	}
 
+	_task_should_exit = false;
+	_timing.start = hrt_absolute_time();
+	_timing.first_publish = 0;
+
+	/* start the task */
+	_control_task = task_spawn_cmd("mc_nlibs_control",
+				       SCHED_DEFAULT,
+				       SCHED_PRIORITY_MAX - 5,
+				       2000,
+				       (main_t)&MulticopterNLIBSControl::task_main_trampoline,
+				       nullptr);
+
+	if (_control_task < 0) {
+		warn("task start failed");
+		return -errno;
+	}
 
+	_control_running = true;
 
+	/* parameter changes are handled off the control task */
+	_params_running = true;
+	work_queue(LPWORK, &_params_work, (worker_t)&MulticopterNLIBSControl::params_work_trampoline, this, 0);
 
+	return OK;
+}
 
+int MulticopterNLIBSControl::stop()
+{
+	if (!_control_running && !_params_running) {
+		return OK;
+	}
+
+	hrt_abstime t0 = hrt_absolute_time();
+
+	/*
+	 * the control task sees the flag within one poll timeout, about one control
+	 * period, or as soon as the next attitude sample wakes it; the parameter
+	 * item may be queued for a whole PARAMS_WORK_INTERVAL: bring its run forward
+	 */
+	irqstate_t flags = irqsave();
+	_task_should_exit = true;
+
+	if (_params_running) {
+		work_cancel(LPWORK, &_params_work);
+		work_queue(LPWORK, &_params_work, (worker_t)&MulticopterNLIBSControl::params_work_trampoline, this, 0);
+	}
+
+	irqrestore(flags);
+
+	int ret = OK;
+
+	/* a second stop() after a timeout only waits for what has not acknowledged yet */
+	if (_control_running) {
+		ret = join(&_control_exit_sem, (hrt_abstime)_params->poll_timeout * 1000 + STOP_TIMEOUT);
+
+		if (ret == OK) {
+			_control_running = false;
+
+		} else {
+			warnx("control task did not stop");
+		}
+	}
+
+	if (_params_running) {
+		int ret_params = join(&_params_exit_sem, STOP_TIMEOUT);
+
+		if (ret_params == OK) {
+			_params_running = false;
+
+		} else {
+			warnx("parameter work did not stop");
+			ret = ret_params;
+		}
+	}
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	_timing.stop = hrt_elapsed_time(&t0);
+
+	checkpoint_save();
+
+	return OK;
+}
+
+void MulticopterNLIBSControl::set_active(bool active)
+{
+	/* the control cycle switches on the request, the parameter only records it */
+	_active_request = active;
+
+	int32_t v = active ? 1 : 0;
+	param_set(_params_handles.active, &v);
+}
+
+bool MulticopterNLIBSControl::resumed() const
+{
+	return _resumed;
+}
+
+int MulticopterNLIBSControl::restart()
+{
+	int ret = stop();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	/* reload on the first run of the parameter item, not from the calling shell */
+	_params_pending = true;
+
+	return start();
+}
+
+void MulticopterNLIBSControl::checkpoint_save()
+{
+	struct nlibs_checkpoint_s &c = nlibs_control::g_checkpoint;
+
+	/* padding is covered by the crc too */
+	memset(&c, 0, sizeof(c));
+
+	c.version = CHECKPOINT_VERSION;
+	c.timestamp = hrt_absolute_time();
+	_law.save(c.law);
+
+	for (unsigned i = 0; i < 3; i++) {
+		c.pos_sp[i] = _pos_sp(i);
+	}
+
+	c.reset = (_reset_pos_sp ? CHECKPOINT_RESET_POS : 0) |
+		  (_reset_alt_sp ? CHECKPOINT_RESET_ALT : 0) |
+		  (_reset_att_sp ? CHECKPOINT_RESET_ATT : 0) |
+		  (_reset_yaw_s ? CHECKPOINT_RESET_YAW : 0);
+
+	c.crc = crc32((const uint8_t *)&c, offsetof(struct nlibs_checkpoint_s, crc));
+}
+
+bool MulticopterNLIBSControl::checkpoint_restore()
+{
+	const struct nlibs_checkpoint_s &c = nlibs_control::g_checkpoint;
+
+	if (c.version != CHECKPOINT_VERSION ||
+	    c.crc != crc32((const uint8_t *)&c, offsetof(struct nlibs_checkpoint_s, crc))) {
+		return false;
+	}
+
+	/* older integrals no longer match the vehicle, start from zero */
+	if (hrt_elapsed_time(&c.timestamp) > CHECKPOINT_MAX_AGE) {
+		return false;
+	}
+
+	_law.restore(c.law);
+
+	for (unsigned i = 0; i < 3; i++) {
+		_pos_sp(i) = c.pos_sp[i];
+	}
+
+	_reset_pos_sp = (c.reset & CHECKPOINT_RESET_POS) != 0;
+	_reset_alt_sp = (c.reset & CHECKPOINT_RESET_ALT) != 0;
+	_reset_att_sp = (c.reset & CHECKPOINT_RESET_ATT) != 0;
+	_reset_yaw_s = (c.reset & CHECKPOINT_RESET_YAW) != 0;
+
+	return true;
+}
+
+int MulticopterNLIBSControl::join(sem_t *sem, hrt_abstime timeout)
+{
+	struct timespec abstime;
+	clock_gettime(CLOCK_REALTIME, &abstime);
+
+	abstime.tv_nsec += (timeout % 1000000) * 1000;
+	abstime.tv_sec += timeout / 1000000 + abstime.tv_nsec / 1000000000;
+	abstime.tv_nsec %= 1000000000;
+
+	while (sem_timedwait(sem, &abstime) != 0) {
+		if (errno != EINTR) {
+			return -errno;
+		}
+	}
+
+	return OK;
+}
+
+int mc_nlibs_control_main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		errx(1, "usage: mc_nlibs_control {start|stop|restart|status|switch nlibs|stock}");
+	}
+
+	if (!strcmp(argv[1], "start")) {
+
+		if (nlibs_control::g_control != nullptr) {
+			errx(1, "already running");
+		}
+
+		nlibs_control::g_control = new MulticopterNLIBSControl;
+
+		if (nlibs_control::g_control == nullptr) {
+			errx(1, "alloc failed");
+		}
+
+		if (OK != nlibs_control::g_control->start()) {
+			delete nlibs_control::g_control;
+			nlibs_control::g_control = nullptr;
+			err(1, "start failed");
+		}
+
+		exit(0);
+	}
+
+	if (!strcmp(argv[1], "stop")) {
+		if (nlibs_control::g_control == nullptr) {
+			errx(1, "not running");
+		}
+
+		/* the task or the work item may still use the object, keep it for a later stop */
+		if (OK != nlibs_control::g_control->stop()) {
+			errx(1, "stop timed out, still running");
+		}
+
+		delete nlibs_control::g_control;
+		nlibs_control::g_control = nullptr;
+		exit(0);
+	}
+
+	if (!strcmp(argv[1], "restart")) {
+		if (nlibs_control::g_control == nullptr) {
+			errx(1, "not running");
+		}
+
+		if (OK != nlibs_control::g_control->restart()) {
+			errx(1, "restart failed");
+		}
+
+		exit(0);
+	}
+
+	if (!strcmp(argv[1], "switch")) {
+		if (nlibs_control::g_control == nullptr) {
+			errx(1, "not running");
+		}
+
+		if (argc > 2 && !strcmp(argv[2], "nlibs")) {
+			nlibs_control::g_control->set_active(true);
+
+		} else if (argc > 2 && !strcmp(argv[2], "stock")) {
+			nlibs_control::g_control->set_active(false);
+
+		} else {
+			errx(1, "usage: mc_nlibs_control switch {nlibs|stock}");
+		}
+
+		exit(0);
+	}
+
+	if (!strcmp(argv[1], "status")) {
+		if (nlibs_control::g_control) {
+			warnx("running");
+			nlibs_control::g_control->print_status();
+			exit(0);
+
+		} else {
+			errx(1, "not running");
+		}
+	}
+
+	warnx("unrecognized command");
+	return 1;
+}
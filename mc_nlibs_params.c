@@ -149,11 +149,15 @@
  PARAM_DEFINE_FLOAT(NLIBSC_QROTOR_ROOT_ANGLE, 0.01f);
 
  /*
-  * Motor constant (??)
+  * Motor constant, rotor thrust at full motor command (N)
+  *
+  * Hovering takes NLIBSC_QMASS * g / 4 per rotor, 2.45 N for the default
+  * mass: keep the constant well above that, the control law clamps the
+  * rotor forces to the motor range.
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
- PARAM_DEFINE_FLOAT(NLIBSC_QMOTOR_CST, 0.2f);
+ PARAM_DEFINE_FLOAT(NLIBSC_QMOTOR_CST, 5.0f);
 
 /* 
  * Minimum vertial thrust
@@ -178,112 +182,120 @@
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_X_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_X_GAIN, 1.5f);
 
  /*
   * Y-axis positition gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_Y_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_Y_GAIN, 1.5f);
 
  /*
   * X-axis speed gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_X_VEL_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_X_VEL_GAIN, 1.5f);
 
  /*
   * Y-axis speed gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_Y_VEL_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_Y_VEL_GAIN, 1.5f);
 
  /*
   * Roll angle gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_PHI_GAIN, 1.0f);  
+  PARAM_DEFINE_FLOAT(NLIBSC_PHI_GAIN, 20.0f);  
 
  /*
   * Pitch angle gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_THETA_GAIN, 1.0f);  
+  PARAM_DEFINE_FLOAT(NLIBSC_THETA_GAIN, 20.0f);  
 
  /*
   * Roll rate gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_PHI_RATE_GAIN, 1.0f);  
+  PARAM_DEFINE_FLOAT(NLIBSC_PHI_RATE_GAIN, 20.0f);  
 
  /*
   * Pitch rate gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_THETA_RATE_GAIN, 1.0f);  
+  PARAM_DEFINE_FLOAT(NLIBSC_THETA_RATE_GAIN, 20.0f);  
 
  /*
   * Yaw angle gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_PSI_GAIN, 1.0f); 
+  PARAM_DEFINE_FLOAT(NLIBSC_PSI_GAIN, 4.0f); 
 
  /*
   * Z-axis position gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_Z_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_Z_GAIN, 3.0f);
 
  /*
   * Yaw rate gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_PSI_RATE_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_PSI_RATE_GAIN, 10.0f);
 
  /*
   * Z-axis speed gain. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_Z_VEL_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_Z_VEL_GAIN, 3.0f);
 
  /*
-  * Motor 1 input gain. Must be positive
+  * Motor 1 force bandwidth (1/s), first order lag of the rotor force
+  * towards the allocated one. Above the control rate the allocation is
+  * applied as is. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_F1_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_F1_GAIN, 100.0f);
 
  /*
-  * Motor 2 input gain. Must be positive
+  * Motor 2 force bandwidth (1/s), first order lag of the rotor force
+  * towards the allocated one. Above the control rate the allocation is
+  * applied as is. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_F2_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_F2_GAIN, 100.0f);
 
  /*
-  * Motor 3 input gain. Must be positive
+  * Motor 3 force bandwidth (1/s), first order lag of the rotor force
+  * towards the allocated one. Above the control rate the allocation is
+  * applied as is. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_F3_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_F3_GAIN, 100.0f);
 
  /*
-  * Motor 4 input gain. Must be positive
+  * Motor 4 force bandwidth (1/s), first order lag of the rotor force
+  * towards the allocated one. Above the control rate the allocation is
+  * applied as is. Must be positive
   * @min 0.0
   * @group Multicopter NLIBS Control
   */
-  PARAM_DEFINE_FLOAT(NLIBSC_F4_GAIN, 1.0f);
+  PARAM_DEFINE_FLOAT(NLIBSC_F4_GAIN, 100.0f);
 
 /* TO REVIEW */
 
@@ -401,3 +413,53 @@ PARAM_DEFINE_FLOAT(NLIBSC_MAN_P_MAX, 35.0f);
  */
 PARAM_DEFINE_FLOAT(NLIBSC_MAN_Y_MAX, 120.0f);
 
+
+/**
+ * Attitude poll timeout
+ *
+ * The control loop wakes up on every vehicle attitude sample. This timeout only
+ * bounds how long the task blocks without a sample before it checks for exit,
+ * so it is also the longest a stop or restart waits without attitude. Keep it
+ * just over the attitude period.
+ *
+ * @unit ms
+ * @min 1
+ * @max 100
+ * @group Multicopter NLIBS Control
+ */
+PARAM_DEFINE_INT32(NLIBSC_POLL_TMO, 5);
+
+/**
+ * Direct rotor output
+ *
+ * 0: publish roll, pitch, yaw and thrust on actuator_controls_0 for the
+ * multirotor mixer. 1: publish the normalized command of every rotor on
+ * actuator_direct, the output driver applies them without mixing. The rotors
+ * are in the order of the quadrotor X mixer.
+ *
+ * @min 0
+ * @max 1
+ * @group Multicopter NLIBS Control
+ */
+PARAM_DEFINE_INT32(NLIBSC_OUT_DIRECT, 0);
+
+/**
+ * NLIBS owns the outputs
+ *
+ * 1: NLIBS publishes actuator_controls_0 and vehicle_rates_setpoint. 0: it
+ * passes on those of the stock attitude controller instead, which publishes
+ * them on actuator_controls_virtual_mc and mc_virtual_rates_setpoint as on a
+ * VTOL, and keeps running on the same inputs, following the stock outputs
+ * so that switching back is bumpless. A change is picked up with the other
+ * parameters, within 100 ms, and the outputs switch between two control
+ * cycles; mc_nlibs_control switch {nlibs|stock} switches on the next cycle
+ * and sets this parameter. The owner is published on nlibs_switch.
+ *
+ * Off by default: a vehicle that just gained the module keeps flying on the
+ * stock controllers until NLIBS is switched in.
+ *
+ * @min 0
+ * @max 1
+ * @group Multicopter NLIBS Control
+ */
+PARAM_DEFINE_INT32(NLIBSC_ACTIVE, 0);
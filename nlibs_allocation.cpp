@@ -0,0 +1,135 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_allocation.cpp
+ * Allocation of the NLIBS virtual controls to the rotor forces.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_allocation.h"
+
+#include <float.h>
+#include <math.h>
+
+#include "nlibs_single_precision.h"
+
+#define COS_PI_4				0.70710678f
+
+/*
+ * Rotors on the diagonals, F1 front right and F2 back left spinning one way,
+ * F3 front left and F4 back right the other:
+ *	u_Phi = cos(pi/4)*d*((F3+F2)-(F1+F4));
+ *	u_Theta = cos(pi/4)*d*((F1+F3)-(F2+F4));
+ *	u_Psy = c*(F1-F3+F2-F4);
+ */
+const struct nlibs_rotor_s nlibs_quad_x[4] = {
+	{ -COS_PI_4,  COS_PI_4,  1.0f },
+	{  COS_PI_4, -COS_PI_4,  1.0f },
+	{  COS_PI_4,  COS_PI_4, -1.0f },
+	{ -COS_PI_4, -COS_PI_4, -1.0f },
+};
+
+bool nlibs_allocation_build(struct nlibs_allocation_s &alloc, const struct nlibs_rotor_s rotors[4],
+			    float arm_length, float drag_coeff)
+{
+	math::Matrix<4, 4> &B = alloc.B;
+	float scale = 0.0f;
+
+	/* every rotor pushes along -z body */
+	for (unsigned i = 0; i < 4; i++) {
+		B(0, i) = -1.0f;
+		B(1, i) = rotors[i].roll * arm_length;
+		B(2, i) = rotors[i].pitch * arm_length;
+		B(3, i) = rotors[i].yaw * drag_coeff;
+
+		for (unsigned r = 0; r < 4; r++) {
+			scale = fmaxf(scale, fabsf(B(r, i)));
+		}
+	}
+
+	/* Gauss-Jordan elimination with partial pivoting, run once per parameter update */
+	math::Matrix<4, 4> a = B;
+	math::Matrix<4, 4> &inv = alloc.B_inv;
+	inv.identity();
+
+	for (unsigned c = 0; c < 4; c++) {
+		unsigned p = c;
+
+		for (unsigned r = c + 1; r < 4; r++) {
+			if (fabsf(a(r, c)) > fabsf(a(p, c))) {
+				p = r;
+			}
+		}
+
+		if (!(fabsf(a(p, c)) > FLT_EPSILON * scale)) {
+			inv.zero();
+			return false;
+		}
+
+		for (unsigned j = 0; j < 4; j++) {
+			float t = a(c, j);
+			a(c, j) = a(p, j);
+			a(p, j) = t;
+			t = inv(c, j);
+			inv(c, j) = inv(p, j);
+			inv(p, j) = t;
+		}
+
+		const float pivot_inv = 1.0f / a(c, c);
+
+		for (unsigned j = 0; j < 4; j++) {
+			a(c, j) *= pivot_inv;
+			inv(c, j) *= pivot_inv;
+		}
+
+		for (unsigned r = 0; r < 4; r++) {
+			if (r == c) {
+				continue;
+			}
+
+			const float f = a(r, c);
+
+			for (unsigned j = 0; j < 4; j++) {
+				a(r, j) -= f * a(c, j);
+				inv(r, j) -= f * inv(c, j);
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,89 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_allocation.h
+ * Allocation of the NLIBS virtual controls to the rotor forces.
+ *
+ * The rotor forces F1..F4 produce the virtual controls
+ * (u_z, u_Phi, u_Theta, u_Psy) of the control law through a 4x4 allocation
+ * matrix, built from the arm length, the rotor drag coefficient and the
+ * position and spin direction of every rotor. The matrix is inverted once
+ * when the parameters change, a control step only applies the inverse.
+ *
+ * The controller, the host plant and the log tools all read the same
+ * matrix, so they agree on the frame geometry.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <mathlib/mathlib.h>
+
+/**
+ * Position and spin direction of one rotor, in the units of the PX4
+ * multirotor mixer geometries.
+ */
+struct nlibs_rotor_s {
+	float roll;		/**< roll moment per unit of force and arm length */
+	float pitch;	/**< pitch moment per unit of force and arm length */
+	float yaw;		/**< yaw moment per unit of force and drag coefficient, the spin direction */
+};
+
+/**
+ * Rotors of the quadrotor X frame, in motor order.
+ */
+extern const struct nlibs_rotor_s nlibs_quad_x[4];
+
+/**
+ * Allocation matrix of a frame and its inverse.
+ */
+struct nlibs_allocation_s {
+	math::Matrix<4, 4> B;		/**< rotor forces to virtual controls */
+	math::Matrix<4, 4> B_inv;	/**< virtual controls to rotor forces */
+};
+
+/**
+ * Build the allocation matrix of a frame and invert it.
+ *
+ * @param rotors		geometry of the four rotors
+ * @param arm_length	distance of the rotors to the center of mass
+ * @param drag_coeff	yaw moment per unit of rotor force
+ * @return false when the matrix is singular, B_inv is then zero
+ */
+bool	nlibs_allocation_build(struct nlibs_allocation_s &alloc, const struct nlibs_rotor_s rotors[4],
+			       float arm_length, float drag_coeff);
@@ -0,0 +1,189 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_control_kernel.cpp
+ * Straight-line kernel of the NLIBS control law.
+ *
+ * GENERATED by codegen/nlibs_codegen.py from codegen/nlibs_model.py, do not
+ * edit: change the model and run the generator again.
+ *
+ * position stages: 451 operations in the expanded model expressions, 109 after
+ * eliminating 19 common subexpressions.
+ *
+ * attitude stages: 63154 operations in the expanded model expressions, 194 after
+ * eliminating 52 common subexpressions.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_control_law.h"
+
+#include <math.h>
+#include <lib/geo/geo.h>
+
+#include "nlibs_single_precision.h"
+
+#define SIGMA                   0.000001f
+#define RATES_I_LIMIT           0.3f
+
+void nlibs_position_kernel(const struct nlibs_params_s &params, const struct nlibs_input_s &in,
+			   const float forces[4], struct nlibs_outer_s &outer)
+{
+	const float forces_0 = forces[0];
+	const float forces_1 = forces[1];
+	const float forces_2 = forces[2];
+	const float forces_3 = forces[3];
+
+	const float t0 = sqrtf(in.R(2, 1)*in.R(2, 1) + in.R(2, 2)*in.R(2, 2));
+	const bool t1 = SIGMA < t0;
+	const float t2 = ((t1) ? (1.0F/(t0)) : (1.0F/(SIGMA)));
+	const float t3 = ((t1) ? (in.R(0, 0)*t2) : (in.R(1, 1)));
+	const float t4 = params.q_xlin_drag*(in.R(0, 0)*in.vel(0) + in.R(1, 0)*in.vel(1) + in.R(2, 0)*in.vel(2));
+	const float t5 = params.q_ylin_drag*(in.R(0, 1)*in.vel(0) + in.R(1, 1)*in.vel(1) + in.R(2, 1)*in.vel(2));
+	const float t6 = params.q_zlin_drag*(in.R(0, 2)*in.vel(0) + in.R(1, 2)*in.vel(1) + in.R(2, 2)*in.vel(2));
+	const float t7 = in.pos(1) - in.pos_sp(1);
+	const float t8 = in.vel_ff(1) - params.A1_gain(1)*t7;
+	const float t9 = params.q_mass/fminf(-params.derived.u_z_min, -forces_0 - forces_1 - forces_2 - forces_3);
+	const float t10 = t9*(-in.vel(1)*params.A1_gain(1) + params.A2_gain(1)*(-in.vel(1) + t8) - params.derived.inv_mass*(-in.R(1, 0)*t4 - in.R(1, 1)*t5 - in.R(1, 2)*t6) - t7);
+	const float t11 = ((t1) ? (in.R(1, 0)*t2) : (-in.R(0, 1)));
+	const float t12 = in.pos(0) - in.pos_sp(0);
+	const float t13 = in.vel_ff(0) - params.A1_gain(0)*t12;
+	const float t14 = t9*(-in.vel(0)*params.A1_gain(0) + params.A2_gain(0)*(-in.vel(0) + t13) - params.derived.inv_mass*(-in.R(0, 0)*t4 - in.R(0, 1)*t5 - in.R(0, 2)*t6) - t12);
+	const float t15 = -params.derived.sin_tilt_max;
+	const float t16 = math::constrain(-t10*t3 + t11*t14, t15, params.derived.sin_tilt_max);
+	const float t17 = in.pos(2) - in.pos_sp(2);
+	const float t18 = in.vel_ff(2) - params.A5_gain(1)*t17;
+
+	outer.phi_sp = asinf(t16);
+	outer.theta_sp = asinf(math::constrain((t10*t11 + t14*t3)/sqrtf(1 - t16*t16), t15, params.derived.sin_tilt_max));
+	outer.acc_z = -CONSTANTS_ONE_G - in.vel(2)*params.A5_gain(1) + params.A6_gain(1)*(-in.vel(2) + t18) - params.derived.inv_mass*(-in.R(2, 0)*t4 - in.R(2, 1)*t5 - in.R(2, 2)*t6) - t17;
+	outer.vel_sp(0) = ((in.position_enabled) ? (t13) : (0.0F));
+	outer.vel_sp(1) = ((in.position_enabled) ? (t8) : (0.0F));
+	outer.vel_sp(2) = ((in.altitude_enabled) ? (t18) : (0.0F));
+}
+
+void nlibs_attitude_kernel(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+			   const struct nlibs_outer_s &outer, float rates_int[3], float forces[4],
+			   struct nlibs_output_s &out)
+{
+	const float rates_int_0 = rates_int[0];
+	const float rates_int_1 = rates_int[1];
+	const float rates_int_2 = rates_int[2];
+	const float forces_0 = forces[0];
+	const float forces_1 = forces[1];
+	const float forces_2 = forces[2];
+	const float forces_3 = forces[3];
+
+	const float t0 = ((in.position_enabled) ? (outer.phi_sp) : (in.roll_sp));
+	const float t1 = params.A3_gain(0)*(-in.phi + t0);
+	const float t2 = sqrtf(in.R(2, 1)*in.R(2, 1) + in.R(2, 2)*in.R(2, 2));
+	const bool t3 = SIGMA < t2;
+	const float t4 = ((t3) ? (1.0F/(t2)) : (1.0F/(SIGMA)));
+	const float t5 = ((t3) ? (in.R(2, 1)*t4) : (0.0F));
+	const float t6 = in.rates(1)*t4*t5;
+	const float t7 = ((t3) ? (in.R(2, 2)*t4) : (1.0F));
+	const float t8 = in.rates(2)*t4*t7;
+	const float t9 = in.R(2, 0)*t6 + in.R(2, 0)*t8 - in.rates(0);
+	const float t10 = t1 + t9;
+	const float t11 = -RATES_I_LIMIT;
+	const float t12 = math::constrain(dt*t10 + rates_int_0, t11, RATES_I_LIMIT);
+	const float t13 = in.theta - ((in.position_enabled) ? (outer.theta_sp) : (in.pitch_sp));
+	const float t14 = -params.A3_gain(1)*t13;
+	const float t15 = in.rates(2)*t5;
+	const float t16 = in.rates(1)*t7;
+	const float t17 = t14 + t15 - t16;
+	const float t18 = math::constrain(dt*t17 + rates_int_1, t11, RATES_I_LIMIT);
+	const float t19 = _wrap_pi(-in.psi + in.yaw_sp);
+	const float t20 = t6 + t8;
+	const float t21 = -params.A5_gain(0)*t19 + t20;
+	const float t22 = math::constrain(-dt*t21 + rates_int_2, t11, RATES_I_LIMIT);
+	const float t23 = ((in.altitude_enabled) ? (outer.acc_z*params.q_mass/in.R(2, 2)) : (-in.thrust_sp*params.derived.thrust_to_u_z));
+	const float t24 = -t9;
+	const float t25 = -t15 + t16;
+	const float t26 = -params.A5_gain(0)*t20 + params.A6_gain(0)*(-t21 + t22) + t19;
+	const float t27 = in.rates(0)*params.q_xrot_drag + params.q_ix_moment*(in.R(2, 0)*t26 - in.phi - params.A3_gain(0)*t24 + params.A4_gain(0)*(t10 + t12) + t0 - t2*t20*t25);
+	const float t28 = t25*t5;
+	const float t29 = -params.A3_gain(1)*t25 + params.A4_gain(1)*(t17 + t18) - t13;
+	const float t30 = t2*t24;
+	const float t31 = t2*t26;
+	const float t32 = in.rates(1)*params.q_yrot_drag + params.q_iy_moment*(t20*(in.R(2, 0)*t28 + t30*t7) - t24*t28 + t29*t7 + t31*t5);
+	const float t33 = t25*t7;
+	const float t34 = in.rates(2)*params.q_zrot_drag + params.q_iz_moment*(t20*(in.R(2, 0)*t33 - t30*t5) - t24*t33 - t29*t5 + t31*t7);
+	const float t35 = math::constrain(forces_0 + (-forces_0 + params.derived.allocation.B_inv(0, 0)*t23 + params.derived.allocation.B_inv(0, 1)*t27 + params.derived.allocation.B_inv(0, 2)*t32 + params.derived.allocation.B_inv(0, 3)*t34)*math::constrain(dt*params.A7_gain(0), 0.0F, 1.0F), params.derived.f_min, params.derived.f_max);
+	const float t36 = params.derived.inv_motor_cst*t35;
+	const float t37 = math::constrain(forces_1 + (-forces_1 + params.derived.allocation.B_inv(1, 0)*t23 + params.derived.allocation.B_inv(1, 1)*t27 + params.derived.allocation.B_inv(1, 2)*t32 + params.derived.allocation.B_inv(1, 3)*t34)*math::constrain(dt*params.A7_gain(1), 0.0F, 1.0F), params.derived.f_min, params.derived.f_max);
+	const float t38 = params.derived.inv_motor_cst*t37;
+	const float t39 = math::constrain(forces_2 + (-forces_2 + params.derived.allocation.B_inv(2, 0)*t23 + params.derived.allocation.B_inv(2, 1)*t27 + params.derived.allocation.B_inv(2, 2)*t32 + params.derived.allocation.B_inv(2, 3)*t34)*math::constrain(dt*params.A7_gain(2), 0.0F, 1.0F), params.derived.f_min, params.derived.f_max);
+	const float t40 = params.derived.inv_motor_cst*t39;
+	const float t41 = math::constrain(forces_3 + (-forces_3 + params.derived.allocation.B_inv(3, 0)*t23 + params.derived.allocation.B_inv(3, 1)*t27 + params.derived.allocation.B_inv(3, 2)*t32 + params.derived.allocation.B_inv(3, 3)*t34)*math::constrain(dt*params.A7_gain(3), 0.0F, 1.0F), params.derived.f_min, params.derived.f_max);
+	const float t42 = params.derived.inv_motor_cst*t41;
+	const float t43 = (0.25F)*t40;
+	const float t44 = -t43;
+	const float t45 = (0.25F)*t42;
+	const float t46 = (0.25F)*t38;
+	const float t47 = (0.25F)*t36;
+	const float t48 = -t46 + t47;
+	const float t49 = -t45;
+	const float t50 = t46 + t47;
+	const float t51 = params.A5_gain(0)*t19;
+
+	rates_int[0] = t12;
+	rates_int[1] = t18;
+	rates_int[2] = t22;
+	forces[0] = t35;
+	out.forces(0) = t35;
+	out.motors(0) = t36;
+	forces[1] = t37;
+	out.forces(1) = t37;
+	out.motors(1) = t38;
+	forces[2] = t39;
+	out.forces(2) = t39;
+	out.motors(2) = t40;
+	forces[3] = t41;
+	out.forces(3) = t41;
+	out.motors(3) = t42;
+	out.att_control(0) = -t44 - t45 - t48;
+	out.att_control(1) = t43 + t48 + t49;
+	out.att_control(2) = t44 + t49 + t50;
+	out.thrust = t43 + t45 + t50;
+	out.rates_sp(0) = in.R(2, 0)*t51 + t1;
+	out.rates_sp(1) = t14*t7 + t2*t5*t51;
+	out.rates_sp(2) = params.A5_gain(0)*t19*t2*t7 - t14*t5;
+	out.vel_sp(0) = outer.vel_sp(0);
+	out.vel_sp(1) = outer.vel_sp(1);
+	out.vel_sp(2) = outer.vel_sp(2);
+}
@@ -0,0 +1,549 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_control_law.cpp
+ * Multicopter non linear integral backstepping control law.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#include "nlibs_control_law.h"
+
+#include <string.h>
+#include <math.h>
+#include <lib/geo/geo.h>
+
+#include "nlibs_single_precision.h"
+
+#define SIGMA					0.000001f
+#define MIN_TAKEOFF_THRUST   	0.2f
+#define RATES_I_LIMIT			0.3f
+
+bool nlibs_params_derive(struct nlibs_params_s &params)
+{
+	struct nlibs_derived_s &d = params.derived;
+
+	/* both are divided by, NaN fails the test too */
+	if (!(params.q_mass > 0.0f) || !(params.q_motor_cst > 0.0f)) {
+		return false;
+	}
+
+	d.inv_mass = 1.0f / params.q_mass;
+	d.u_z_min = MIN_TAKEOFF_THRUST * 4.0f * params.q_motor_cst;
+	d.thrust_to_u_z = 4.0f * params.q_motor_cst;
+	d.sin_tilt_max = sinf(params.tilt_max_air);
+
+	d.f_min = params.thr_min * params.q_motor_cst;
+	d.f_max = params.thr_max * params.q_motor_cst;
+	d.inv_motor_cst = 1.0f / params.q_motor_cst;
+
+	return nlibs_allocation_build(d.allocation, nlibs_quad_x, params.q_arm_length, params.q_drag_coeff);
+}
+
+NLIBSControlLaw::NLIBSControlLaw()
+{
+	memset(&_trig, 0, sizeof(_trig));
+
+	_outer.phi_sp = 0.0f;
+	_outer.theta_sp = 0.0f;
+	_outer.acc_z = 0.0f;
+	_outer.vel_sp.zero();
+
+	_rates_int.zero();
+	_forces.zero();
+}
+
+void NLIBSControlLaw::reset()
+{
+	_rates_int.zero();
+	_forces.zero();
+}
+
+void NLIBSControlLaw::save(struct nlibs_law_state_s &state) const
+{
+	for (unsigned i = 0; i < 3; i++) {
+		state.rates_int[i] = _rates_int(i);
+		state.vel_sp[i] = _outer.vel_sp(i);
+	}
+
+	for (unsigned i = 0; i < 4; i++) {
+		state.forces[i] = _forces(i);
+	}
+
+	state.phi_sp = _outer.phi_sp;
+	state.theta_sp = _outer.theta_sp;
+	state.acc_z = _outer.acc_z;
+}
+
+void NLIBSControlLaw::restore(const struct nlibs_law_state_s &state)
+{
+	for (unsigned i = 0; i < 3; i++) {
+		_rates_int(i) = state.rates_int[i];
+		_outer.vel_sp(i) = state.vel_sp[i];
+	}
+
+	for (unsigned i = 0; i < 4; i++) {
+		_forces(i) = state.forces[i];
+	}
+
+	_outer.phi_sp = state.phi_sp;
+	_outer.theta_sp = state.theta_sp;
+	_outer.acc_z = state.acc_z;
+}
+
+void NLIBSControlLaw::track(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+			    const math::Vector<3> &att_control, float thrust)
+{
+	const struct nlibs_derived_s &d = params.derived;
+
+	/* rotor commands of the active controller, the output map of mix() inverted */
+	math::Vector<4> n;
+	n(0) = thrust - att_control(0) + att_control(1) + att_control(2);
+	n(1) = thrust + att_control(0) - att_control(1) + att_control(2);
+	n(2) = thrust + att_control(0) + att_control(1) - att_control(2);
+	n(3) = thrust - att_control(0) - att_control(1) - att_control(2);
+
+	for (int i = 0; i < 4; i++) {
+		_forces(i) = math::constrain(n(i) * params.q_motor_cst, d.f_min, d.f_max);
+	}
+
+	/* torques of this law with the integrals so far, integrated over this step */
+	struct nlibs_matrices_s m;
+	update_trig(in.R);
+	build_rotation(in.R, m);
+	build_rotation_derivatives(m);
+	build_gains(params, m);
+
+	math::Vector<4> u;
+	struct nlibs_output_s out;
+	backstepping(params, in, dt, m, _outer, u, out);
+
+	/*
+	 * the integrals enter the Euler angle accelerations through A4 and A6
+	 * only, shift them by the acceleration missing to the active torques
+	 */
+	math::Vector<4> u_active = d.allocation.B * _forces;
+	float moment[3] = { params.q_ix_moment, params.q_iy_moment, params.q_iz_moment };
+	math::Vector<3> rates_dot_err;
+
+	/* an axis without inertia gives no acceleration to shift by, leave its integral */
+	for (int i = 0; i < 3; i++) {
+		rates_dot_err(i) = (moment[i] > 0.0f) ? (u_active(i + 1) - u(i + 1)) / moment[i] : 0.0f;
+	}
+
+	math::Vector<3> eta_ddot_err = m.Rr_inv * rates_dot_err;
+
+	float gain[3] = { params.A4_gain(0), params.A4_gain(1), params.A6_gain(0) };
+
+	for (int i = 0; i < 3; i++) {
+		if (gain[i] > 0.0f) {
+			_rates_int(i) = math::constrain(_rates_int(i) + eta_ddot_err(i) / gain[i], -RATES_I_LIMIT, RATES_I_LIMIT);
+		}
+	}
+}
+
+void NLIBSControlLaw::update_trig(const math::Matrix<3, 3> &R)
+{
+	/*
+	 * R = Rz(psi)*Ry(theta)*Rx(phi): its last row is
+	 * [-sin(Theta), cos(Theta)*sin(Phi), cos(Theta)*cos(Phi)] and its first
+	 * column [cos(Theta)*cos(Psi), cos(Theta)*sin(Psi), -sin(Theta)]. The
+	 * pitch stays within +-90 deg, cos(Theta) >= 0.
+	 */
+	float c_theta = sqrtf(R(2, 1) * R(2, 1) + R(2, 2) * R(2, 2));
+
+	_trig.s_theta = -R(2, 0);
+	_trig.c_theta = c_theta;
+
+	/* keep sec(theta) and tan(theta) of the Euler rates finite close to +-90 deg of pitch */
+	_trig.sec_theta = 1.0f / ((c_theta > SIGMA) ? c_theta : SIGMA);
+	_trig.t_theta = _trig.s_theta * _trig.sec_theta;
+
+	if (c_theta > SIGMA) {
+		_trig.s_phi = R(2, 1) * _trig.sec_theta;
+		_trig.c_phi = R(2, 2) * _trig.sec_theta;
+		_trig.s_psi = R(1, 0) * _trig.sec_theta;
+		_trig.c_psi = R(0, 0) * _trig.sec_theta;
+
+	} else {
+		/* gimbal lock, only psi - phi or psi + phi is defined: take phi = 0 */
+		_trig.s_phi = 0.0f;
+		_trig.c_phi = 1.0f;
+		_trig.s_psi = -R(0, 1);
+		_trig.c_psi = R(1, 1);
+	}
+}
+
+void NLIBSControlLaw::build_rotation(const math::Matrix<3, 3> &R, struct nlibs_matrices_s &m)
+{
+	math::Matrix<3, 3> &Rr = m.Rr;
+	math::Matrix<3, 3> &Rr_inv = m.Rr_inv;
+
+	const float sphi = _trig.s_phi;
+	const float cphi = _trig.c_phi;
+	const float sthe = _trig.s_theta;
+	const float cthe = _trig.c_theta;
+
+	/* body to NED rotation, as estimated */
+	m.Rt = R;
+
+	/* Euler angle rates to body rates */
+	Rr(0, 0) = 1.0f;
+	Rr(0, 1) = 0.0f;
+	Rr(0, 2) = -sthe;
+	Rr(1, 0) = 0.0f;
+	Rr(1, 1) = cphi;
+	Rr(1, 2) = cthe * sphi;
+	Rr(2, 0) = 0.0f;
+	Rr(2, 1) = -sphi;
+	Rr(2, 2) = cphi * cthe;
+
+	/* body rates to Euler angle rates */
+	Rr_inv(0, 0) = 1.0f;
+	Rr_inv(0, 1) = sphi * _trig.t_theta;
+	Rr_inv(0, 2) = cphi * _trig.t_theta;
+	Rr_inv(1, 0) = 0.0f;
+	Rr_inv(1, 1) = cphi;
+	Rr_inv(1, 2) = -sphi;
+	Rr_inv(2, 0) = 0.0f;
+	Rr_inv(2, 1) = sphi * _trig.sec_theta;
+	Rr_inv(2, 2) = cphi * _trig.sec_theta;
+}
+
+void NLIBSControlLaw::build_rotation_derivatives(struct nlibs_matrices_s &m)
+{
+	math::Matrix<3, 3> &dRrdPhi = m.dRrdPhi;
+	math::Matrix<3, 3> &dRrdTheta = m.dRrdTheta;
+
+	dRrdPhi(0, 0) = 0.0f;
+	dRrdPhi(0, 1) = 0.0f;
+	dRrdPhi(0, 2) = 0.0f;
+	dRrdPhi(1, 0) = 0.0f;
+	dRrdPhi(1, 1) = -_trig.s_phi;
+	dRrdPhi(1, 2) = _trig.c_theta * _trig.c_phi;
+	dRrdPhi(2, 0) = 0.0f;
+	dRrdPhi(2, 1) = -_trig.c_phi;
+	dRrdPhi(2, 2) = -_trig.c_theta * _trig.s_phi;
+
+	dRrdTheta(0, 0) = 0.0f;
+	dRrdTheta(0, 1) = 0.0f;
+	dRrdTheta(0, 2) = -_trig.c_theta;
+	dRrdTheta(1, 0) = 0.0f;
+	dRrdTheta(1, 1) = 0.0f;
+	dRrdTheta(1, 2) = -_trig.s_theta * _trig.s_phi;
+	dRrdTheta(2, 0) = 0.0f;
+	dRrdTheta(2, 1) = 0.0f;
+	dRrdTheta(2, 2) = -_trig.s_theta * _trig.c_phi;
+}
+
+void NLIBSControlLaw::build_gains(const struct nlibs_params_s &params, struct nlibs_matrices_s &m)
+{
+	math::Matrix<2, 2> &g0 = m.g0;
+
+	/*
+	g0 = ((u_z)/m)*[sin(Psi), cos(Psi);
+	    -cos(Psi), sin(Psi)];
+
+	g_z = cos(Phi)*cos(Theta)/m;
+
+	The torques are not found through the roll/pitch and yaw gains
+	g1 = [1/Ix, sin(Phi)*tan(Theta)/Iy; 0, cos(Phi)/Iy] and
+	g2(1,1) = cos(Phi)*sec(Theta)/Iz any more, which are singular at
+	+-90 deg of pitch and 90 deg of roll, see backstepping().
+	*/
+
+	/* Forces of the previous step, mixed into the current virtual controls */
+	const float F1 = _forces(0);
+	const float F2 = _forces(1);
+	const float F3 = _forces(2);
+	const float F4 = _forces(3);
+
+	float u_z = -(F1 + F2 + F3 + F4);
+
+	/* keep g0 invertible on the ground */
+	if (u_z > -params.derived.u_z_min) {
+		u_z = -params.derived.u_z_min;
+	}
+
+	float k = u_z * params.derived.inv_mass;
+
+	g0(0, 0) = k * _trig.s_psi;
+	g0(0, 1) = k * _trig.c_psi;
+	g0(1, 0) = -k * _trig.c_psi;
+	g0(1, 1) = k * _trig.s_psi;
+
+	m.g_z = _trig.c_phi * _trig.c_theta * params.derived.inv_mass;
+}
+
+void NLIBSControlLaw::control(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+			      struct nlibs_output_s &out)
+{
+	update_position(params, in);
+	control_attitude(params, in, dt, out);
+}
+
+void NLIBSControlLaw::update_position(const struct nlibs_params_s &params, const struct nlibs_input_s &in)
+{
+	nlibs_position_kernel(params, in, _forces.data, _outer);
+}
+
+void NLIBSControlLaw::control_attitude(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+				       struct nlibs_output_s &out)
+{
+	nlibs_attitude_kernel(params, in, dt, _outer, _rates_int.data, _forces.data, out);
+}
+
+void NLIBSControlLaw::control_reference(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+					struct nlibs_output_s &out)
+{
+	struct nlibs_matrices_s m;
+
+	/* Trigonometric functions, read once off the rotation for all the matrices below */
+	update_trig(in.R);
+
+	/* Rotation matrix */
+	build_rotation(in.R, m);
+
+	/* Partial derivative of rotation matrix */
+	build_rotation_derivatives(m);
+
+	/* Computing gains */
+	build_gains(params, m);
+
+	/* Position references */
+	position(params, in, m, _outer);
+
+	/* Virtual controls */
+	math::Vector<4> u;
+	backstepping(params, in, dt, m, _outer, u, out);
+
+	/* Rotor forces */
+	mix(params, u, dt, out);
+}
+
+void NLIBSControlLaw::position(const struct nlibs_params_s &params, const struct nlibs_input_s &in,
+			       const struct nlibs_matrices_s &m, struct nlibs_outer_s &outer)
+{
+	const math::Matrix<3, 3> &Rt = m.Rt;
+	const math::Matrix<2, 2> &g0 = m.g0;
+
+	/* linear drag in NED frame */
+	math::Vector<3> vel_body = Rt.transposed() * in.vel;
+	math::Vector<3> drag_body;
+	drag_body(0) = -params.q_xlin_drag * vel_body(0);
+	drag_body(1) = -params.q_ylin_drag * vel_body(1);
+	drag_body(2) = -params.q_zlin_drag * vel_body(2);
+	math::Vector<3> acc_drag = (Rt * drag_body) * params.derived.inv_mass;
+
+	outer.vel_sp.zero();
+
+	if (in.position_enabled) {
+		/* A1, A2: x/y position and velocity, Varphi0 = [sin(Phi); cos(Phi)*sin(Theta)] */
+		math::Vector<2> e1;
+		e1(0) = in.pos_sp(0) - in.pos(0);
+		e1(1) = in.pos_sp(1) - in.pos(1);
+
+		math::Vector<2> vel_xy;
+		vel_xy(0) = in.vel(0);
+		vel_xy(1) = in.vel(1);
+
+		math::Vector<2> vel_xy_sp = params.A1_gain * e1;
+		vel_xy_sp(0) += in.vel_ff(0);
+		vel_xy_sp(1) += in.vel_ff(1);
+
+		math::Vector<2> e2 = vel_xy_sp - vel_xy;
+
+		math::Vector<2> acc_xy = e1 - params.A1_gain * vel_xy + params.A2_gain * e2;
+		acc_xy(0) -= acc_drag(0);
+		acc_xy(1) -= acc_drag(1);
+
+		/* g0 is a scaled rotation, its inverse is the scaled transpose */
+		float g0_scale = 1.0f / (g0(0, 0) * g0(0, 0) + g0(0, 1) * g0(0, 1));
+		math::Vector<2> varphi0 = (g0.transposed() * acc_xy) * g0_scale;
+
+		float sin_tilt_max = params.derived.sin_tilt_max;
+		outer.phi_sp = asinf(math::constrain(varphi0(0), -sin_tilt_max, sin_tilt_max));
+		outer.theta_sp = asinf(math::constrain(varphi0(1) / cosf(outer.phi_sp), -sin_tilt_max, sin_tilt_max));
+
+		outer.vel_sp(0) = vel_xy_sp(0);
+		outer.vel_sp(1) = vel_xy_sp(1);
+
+	} else {
+		outer.phi_sp = 0.0f;
+		outer.theta_sp = 0.0f;
+	}
+
+	/* A5, A6: altitude part of Varphi2, the integral only acts on yaw */
+	float e5_z = in.pos_sp(2) - in.pos(2);
+	float vel_z_sp = params.A5_gain(1) * e5_z + in.vel_ff(2);
+	float e6_z = vel_z_sp - in.vel(2);
+
+	outer.acc_z = e5_z - params.A5_gain(1) * in.vel(2) + params.A6_gain(1) * e6_z;
+	outer.acc_z -= CONSTANTS_ONE_G + acc_drag(2);
+
+	if (in.altitude_enabled) {
+		outer.vel_sp(2) = vel_z_sp;
+	}
+}
+
+void NLIBSControlLaw::backstepping(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+				   const struct nlibs_matrices_s &m, const struct nlibs_outer_s &outer,
+				   math::Vector<4> &u, struct nlibs_output_s &out)
+{
+	const math::Vector<3> &rates = in.rates;
+	const math::Matrix<3, 3> &Rr = m.Rr;
+	const math::Matrix<3, 3> &Rr_inv = m.Rr_inv;
+
+	/* Euler angle rates and the body angular acceleration induced by the variation of Rr */
+	math::Vector<3> eta_dot = Rr_inv * rates;
+	math::Matrix<3, 3> dRr = m.dRrdPhi * eta_dot(0) + m.dRrdTheta * eta_dot(1);
+	math::Vector<3> rates_drift = dRr * eta_dot;
+
+	/* rotational drag in body frame */
+	math::Vector<3> moment_drag;
+	moment_drag(0) = -params.q_xrot_drag * rates(0);
+	moment_drag(1) = -params.q_yrot_drag * rates(1);
+	moment_drag(2) = -params.q_zrot_drag * rates(2);
+
+	/* attitude references, held from the last position update */
+	float phi_sp = in.position_enabled ? outer.phi_sp : in.roll_sp;
+	float theta_sp = in.position_enabled ? outer.theta_sp : in.pitch_sp;
+
+	/* A3, A4: roll and pitch, Varphi1 = [u_Phi; u_Theta] */
+	math::Vector<2> e3;
+	e3(0) = phi_sp - in.phi;
+	e3(1) = theta_sp - in.theta;
+
+	math::Vector<2> eta_dot_rp;
+	eta_dot_rp(0) = eta_dot(0);
+	eta_dot_rp(1) = eta_dot(1);
+
+	math::Vector<2> eta_dot_rp_sp = params.A3_gain * e3;
+	math::Vector<2> e4 = eta_dot_rp_sp - eta_dot_rp;
+
+	_rates_int(0) = math::constrain(_rates_int(0) + e4(0) * dt, -RATES_I_LIMIT, RATES_I_LIMIT);
+	_rates_int(1) = math::constrain(_rates_int(1) + e4(1) * dt, -RATES_I_LIMIT, RATES_I_LIMIT);
+
+	math::Vector<2> e4_int;
+	e4_int(0) = e4(0) + _rates_int(0);
+	e4_int(1) = e4(1) + _rates_int(1);
+
+	math::Vector<2> acc_rp = e3 - params.A3_gain * eta_dot_rp + params.A4_gain * e4_int;
+
+	/* A5, A6: yaw part of Varphi2 = [u_Psy; u_z] */
+	float e5_psi = _wrap_pi(in.yaw_sp - in.psi);
+	float eta_dot_psi_sp = params.A5_gain(0) * e5_psi;
+	float e6_psi = eta_dot_psi_sp - eta_dot(2);
+
+	_rates_int(2) = math::constrain(_rates_int(2) + e6_psi * dt, -RATES_I_LIMIT, RATES_I_LIMIT);
+
+	float acc_psi = e5_psi - params.A5_gain(0) * eta_dot(2) + params.A6_gain(0) * (e6_psi + _rates_int(2));
+
+	/*
+	 * u_Phi, u_Theta, u_Psy: the Euler angle accelerations are mapped to body
+	 * angular accelerations through Rr, w_dot = Rr*eta_ddot + dRr/dt*eta_dot,
+	 * which needs no inversion of Rr.
+	 */
+	math::Vector<3> eta_ddot_sp;
+	eta_ddot_sp(0) = acc_rp(0);
+	eta_ddot_sp(1) = acc_rp(1);
+	eta_ddot_sp(2) = acc_psi;
+	math::Vector<3> rates_dot_sp = Rr * eta_ddot_sp + rates_drift;
+
+	float u_Phi = params.q_ix_moment * rates_dot_sp(0);
+	float u_Theta = params.q_iy_moment * rates_dot_sp(1);
+	float u_Psy = params.q_iz_moment * rates_dot_sp(2);
+
+	/* u_z: the held vertical acceleration, through the gain of the current tilt */
+	float u_z_sp;
+
+	if (in.altitude_enabled) {
+		u_z_sp = outer.acc_z / m.g_z;
+
+	} else {
+		u_z_sp = -in.thrust_sp * params.derived.thrust_to_u_z;
+	}
+
+	/* compensate the rotational drag */
+	u_Phi -= moment_drag(0);
+	u_Theta -= moment_drag(1);
+	u_Psy -= moment_drag(2);
+
+	/* body rates setpoint */
+	math::Vector<3> eta_dot_sp;
+	eta_dot_sp(0) = eta_dot_rp_sp(0);
+	eta_dot_sp(1) = eta_dot_rp_sp(1);
+	eta_dot_sp(2) = eta_dot_psi_sp;
+	out.rates_sp = Rr * eta_dot_sp;
+	out.vel_sp = outer.vel_sp;
+
+	u(0) = u_z_sp;
+	u(1) = u_Phi;
+	u(2) = u_Theta;
+	u(3) = u_Psy;
+}
+
+void NLIBSControlLaw::mix(const struct nlibs_params_s &params, const math::Vector<4> &u, float dt,
+			  struct nlibs_output_s &out)
+{
+	const struct nlibs_derived_s &d = params.derived;
+
+	/* inverse of the allocation, see nlibs_allocation.h */
+	math::Vector<4> forces_sp = d.allocation.B_inv * u;
+
+	/* A7: rotor forces lag the allocation at A7 (1/s), one step never goes past it */
+	for (int i = 0; i < 4; i++) {
+		float lag = math::constrain(params.A7_gain(i) * dt, 0.0f, 1.0f);
+		_forces(i) = math::constrain(_forces(i) + lag * (forces_sp(i) - _forces(i)), d.f_min, d.f_max);
+	}
+
+	/* normalized motor commands back to thrust and torques for the mixer */
+	float n1 = _forces(0) * d.inv_motor_cst;
+	float n2 = _forces(1) * d.inv_motor_cst;
+	float n3 = _forces(2) * d.inv_motor_cst;
+	float n4 = _forces(3) * d.inv_motor_cst;
+
+	out.att_control(0) = ((n3 + n2) - (n1 + n4)) * 0.25f;
+	out.att_control(1) = ((n1 + n3) - (n2 + n4)) * 0.25f;
+	out.att_control(2) = ((n1 + n2) - (n3 + n4)) * 0.25f;
+	out.thrust = (n1 + n2 + n3 + n4) * 0.25f;
+	out.forces = _forces;
+	out.motors(0) = n1;
+	out.motors(1) = n2;
+	out.motors(2) = n3;
+	out.motors(3) = n4;
+}
@@ -0,0 +1,379 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_control_law.h
+ * Multicopter non linear integral backstepping control law.
+ *
+ * The control law only depends on mathlib, it has no uORB, parameter or
+ * task dependency and can be built and stepped in a plain host process.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <mathlib/mathlib.h>
+
+#include "nlibs_matrix.h"
+#include "nlibs_allocation.h"
+
+/**
+ * Constants that only depend on the parameters, computed once by
+ * nlibs_params_derive() so that a control step has no division and no
+ * parameter only arithmetic.
+ */
+struct nlibs_derived_s {
+	float inv_mass;			/**< 1/m */
+	float u_z_min;			/**< smallest u_z magnitude, keeps g0 invertible on the ground */
+	float thrust_to_u_z;	/**< normalized thrust to u_z magnitude, 4*motor constant */
+	float sin_tilt_max;		/**< sine of the maximum tilt in the air */
+	struct nlibs_allocation_s allocation;	/**< quadrotor X allocation and its inverse */
+	float f_min;			/**< smallest rotor force */
+	float f_max;			/**< largest rotor force */
+	float inv_motor_cst;	/**< rotor force to normalized motor command */
+};
+
+/**
+ * Parameter cache of the NLIBS controller.
+ */
+struct nlibs_params_s {
+	float q_mass;
+	float q_ix_moment;
+	float q_iy_moment;
+	float q_iz_moment;
+	float q_arm_length;
+	float q_drag_coeff;
+	float q_xlin_drag;
+	float q_ylin_drag;
+	float q_zlin_drag;
+	float q_xrot_drag;
+	float q_yrot_drag;
+	float q_zrot_drag;
+	float q_rotor_radius;
+	float q_rotor_twist_angle;
+	float q_rotor_root_angle;
+	float q_motor_cst;
+
+	float thr_min;
+	float thr_max;
+	float tilt_max_air;
+	float land_speed;
+	float tilt_max_land;
+	float man_roll_max;
+	float man_pitch_max;
+	float man_yaw_max;
+	float roll_rate_max;
+	float pitch_rate_max;
+	float yaw_rate_max;
+	float xy_vel_max;
+	float xy_ff;
+
+	math::Vector<3> nlibs_rate_max;
+
+	nlibs::DiagonalMatrix<2> A1_gain;
+	nlibs::DiagonalMatrix<2> A2_gain;
+	nlibs::DiagonalMatrix<2> A3_gain;
+	nlibs::DiagonalMatrix<2> A4_gain;
+	nlibs::DiagonalMatrix<2> A5_gain;
+	nlibs::DiagonalMatrix<2> A6_gain;
+	nlibs::DiagonalMatrix<4> A7_gain;
+
+	int poll_timeout;
+	int out_direct;		/**< publish rotor commands on actuator_direct instead of actuator controls */
+
+	struct nlibs_derived_s derived;	/**< filled by nlibs_params_derive() */
+};
+
+/**
+ * Compute the derived constants of a parameter cache. Call it whenever a field
+ * of the cache changes, before the cache is handed to the control law.
+ *
+ * @return false when the mass or the motor constant is not positive, or when
+ *	the allocation matrix is singular: the cache must then not be used
+ */
+bool	nlibs_params_derive(struct nlibs_params_s &params);
+
+/**
+ * Trigonometric functions of the attitude, read off the rotation matrix once
+ * per control step and shared by the rotation, derivative and gain matrices.
+ */
+struct nlibs_trig_s {
+	float s_phi;
+	float c_phi;
+	float s_theta;
+	float c_theta;
+	float t_theta;
+	float sec_theta;
+	float s_psi;
+	float c_psi;
+};
+
+/**
+ * Matrices of the model evaluated at the current attitude.
+ */
+struct nlibs_matrices_s {
+	math::Matrix<3, 3> Rt;			/**< body to NED rotation */
+	math::Matrix<3, 3> Rr;			/**< Euler angle rates to body rates */
+	math::Matrix<3, 3> Rr_inv;		/**< body rates to Euler angle rates */
+	math::Matrix<3, 3> dRrdPhi;		/**< partial derivative of Rr along phi */
+	math::Matrix<3, 3> dRrdTheta;	/**< partial derivative of Rr along theta */
+	math::Matrix<2, 2> g0;			/**< x/y input gain */
+	float g_z;						/**< altitude input gain */
+};
+
+/**
+ * Vehicle state and references for one control step.
+ */
+struct nlibs_input_s {
+	math::Matrix<3, 3> R;		/**< body to NED rotation, from the estimator */
+	float phi;					/**< roll angle */
+	float theta;				/**< pitch angle */
+	float psi;					/**< yaw angle */
+	math::Vector<3> rates;		/**< body angular rates */
+	math::Vector<3> pos;		/**< NED position */
+	math::Vector<3> vel;		/**< NED velocity */
+
+	math::Vector<3> pos_sp;		/**< NED position setpoint */
+	math::Vector<3> vel_ff;		/**< NED velocity feed forward */
+	float roll_sp;				/**< roll setpoint, used without position control */
+	float pitch_sp;				/**< pitch setpoint, used without position control */
+	float yaw_sp;				/**< yaw setpoint */
+	float thrust_sp;			/**< normalized thrust setpoint, used without altitude control */
+
+	bool position_enabled;		/**< x/y position chain active */
+	bool altitude_enabled;		/**< altitude chain active */
+};
+
+/**
+ * References of the position stages, held by the attitude stages between two
+ * local position updates.
+ */
+struct nlibs_outer_s {
+	float phi_sp;				/**< roll reference of the x/y chain */
+	float theta_sp;				/**< pitch reference of the x/y chain */
+	float acc_z;				/**< vertical acceleration demand, gravity and drag included */
+	math::Vector<3> vel_sp;		/**< NED velocity setpoint */
+};
+
+/**
+ * State the law carries from one step to the next, in a flat layout for
+ * checkpoints. Restoring it resumes the integral terms where they were.
+ */
+struct nlibs_law_state_s {
+	float rates_int[3];			/**< angular rates integral error */
+	float forces[4];			/**< rotor forces of the previous step */
+	float phi_sp;				/**< held roll reference of the x/y chain */
+	float theta_sp;				/**< held pitch reference of the x/y chain */
+	float acc_z;				/**< held vertical acceleration demand */
+	float vel_sp[3];			/**< held NED velocity setpoint */
+};
+
+/**
+ * Result of one control step.
+ */
+struct nlibs_output_s {
+	math::Vector<3> att_control;	/**< normalized roll, pitch and yaw controls */
+	float thrust;					/**< normalized thrust */
+	math::Vector<3> rates_sp;		/**< body angular rates setpoint */
+	math::Vector<3> vel_sp;			/**< NED velocity setpoint */
+	math::Vector<4> forces;			/**< rotor forces */
+	math::Vector<4> motors;			/**< normalized rotor commands, forces over the motor constant */
+};
+
+/*
+ * The control law as straight-line code, generated in nlibs_control_kernel.cpp
+ * by codegen/nlibs_codegen.py.
+ */
+
+/**
+ * Position stages: x/y position and velocity (A1, A2) and the altitude part
+ * of A5, A6.
+ *
+ * @param forces	rotor forces of the previous step
+ * @param outer		references for the attitude stages
+ */
+void	nlibs_position_kernel(const struct nlibs_params_s &params, const struct nlibs_input_s &in,
+			      const float forces[4], struct nlibs_outer_s &outer);
+
+/**
+ * Attitude stages on the held position references: roll, pitch and yaw
+ * (A3..A6), allocation and rotor forces (A7).
+ *
+ * @param rates_int	angular rates integral error, updated
+ * @param forces	rotor forces of the previous step, updated
+ */
+void	nlibs_attitude_kernel(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+			      const struct nlibs_outer_s &outer, float rates_int[3], float forces[4],
+			      struct nlibs_output_s &out);
+
+/**
+ * Largest difference between the outputs of control() and control_reference()
+ * from the same state: relative to the output magnitude above 1, absolute
+ * below. Float rounding only, the worst case seen is 1.3e-5 on the rates
+ * setpoint and 3e-6 on the other outputs. It does not hold at 90 deg of
+ * pitch, where cos(theta) rounds to about 4e-8 and the rounding decides on
+ * which limit the thrust saturates.
+ */
+#define NLIBS_KERNEL_TOLERANCE	1e-4f
+
+class NLIBSControlLaw
+{
+public:
+	/**
+	 * Constructor
+	 */
+	NLIBSControlLaw();
+
+	/**
+	 * Reset integrals and rotor force history.
+	 */
+	void	reset();
+
+	/**
+	 * Copy the state carried between steps.
+	 */
+	void	save(struct nlibs_law_state_s &state) const;
+
+	/**
+	 * Resume from a saved state, in place of the integrals built so far.
+	 */
+	void	restore(const struct nlibs_law_state_s &state);
+
+	/**
+	 * Run one step of the nonlinear integral backstepping controller, the
+	 * position and the attitude stages at the same rate.
+	 *
+	 * The generated kernel groups the arithmetic differently from
+	 * control_reference(), from the same state their outputs agree within
+	 * NLIBS_KERNEL_TOLERANCE but not to the bit.
+	 */
+	void	control(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+			struct nlibs_output_s &out);
+
+	/**
+	 * Run the position stages and hold their references until the next call,
+	 * when the local position changed. Runs the generated nlibs_position_kernel().
+	 */
+	void	update_position(const struct nlibs_params_s &params, const struct nlibs_input_s &in);
+
+	/**
+	 * Run the attitude stages on the held position references, on every
+	 * attitude sample. Runs the generated nlibs_attitude_kernel().
+	 */
+	void	control_attitude(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+				 struct nlibs_output_s &out);
+
+	/**
+	 * Follow another controller in place of the attitude stages: take its
+	 * rotor forces as the previous step and shift the rate integrals until
+	 * this law asks for the same torques, so that switching over is bumpless.
+	 *
+	 * @param att_control	normalized roll, pitch and yaw controls of the active controller
+	 * @param thrust		normalized thrust of the active controller
+	 */
+	void	track(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+		      const math::Vector<3> &att_control, float thrust);
+
+	/**
+	 * Same step as control(), through the hand written stages below. It is
+	 * the reference the generated kernel is checked against.
+	 */
+	void	control_reference(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+				  struct nlibs_output_s &out);
+
+	/*
+	 * The stages below are run in this order by control_reference(), they
+	 * are public so that each of them can be timed on its own.
+	 */
+
+	/**
+	 * Fill the attitude trigonometric cache from the body to NED rotation.
+	 */
+	void	update_trig(const math::Matrix<3, 3> &R);
+
+	/**
+	 * Take the body to NED rotation and build the Euler rate matrices from the
+	 * trigonometric cache.
+	 */
+	void	build_rotation(const math::Matrix<3, 3> &R, struct nlibs_matrices_s &m);
+
+	/**
+	 * Build the partial derivatives of Rr from the trigonometric cache.
+	 */
+	void	build_rotation_derivatives(struct nlibs_matrices_s &m);
+
+	/**
+	 * Build the x/y and altitude input gains from the trigonometric cache and
+	 * the rotor forces of the previous step.
+	 */
+	void	build_gains(const struct nlibs_params_s &params, struct nlibs_matrices_s &m);
+
+	/**
+	 * Run the position stages of the backstepping chain, A1, A2 and the
+	 * altitude part of A5, A6.
+	 */
+	void	position(const struct nlibs_params_s &params, const struct nlibs_input_s &in,
+			 const struct nlibs_matrices_s &m, struct nlibs_outer_s &outer);
+
+	/**
+	 * Run the attitude stages of the backstepping chain, A3, A4 and the yaw
+	 * part of A5, A6, on the position references.
+	 *
+	 * @param u		virtual controls (u_z, u_Phi, u_Theta, u_Psy)
+	 */
+	void	backstepping(const struct nlibs_params_s &params, const struct nlibs_input_s &in, float dt,
+			     const struct nlibs_matrices_s &m, const struct nlibs_outer_s &outer,
+			     math::Vector<4> &u, struct nlibs_output_s &out);
+
+	/**
+	 * Allocate the virtual controls to rotor forces through the inverse
+	 * allocation matrix, apply the A7 motor stage and convert the forces to
+	 * normalized mixer inputs.
+	 *
+	 * A7 is the bandwidth of a first order lag from the allocated forces to
+	 * the rotor forces, in 1/s. A7 * dt >= 1 applies the allocation as is.
+	 */
+	void	mix(const struct nlibs_params_s &params, const math::Vector<4> &u, float dt,
+		    struct nlibs_output_s &out);
+
+private:
+	struct nlibs_trig_s	_trig;			/**< attitude trigonometric cache */
+	struct nlibs_outer_s _outer;		/**< position references held between position updates */
+
+	math::Vector<3>	_rates_int;			/**< angular rates integral error */
+	math::Vector<4>	_forces;			/**< rotor forces commanded on previous step */
+};
@@ -0,0 +1,111 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2015 Elikos Team. All rights reserved.
+ *   Authors: @author Antoine Mignon <mignon.antoine@gmail.com>
+ *			  @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file nlibs_matrix.h
+ * Fixed size, allocation free small matrices with a known sparsity.
+ *
+ * The NLIBS gains A1..A7 are diagonal by construction, storing only the
+ * diagonal turns their products with a vector into N multiplies instead
+ * of a dense N x N product.
+ *
+ * @author Antoine Mignon <mignon.antoine@gmail.com>
+ * @author Alexandre Borowczyk <borowczyk.alexandre@gmail.com>
+ */
+
+#pragma once
+
+#include <mathlib/mathlib.h>
+
+namespace nlibs
+{
+
+/**
+ * N x N diagonal matrix.
+ */
+template <unsigned int N>
+class DiagonalMatrix
+{
+public:
+	float data[N];
+
+	DiagonalMatrix()
+	{
+		zero();
+	}
+
+	/**
+	 * Access to the i-th diagonal element.
+	 */
+	float &operator()(const unsigned int i)
+	{
+		return data[i];
+	}
+
+	float operator()(const unsigned int i) const
+	{
+		return data[i];
+	}
+
+	void zero()
+	{
+		for (unsigned int i = 0; i < N; i++) {
+			data[i] = 0.0f;
+		}
+	}
+
+	void identity()
+	{
+		for (unsigned int i = 0; i < N; i++) {
+			data[i] = 1.0f;
+		}
+	}
+
+	/**
+	 * Product with a vector, N multiplies.
+	 */
+	const math::Vector<N> operator *(const math::Vector<N> &v) const
+	{
+		math::Vector<N> res;
+
+		for (unsigned int i = 0; i < N; i++) {
+			res(i) = data[i] * v(i);
+		}
+
+		return res;
+	}
+};
+
+}